@@ -4,9 +4,8 @@
 #include <QString>
 #include <QDebug>
 
-constexpr quint32 MAX_READ_DATA_INTERVAL = 50;  // 50 milliseconds
+// 应答超时由 TimeoutModel 按波特率和实测应答时间计算，这里只保留调试模式的发送周期
 constexpr quint32 DEBUG_WRIRE_DATA_INTERVAL = 200;  // 0.2 second
-constexpr quint32 DEBUG_MAX_WAIT_FOR_RSP_TIME = 1000;  // 1 second
 
 constexpr wchar_t* A_LIMIT          = L"限流";
 constexpr wchar_t* A_OVERLOAD       = L"过流";
@@ -22,29 +21,60 @@ constexpr wchar_t* ZC_LIMIT         = L"(50 US) ZC滤波深度";
 constexpr wchar_t* START_LIMIT      = L"(250 MS) 启动时间限定";
 constexpr wchar_t* START_STEP       = L"强制同步次数";
 
+constexpr wchar_t* ITEM_COL_NAME    = L"参数";
+constexpr wchar_t* ITEM_COL_MIN     = L"最小";
+constexpr wchar_t* ITEM_COL_RANGE   = L"调节";
+constexpr wchar_t* ITEM_COL_MAX     = L"最大";
+constexpr wchar_t* ITEM_COL_VALUE   = L"数值";
+constexpr wchar_t* ITEM_COL_DESC    = L"说明";
+constexpr wchar_t* DIFF_DEVICE      = L"设备";
+constexpr wchar_t* DIFF_FILE        = L"文件";
+constexpr wchar_t* DIFF_DEFAULTS    = L"默认";
+
 constexpr wchar_t* DISCONNECTED     = L"未连接";
 constexpr wchar_t* COM_SETTING      = L"串口设置";
 constexpr wchar_t* COM_CONNECT      = L"连接串口";
 constexpr wchar_t* COM_DISCONNECT   = L"断开连接";
+constexpr wchar_t* COM_BENCHMARK    = L"串口测速";
+constexpr wchar_t* COM_DISCOVER     = L"搜索设备";
 constexpr wchar_t* LOAD_DATA        = L"加载参数";
 constexpr wchar_t* SAVE_DATA        = L"保存参数";
+constexpr wchar_t* LOAD_RECIPE      = L"加载配方";
+constexpr wchar_t* SAVE_RECIPE      = L"保存配方";
+constexpr wchar_t* RECIPE_NAME      = L"配方名称";
+constexpr wchar_t* RECIPE_TAGS      = L"标签（逗号分隔）";
+constexpr wchar_t* UNDO_EDIT        = L"撤销";
+constexpr wchar_t* REDO_EDIT        = L"重做";
 
 constexpr wchar_t* WRITE_TO_DEVICE  = L"写入设备";
 constexpr wchar_t* READ_FROM_DEVICE = L"读取设备";
 constexpr wchar_t* HELP             = L"帮助文档";
+constexpr wchar_t* ANALYZE_RECORDS  = L"统计分析";
+constexpr wchar_t* SIMULATE_STARTUP = L"启动仿真";
+constexpr wchar_t* PLAY_TRAJECTORY  = L"轨迹回放";
+constexpr wchar_t* PLAY_UNSUPPORTED = L"轨迹回放需要协议 2 的固件（settings.ini 中设置 debug/protocol=2）";
+constexpr wchar_t* EXPORT_RECORDS   = L"导出记录";
+constexpr wchar_t* IMPORT_RECORDS   = L"导入记录";
+constexpr wchar_t* PROGRAM_HISTORY  = L"生产记录";
 
 struct IShowStatus {
     virtual void setStatus(const QString& s) = 0;
 };
 
+struct TransactionResult;
+
 struct IDataChanged {
     virtual void onDataChange() = 0;
     virtual void onError(int err) = 0;
+    // 一次收发（含重试）结束时的结果
+    virtual void onTransactionDone(const TransactionResult& result) { (void)result; }
 };
 
 struct IDataRead {
     virtual void onRead(QByteArray&& data) = 0;
     virtual void onClose(int err) = 0;
+    // 排队的帧没能完整写出而被丢弃，端口仍打开
+    virtual void onWriteFailed(const QByteArray& data) { (void)data; }
 };
 
 #endif // BASIC_DEF_H
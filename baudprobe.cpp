@@ -0,0 +1,164 @@
+#include "baudprobe.h"
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QDebug>
+
+static const char* SETTINGS_FILE = "settings.ini";
+static const char* KEY_BAUD_RATE = "baud_rate/";
+
+constexpr qint32 CANDIDATE_RATES[] = {921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600};
+constexpr int PROBE_TIMEOUT_MS = 100;
+constexpr quint8 CK3864S_CMD = 0xAA;
+constexpr quint8 CK3862S_CMD = 0x55;
+
+// 波特率不对时收到的是乱码，这里只做校验，不能像 DataTransfer::CheckPackage 那样断言
+bool BaudProbe::ParseReadResponse(const QByteArray &data, DeviceManager::DeviceType *type) {
+    if (data.size() < 3) {
+        return false;
+    }
+
+    const auto cmd = static_cast<quint8>(data[0]);
+    int expected = 0;
+    auto model = DeviceManager::DeviceType::CK3864S;
+    if (cmd == CK3864S_CMD) {
+        expected = CK3864S_ITEM_COUNT + 3;
+    } else if (cmd == CK3862S_CMD) {
+        expected = CK3862S_ITEM_COUNT + 3;
+        model = DeviceManager::DeviceType::CK3862S;
+    } else {
+        return false;
+    }
+
+    if (data.size() != expected || static_cast<quint8>(data[1]) != expected - 3) {
+        return false;
+    }
+
+    unsigned int sum = 0;
+    for (int i = 1; i < expected - 1; i++) {
+        sum += static_cast<quint8>(data[i]);
+    }
+    if (static_cast<quint8>(sum & 0xFF) != static_cast<quint8>(data[expected - 1])) {
+        return false;
+    }
+
+    if (type) {
+        *type = model;
+    }
+    return true;
+}
+
+static bool probeRate(QSerialPort &port, qint32 rate, QByteArray *response) {
+    if (!port.setBaudRate(rate)) {
+        return false;
+    }
+    port.clear();
+
+    QByteArray cmd;
+    cmd.push_back(0x38);
+    cmd.push_back(0x02);
+    cmd.push_back(static_cast<char>(0));
+    cmd.push_back(static_cast<char>(0));
+    cmd.push_back(0x02);
+    if (port.write(cmd) != cmd.size() || !port.waitForBytesWritten(PROBE_TIMEOUT_MS)) {
+        return false;
+    }
+
+    QByteArray data;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < PROBE_TIMEOUT_MS) {
+        if (port.waitForReadyRead(static_cast<int>(PROBE_TIMEOUT_MS - timer.elapsed()))) {
+            data.append(port.readAll());
+            if (BaudProbe::ParseReadResponse(data)) {
+                if (response) {
+                    *response = data;
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool openPort(QSerialPort &port, const SettingsDialog::Settings &settings) {
+    port.setPortName(settings.name);
+    port.setDataBits(settings.dataBits);
+    port.setParity(settings.parity);
+    port.setStopBits(settings.stopBits);
+    port.setFlowControl(settings.flowControl);
+    if (!port.open(QIODevice::ReadWrite)) {
+        qCritical() << "BaudProbe, failed to open" << settings.name << ", error=" << port.errorString();
+        return false;
+    }
+    return true;
+}
+
+qint32 BaudProbe::Probe(const SettingsDialog::Settings &settings, QByteArray *response) {
+    QSerialPort port;
+    if (!openPort(port, settings)) {
+        return 0;
+    }
+
+    // 先试上次记住的波特率，多数情况下一次就能确认；没有记录时 settings.baudRate 只是默认值，从最高档开始
+    const auto remembered = IsRemembered(settings.name) ? settings.baudRate : 0;
+    qint32 result = 0;
+    if (remembered > 0 && probeRate(port, remembered, response)) {
+        result = remembered;
+    }
+    for (auto rate: CANDIDATE_RATES) {
+        if (result != 0) {
+            break;
+        }
+        if (rate != remembered && probeRate(port, rate, response)) {
+            result = rate;
+        }
+    }
+    port.close();
+
+    qCritical() << "BaudProbe::Probe, port=" << settings.name << ", rate=" << result;
+    return result;
+}
+
+bool BaudProbe::Verify(const SettingsDialog::Settings &settings) {
+    QSerialPort port;
+    if (settings.baudRate <= 0 || !openPort(port, settings)) {
+        return false;
+    }
+    const auto is_ok = probeRate(port, settings.baudRate, nullptr);
+    port.close();
+
+    qCritical() << "BaudProbe::Verify, port=" << settings.name << ", rate=" << settings.baudRate << ", result=" << is_ok;
+    return is_ok;
+}
+
+qint32 BaudProbe::LowerRate(qint32 rate) {
+    for (auto candidate: CANDIDATE_RATES) {
+        if (candidate < rate) {
+            return candidate;
+        }
+    }
+    return 0;
+}
+
+qint32 BaudProbe::RememberedRate(const QString &port_name) {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    return settings.value(KEY_BAUD_RATE + port_name, DEFAULT_RATE).toInt();
+}
+
+bool BaudProbe::IsRemembered(const QString &port_name) {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    return settings.contains(KEY_BAUD_RATE + port_name);
+}
+
+void BaudProbe::Remember(const QString &port_name, qint32 rate) {
+    if (port_name.isEmpty() || rate <= 0) {
+        return;
+    }
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    settings.setValue(KEY_BAUD_RATE + port_name, rate);
+}
+
+void BaudProbe::Forget(const QString &port_name) {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    settings.remove(KEY_BAUD_RATE + port_name);
+}
@@ -0,0 +1,30 @@
+#ifndef BAUDPROBE_H
+#define BAUDPROBE_H
+
+#include <QString>
+#include "settingsdialog.h"
+#include "deviceitem.h"
+
+// 波特率协商：从高到低依次发送读取命令，控制器能正确应答的最高波特率即为结果
+// 结果按端口保存在 settings.ini，下次打开同一端口时只需验证一次
+class BaudProbe {
+public:
+    static constexpr qint32 DEFAULT_RATE = QSerialPort::Baud9600;
+
+    // 可在工作线程中调用；response 返回控制器的应答帧
+    static qint32 Probe(const SettingsDialog::Settings& settings, QByteArray* response = nullptr);
+    // 只用 settings.baudRate 发送一次读取命令，控制器正确应答返回 true
+    static bool Verify(const SettingsDialog::Settings& settings);
+    // 按帧头 0xAA/0x55 和帧长识别型号，并检查校验和
+    static bool ParseReadResponse(const QByteArray& data, DeviceManager::DeviceType* type = nullptr);
+    // 返回比 rate 低一档的候选波特率，没有更低的返回 0
+    static qint32 LowerRate(qint32 rate);
+
+    // 没有记录时返回 DEFAULT_RATE
+    static qint32 RememberedRate(const QString& port_name);
+    static bool IsRemembered(const QString& port_name);
+    static void Remember(const QString& port_name, qint32 rate);
+    static void Forget(const QString& port_name);
+};
+
+#endif // BAUDPROBE_H
@@ -1,10 +1,16 @@
 #include "datatransfer.h"
+#include "programhistory.h"
+#include <algorithm>
+#include <QDateTime>
 #include <QDebug>
 
 // 因为数据包有：型号  数据字节数（不包含校验和）  数据  校验和, 所以加3
 constexpr unsigned int CK3864S_BYTE_COUNT = CK3864S_ITEM_COUNT + 3;
 constexpr unsigned int CK3862S_BYTE_COUNT = CK3862S_ITEM_COUNT + 3;
 
+constexpr int READ_CMD_BYTE_COUNT = 5;
+constexpr int READ_RSP_BYTE_COUNT = std::max(CK3864S_BYTE_COUNT, CK3862S_BYTE_COUNT);
+
 constexpr quint8 CK3864S_CMD = 0xAA;
 constexpr quint8 CK3862S_CMD = 0x55;
 
@@ -36,18 +42,16 @@ void DataTransfer::Open() {
     if (!IsOpen()) {
         SetReadyMode();
         SerialComm::Instance()->SetDataReadCallback(this);
-        timer_id_ = startTimer(std::chrono::milliseconds(MAX_READ_DATA_INTERVAL).count());
-        assert(timer_id_ != 0);
+        timeout_model_.SetLink(SerialComm::Instance()->settings());
+        timer_latency_.clear();
     }
 }
 
 void DataTransfer::Close() {
     qCritical() << "DataTransfer::Close";
     if (IsOpen()) {
-        if (timer_id_ != 0) {
-            killTimer(timer_id_);
-            timer_id_ = 0;
-        }
+        qCritical() << "DataTransfer::Close, timer latency:" << timer_latency_.toString()
+                    << ", response:" << timeout_model_.toString();
     }
 
     SetClosedMode();
@@ -68,13 +72,8 @@ bool DataTransfer::Write() {
         return false;
     }
 
-    is_ok = SerialComm::Instance()->writeData(data);
-    qCritical() << "DataTransfer::Write, writeData " << is_ok;
-    if (is_ok) {
-        SetWriteMode(std::move(data));
-    }
-
-    return is_ok;
+    BeginTransaction(TransactionResult::WRITE, std::move(data));
+    return SendRequest();
 }
 
 // 发送读取命令为：38H  02H  00H  00H  02H
@@ -92,55 +91,86 @@ bool DataTransfer::Read() {
    data.push_back(static_cast<char>(0));
    data.push_back(0x02);
 
-   const auto is_ok = SerialComm::Instance()->writeData(data);
-   assert(is_ok);
-   qCritical() << "DataTransfer::Read, writeData " << is_ok;
-   if (is_ok) {
-       SetReadMode();
-   }
-   return is_ok;
+   BeginTransaction(TransactionResult::READ, std::move(data));
+   return SendRequest();
 }
 
 bool DataTransfer::IsOpen() {
     return (op_mode_ != OP_MODE::CLOSED);
 }
 
+const LatencyStats &DataTransfer::GetTimerLatency() const {
+    return timer_latency_;
+}
+
+const TimeoutModel &DataTransfer::GetTimeoutModel() const {
+    return timeout_model_;
+}
+
+void DataTransfer::SetRetryPolicy(const RetryPolicy &policy) {
+    retry_policy_ = policy;
+}
+
+const TransactionResult &DataTransfer::GetLastResult() const {
+    return last_result_;
+}
+
 void DataTransfer::timerEvent(QTimerEvent *event) {
     if (event->timerId() != timer_id_) {
         return;
     }
 
+    // 超时定时器为单次定时，实际触发时刻晚于截止时刻的部分即为调度延迟
+    using namespace std::chrono;
+    auto current_time = steady_clock::now();
+    timer_latency_.add(duration_cast<microseconds>(current_time - deadline_).count());
+    DisarmTimeout();
+
     if (!IsInTransitionMode()) {
         return;
     }
 
-    using namespace std::chrono;
-    auto current_time = steady_clock::now();
-    auto diff = duration_cast<milliseconds>(current_time - last_read_time_).count();
-    if (diff >= MAX_READ_DATA_INTERVAL) {
-        // report error
-        qCritical() << "DataTransfer::timerEvent, timeout. "
-                    << "op_mode=" << static_cast<int>(op_mode_)
-                    << ", time diff=" << diff;
-        // assert(false);
-        SetReadyMode();
+    if (retry_pending_) {
+        retry_pending_ = false;
+        SendRequest();
+        return;
+    }
+
+    // report error
+    qCritical() << "DataTransfer::timerEvent, timeout. "
+                << "op_mode=" << static_cast<int>(op_mode_)
+                << ", attempt=" << attempts_
+                << ", time diff=" << duration_cast<milliseconds>(current_time - request_time_).count()
+                << ", " << timeout_model_.toString();
+    if (attempts_ > retry_policy_.max_retries) {
+        FinishTransaction(TransactionResult::TIMEOUT);
+        return;
     }
+
+    // 丢弃不完整的应答，退避后重发；退避期间收到的完整应答仍然有效
+    data_read_.clear();
+    ArmRetry(retry_policy_.BackoffMs(attempts_));
 }
 
 void DataTransfer::onRead(QByteArray &&data) {
     qCritical() << "DataTransfer::onRead, op_mode=" << static_cast<int>(op_mode_);
-    assert(IsInTransitionMode());
     if (!IsInTransitionMode()) {
+        // 重发后先到的应答已完成收发，后到的重复应答直接丢弃
+        qCritical() << "DataTransfer::onRead, discard late data, size=" << data.size();
         return;
     }
 
-    last_read_time_ = std::chrono::steady_clock::now();
+    using namespace std::chrono;
+    const auto response_time = duration_cast<microseconds>(steady_clock::now() - request_time_).count();
     data_read_.push_back(data);
     if (op_mode_ == OP_MODE::WRITE) {
         if (data_read_ == data_writen_) {
            // MessageBox
             qCritical() << "DataTransfer::onRead, data write completedly";
-            SetReadyMode();
+            DeviceManager::Instance().confirmWrite();
+            timeout_model_.AddResponse(response_time);
+            RecordProgram(response_time);
+            FinishTransaction(TransactionResult::OK);
         }
     } else if (op_mode_ == OP_MODE::READ) {
         if (CheckPackage(data_read_)) {
@@ -159,7 +189,8 @@ void DataTransfer::onRead(QByteArray &&data) {
             if (is_ok && data_changed_cb_) {
                 data_changed_cb_->onDataChange();
             }
-            SetReadyMode();
+            timeout_model_.AddResponse(response_time);
+            FinishTransaction(TransactionResult::OK);
         } else {
             // qCritical() << "DataTransfer::onRead, data read incorrectly";
         }
@@ -175,6 +206,7 @@ void DataTransfer::onClose(int err) {
     if (IsInTransitionMode()) {
         // report error
         qCritical() << "onClose";
+        FinishTransaction(TransactionResult::CLOSED);
     }
 
     if (err != 0 && data_changed_cb_) {
@@ -184,13 +216,22 @@ void DataTransfer::onClose(int err) {
     SetClosedMode();
 }
 
+// 本次收发的请求帧没能写出，不再等待应答
+void DataTransfer::onWriteFailed(const QByteArray &data) {
+    qCritical() << "DataTransfer::onWriteFailed, op_mode=" << static_cast<int>(op_mode_) << ", size=" << data.size();
+    if (!IsInTransitionMode() || data != request_frame_) {
+        return;
+    }
+    FinishTransaction(TransactionResult::SEND_FAILED);
+}
+
 // 型号  数据字节数（不包含校验和）  数据  校验和
 // 每个数据的长度为一个字节
 // 校验和计算方式：字节数 + 各个数据 等和的最低字节
 bool DataTransfer::Pack(QByteArray& data) {
     const auto& devMgr = DeviceManager::Instance();
-    const auto& items = devMgr.getItems();
-    const auto item_count = items.size();
+    const auto& image = devMgr.getImage();
+    const auto item_count = image.size();
     qCritical() << "DataTransfer::Pack, item count=" << item_count;
     assert(item_count == CK3864S_ITEM_COUNT ||
            item_count == CK3862S_ITEM_COUNT);
@@ -206,18 +247,40 @@ bool DataTransfer::Pack(QByteArray& data) {
     } else if (devMgr.isCK3862S()) {
         cmd = static_cast<char>(CK3862S_CMD);
     }
+    data.reserve(static_cast<int>(item_count) + 3);
     data.push_back(cmd);
-    data.push_back(static_cast<char>(items.size()));
-    for (const auto& item: items) {
-        const auto value = static_cast<char>(item.getValue());
-        data.push_back(value);
-    }
+    data.push_back(static_cast<char>(item_count));
+    data.append(reinterpret_cast<const char*>(image.data()), static_cast<int>(item_count));
     const auto check = GetCheckSum(data, 1, -1);
     data.push_back(static_cast<char>(check));
 
     return true;
 }
 
+// 设备回显与下发帧一致即校验通过，记入生产记录；帧中 命令 字节数 之后为参数
+// 落盘在写入线程中进行，不拖长本次收发
+void DataTransfer::RecordProgram(qint64 verify_us) {
+    using namespace std::chrono;
+    const auto size = data_writen_.size();
+    const auto count = (size >= 3) ? static_cast<quint8>(data_writen_[1]) : 0;
+    if (size < 3 || count + 3 != size) {
+        return;
+    }
+
+    ProgramRecord record;
+    record.timestamp_ms = QDateTime::currentMSecsSinceEpoch();
+    record.station = SerialComm::Instance()->settings().name;
+    record.command = static_cast<quint8>(data_writen_[0]);
+    record.attempts = static_cast<quint8>(std::min(attempts_, 0xFF));
+    record.total_us = static_cast<quint32>(duration_cast<microseconds>(steady_clock::now() - transaction_start_).count());
+    record.verify_us = static_cast<quint32>(verify_us);
+    const auto values = reinterpret_cast<const ValueType*>(data_writen_.constData() + 2);
+    record.image.assign(values, values + count);
+
+    qCritical() << "DataTransfer::RecordProgram, station=" << record.station << ", verify us=" << verify_us;
+    ProgramHistory::Instance().Post(record);
+}
+
 bool DataTransfer::CheckPackage(const QByteArray &data) {
     const auto byte_count = static_cast<unsigned int>(data.size());
     qCritical() << "DataTransfer::CheckPackage, data len=" << byte_count;
@@ -268,6 +331,8 @@ quint8 DataTransfer::GetCheckSum(const QByteArray &data, int pos, int len) {
 
 void DataTransfer::SetClosedMode() {
     qCritical() << "DataTransfer::SetClosedMode";
+    DisarmTimeout();
+    retry_pending_ = false;
     data_writen_.clear();
     data_read_.clear();
     pkg_status = PKG_STATUS::COMPLETED;
@@ -276,6 +341,8 @@ void DataTransfer::SetClosedMode() {
 
 void DataTransfer::SetReadyMode() {
     qCritical() << "DataTransfer::SetReadyMode";
+    DisarmTimeout();
+    retry_pending_ = false;
     data_writen_.clear();
     data_read_.clear();
     pkg_status = PKG_STATUS::COMPLETED;
@@ -288,7 +355,7 @@ void DataTransfer::SetReadMode() {
     data_read_.clear();
     pkg_status = PKG_STATUS::ONGOING;
     op_mode_ = OP_MODE::READ;
-    last_read_time_ = std::chrono::steady_clock::now();
+    ArmTimeout(READ_CMD_BYTE_COUNT, READ_RSP_BYTE_COUNT);
 }
 
 void DataTransfer::SetWriteMode(QByteArray &&data) {
@@ -297,10 +364,90 @@ void DataTransfer::SetWriteMode(QByteArray &&data) {
     data_read_.clear();
     pkg_status = PKG_STATUS::ONGOING;
     op_mode_ = OP_MODE::WRITE;
-    last_read_time_ = std::chrono::steady_clock::now();
+    // 写入后设备原样回显
+    ArmTimeout(data_writen_.size(), data_writen_.size());
 }
 
 bool DataTransfer::IsInTransitionMode() {
     return (op_mode_ == OP_MODE::WRITE ||
             op_mode_ == OP_MODE::READ);
 }
+
+// 超时按当前波特率下的帧长和实测应答时间计算，每次收发单独定时
+void DataTransfer::ArmTimeout(int request_bytes, int response_bytes) {
+    DisarmTimeout();
+    retry_pending_ = false;
+
+    // 协商或降速后波特率可能已变化
+    timeout_model_.SetLink(SerialComm::Instance()->settings());
+    const auto timeout_ms = timeout_model_.ResponseTimeoutMs(request_bytes, response_bytes);
+    request_time_ = std::chrono::steady_clock::now();
+    deadline_ = request_time_ + std::chrono::milliseconds(timeout_ms);
+    timer_id_ = startTimer(static_cast<int>(timeout_ms), Qt::PreciseTimer);
+    assert(timer_id_ != 0);
+}
+
+void DataTransfer::ArmRetry(qint64 backoff_ms) {
+    DisarmTimeout();
+    retry_pending_ = true;
+    deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(backoff_ms);
+    timer_id_ = startTimer(static_cast<int>(backoff_ms), Qt::PreciseTimer);
+    assert(timer_id_ != 0);
+}
+
+void DataTransfer::DisarmTimeout() {
+    if (timer_id_ != 0) {
+        killTimer(timer_id_);
+        timer_id_ = 0;
+    }
+}
+
+void DataTransfer::BeginTransaction(TransactionResult::Kind kind, QByteArray &&frame) {
+    kind_ = kind;
+    request_frame_ = std::move(frame);
+    attempts_ = 0;
+    transaction_start_ = std::chrono::steady_clock::now();
+}
+
+bool DataTransfer::SendRequest() {
+    attempts_++;
+    const auto is_ok = SerialComm::Instance()->writeData(request_frame_);
+    qCritical() << "DataTransfer::SendRequest, kind=" << static_cast<int>(kind_)
+                << ", attempt=" << attempts_
+                << ", writeData " << is_ok;
+    if (!is_ok) {
+        FinishTransaction(TransactionResult::SEND_FAILED);
+        return false;
+    }
+
+    if (kind_ == TransactionResult::WRITE) {
+        SetWriteMode(QByteArray(request_frame_));
+    } else {
+        SetReadMode();
+    }
+    return true;
+}
+
+void DataTransfer::FinishTransaction(TransactionResult::Status status) {
+    using namespace std::chrono;
+    last_result_.kind = kind_;
+    last_result_.status = status;
+    last_result_.attempts = attempts_;
+    last_result_.elapsed_ms = duration_cast<milliseconds>(steady_clock::now() - transaction_start_).count();
+    qCritical() << "DataTransfer::FinishTransaction," << last_result_.toString();
+
+    // 端口关闭时由 onClose 切换到关闭状态
+    if (status != TransactionResult::CLOSED) {
+        SetReadyMode();
+    }
+    // 每次收发只上报一次结果，重试期间不会降低波特率
+    if (status == TransactionResult::OK) {
+        SerialComm::Instance()->ReportTransaction(true);
+    } else if (status == TransactionResult::TIMEOUT) {
+        SerialComm::Instance()->ReportTransaction(false);
+    }
+
+    if (data_changed_cb_) {
+        data_changed_cb_->onTransactionDone(last_result_);
+    }
+}
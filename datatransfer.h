@@ -5,6 +5,9 @@
 #include <QTimerEvent>
 #include "serialcomm.h"
 #include "deviceitem.h"
+#include "realtimeio.h"
+#include "linktimeout.h"
+#include "transaction.h"
 
 class DataTransfer: public QObject, public IDataRead {
     Q_OBJECT
@@ -19,6 +22,10 @@ public:
     bool Read();
 
     bool IsOpen();
+    const LatencyStats& GetTimerLatency() const;
+    const TimeoutModel& GetTimeoutModel() const;
+    void SetRetryPolicy(const RetryPolicy& policy);
+    const TransactionResult& GetLastResult() const;
 
 protected:
     void timerEvent(QTimerEvent *event) override;
@@ -26,6 +33,7 @@ protected:
     // IDataRead interface
     virtual void onRead(QByteArray&& data) override;
     virtual void onClose(int err) override;
+    virtual void onWriteFailed(const QByteArray& data) override;
 
 private:
     DataTransfer();
@@ -42,10 +50,29 @@ private:
     void SetReadMode();
     void SetWriteMode(QByteArray&& data);
     bool IsInTransitionMode();
+    void ArmTimeout(int request_bytes, int response_bytes);
+    void ArmRetry(qint64 backoff_ms);
+    void DisarmTimeout();
+
+    void BeginTransaction(TransactionResult::Kind kind, QByteArray&& frame);
+    bool SendRequest();
+    void FinishTransaction(TransactionResult::Status status);
+    void RecordProgram(qint64 verify_us);
 
 private:
     int timer_id_ = 0;
-    std::chrono::time_point<std::chrono::steady_clock> last_read_time_;
+    std::chrono::time_point<std::chrono::steady_clock> request_time_;
+    std::chrono::time_point<std::chrono::steady_clock> deadline_;
+    LatencyStats timer_latency_;
+    TimeoutModel timeout_model_;
+
+    RetryPolicy retry_policy_;
+    TransactionResult::Kind kind_ = TransactionResult::READ;
+    QByteArray request_frame_;      // 重试时原样重发
+    int attempts_ = 0;
+    bool retry_pending_ = false;
+    std::chrono::time_point<std::chrono::steady_clock> transaction_start_;
+    TransactionResult last_result_;
 
     QByteArray data_writen_;
     QByteArray data_read_;
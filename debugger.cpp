@@ -1,9 +1,20 @@
 #include "debugger.h"
+#include <QDateTime>
 #include <QDebug>
+#include <QSettings>
 
 // 数据包有：型号  数据字节数（不包含校验和）  数据  校验和
+// 协议 1（默认，与现有固件一致）：数据为当前全部参数
+// 协议 2（需固件支持，settings.ini 中 debug/protocol=2 打开）：数据为 VSP  标志(bit0 FR, bit1 BK)
+// 应答数据为：电流  转速
 constexpr quint32 DEBUG_RSP_BYTE_COUNT = 5;
 constexpr quint8 DEBUG_CMD = 0x4B;
+constexpr int DEBUG_RSP_CURRENT_POS = 2;
+constexpr int DEBUG_RSP_SPEED_POS = 3;
+constexpr quint8 DEBUG_FLAG_FR = 0x01;
+constexpr quint8 DEBUG_FLAG_BK = 0x02;
+static const char* SETTINGS_FILE = "settings.ini";
+static const char* KEY_PROTOCOL = "debug/protocol";
 
 Debugger::Debugger() {
 }
@@ -19,6 +30,12 @@ Debugger* Debugger::Instance() {
     return &inst;
 }
 
+Debugger::Protocol Debugger::ConfiguredProtocol() {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    const auto protocol = settings.value(KEY_PROTOCOL, PROTOCOL_PARAMS).toInt();
+    return (protocol == PROTOCOL_SETPOINT) ? PROTOCOL_SETPOINT : PROTOCOL_PARAMS;
+}
+
 void Debugger::SetDataChangedCallback(IDataChanged *cb) {
     data_changed_cb_ = cb;
 }
@@ -31,32 +48,139 @@ void Debugger::Start() {
     qCritical() << "Debugger::Open";
     if (!IsInDebugging()) {
         SetDebugMode();
+        protocol_ = ConfiguredProtocol();
+        qCritical() << "Debugger::Start, protocol=" << protocol_;
         SerialComm::Instance()->SetDataReadCallback(this);
-        timer_id_for_write_ = startTimer(std::chrono::milliseconds(DEBUG_WRIRE_DATA_INTERVAL).count());
-        assert(timer_id_for_write_ != 0);
-        timer_id_for_read_ = startTimer(std::chrono::milliseconds(MAX_READ_DATA_INTERVAL).count());
-        assert(timer_id_for_read_ != 0);
+        timeout_model_.SetLink(SerialComm::Instance()->settings());
+        StartSchedule();
     }
 }
 
 void Debugger::Stop() {
     qCritical() << "Debugger::Close";
+    StopTrajectory();
+    // 超时后已处于关闭状态，定时器仍需释放
+    StopTimers();
+    qCritical() << "Debugger::Stop, response:" << timeout_model_.toString();
+
+    StopRecording();
+    SetClosedMode();
+}
+
+// VSP 归零和刹车切换是紧急控制：中止回放，并在下一个帧边界立即发出，不等发送周期
+// 协议 1 的帧不含设定值，仍按发送周期发送
+void Debugger::SetVsp(quint8 vsp) {
+    const auto urgent = (vsp == 0 && setpoint_.vsp != 0);
+    if (urgent) {
+        StopTrajectory();
+    }
+    if (!IsPlaying()) {
+        setpoint_.vsp = vsp;
+    }
+    if (urgent) {
+        SendUrgent();
+    }
+}
+
+void Debugger::SetFr(bool on) {
+    if (!IsPlaying()) {
+        setpoint_.fr = on;
+    }
+}
+
+void Debugger::SetBk(bool on) {
+    const auto urgent = (on != setpoint_.bk);
+    if (urgent) {
+        StopTrajectory();
+    }
+    if (!IsPlaying()) {
+        setpoint_.bk = on;
+    }
+    if (urgent) {
+        SendUrgent();
+    }
+}
+
+void Debugger::SendUrgent() {
+    if (!IsInDebugging() || protocol_ != PROTOCOL_SETPOINT) {
+        return;
+    }
+    qCritical() << "Debugger::SendUrgent, bound=" << SerialComm::Instance()->UrgentLatencyBoundUs() << "us";
+    Write(SerialComm::PRIORITY_URGENT);
+}
+
+bool Debugger::PlayTrajectory(const Trajectory &trajectory) {
+    qCritical() << "Debugger::PlayTrajectory, duration=" << trajectory.duration();
+    if (!IsInDebugging() || trajectory.isEmpty()) {
+        return false;
+    }
+    // 协议 1 的设定帧不含 VSP，回放没有意义
+    if (protocol_ != PROTOCOL_SETPOINT) {
+        qCritical() << "Debugger::PlayTrajectory, requires protocol" << PROTOCOL_SETPOINT;
+        return false;
+    }
+
+    trajectory_ = trajectory;
+    plan_ = trajectory_.schedule(DEBUG_WRIRE_DATA_INTERVAL);
+    StartSchedule();
+    return true;
+}
+
+void Debugger::StopTrajectory() {
+    if (!IsPlaying()) {
+        return;
+    }
+
+    const auto report = timing_stats_.toString();
+    qCritical() << "Debugger::StopTrajectory, sent" << write_index_ << "of" << plan_.size()
+                << ", timing:" << report;
+    if (show_status_cb_) {
+        show_status_cb_->setStatus(QString::fromWCharArray(L"轨迹回放结束 %1").arg(report));
+    }
+
+    trajectory_.clear();
+    plan_.clear();
     if (IsInDebugging()) {
-        if (timer_id_for_write_ != 0) {
-            killTimer(timer_id_for_write_);
-            timer_id_for_write_ = 0;
-        }
-        if (timer_id_for_read_ != 0) {
-            killTimer(timer_id_for_read_);
-            timer_id_for_read_ = 0;
-        }
+        StartSchedule();
     }
+}
 
-    SetClosedMode();
+bool Debugger::IsPlaying() const {
+    return !plan_.empty();
+}
+
+const SendTimingStats &Debugger::GetTimingStats() const {
+    return timing_stats_;
+}
+
+const TimeoutModel &Debugger::GetTimeoutModel() const {
+    return timeout_model_;
+}
+
+void Debugger::SetRetryPolicy(const RetryPolicy &policy) {
+    retry_policy_ = policy;
 }
 
-bool Debugger::Write() {
-    qCritical() << "Debugger::Write, op_mode=" << static_cast<int>(op_mode_);
+bool Debugger::StartRecording(const QString &path) {
+    const auto file_name = path.isEmpty() ? TelemetryRecorder::DefaultFileName() : path;
+    const auto is_ok = recorder_.Open(file_name);
+    qCritical() << "Debugger::StartRecording, file=" << file_name << ", result=" << is_ok;
+    return is_ok;
+}
+
+void Debugger::StopRecording() {
+    if (recorder_.IsOpen()) {
+        qCritical() << "Debugger::StopRecording";
+        recorder_.Close();
+    }
+}
+
+bool Debugger::IsRecording() const {
+    return recorder_.IsOpen();
+}
+
+bool Debugger::Write(SerialComm::Priority priority) {
+    qCritical() << "Debugger::Write, op_mode=" << static_cast<int>(op_mode_) << ", priority=" << priority;
     assert(IsInDebugging());
     if (!IsInDebugging()) {
         return false;
@@ -70,10 +194,12 @@ bool Debugger::Write() {
         return false;
     }
 
-    is_ok = SerialComm::Instance()->writeData(data);
+    is_ok = SerialComm::Instance()->writeData(data, priority);
     qCritical() << "Debugger::Write, writeData " << is_ok;
     if (is_ok) {
+        sent_vsp_ = (protocol_ == PROTOCOL_SETPOINT) ? setpoint_.vsp : 0;
         // SetWriteMode(std::move(data));
+        ArmResponseTimeout(data.size());
     }
 
     return is_ok;
@@ -95,37 +221,161 @@ void Debugger::timerEvent(QTimerEvent *event) {
 
 
     if (timer_id == timer_id_for_write_) {
+        // 写定时器为单次定时，每次按绝对截止时刻重新计算，避免周期定时累积漂移
+        killTimer(timer_id_for_write_);
+        timer_id_for_write_ = 0;
         handleWriteTimer();
     } else if (timer_id == timer_id_for_read_) {
+        killTimer(timer_id_for_read_);
+        timer_id_for_read_ = 0;
         handleReadTimer();
     }
 }
 
 void Debugger::handleWriteTimer() {
-    Write();
+    if (IsPlaying()) {
+        setpoint_ = trajectory_.at(plan_[write_index_]);
+    }
+
+    if (Write()) {
+        OnWriteSent();
+    }
+
+    write_index_++;
+    if (IsPlaying() && write_index_ >= plan_.size()) {
+        StopTrajectory();
+        return;
+    }
+    ScheduleNextWrite();
+}
+
+void Debugger::StopTimers() {
+    if (timer_id_for_write_ != 0) {
+        killTimer(timer_id_for_write_);
+        timer_id_for_write_ = 0;
+    }
+    DisarmResponseTimeout();
+}
+
+void Debugger::StartSchedule() {
+    if (timer_id_for_write_ != 0) {
+        killTimer(timer_id_for_write_);
+        timer_id_for_write_ = 0;
+    }
+
+    write_start_time_ = std::chrono::steady_clock::now();
+    write_index_ = 0;
+    timing_stats_.clear();
+    ScheduleNextWrite();
+}
+
+qint64 Debugger::NextPlannedTime() const {
+    if (IsPlaying()) {
+        return plan_[write_index_] - plan_.front();
+    }
+    return static_cast<qint64>(write_index_) * DEBUG_WRIRE_DATA_INTERVAL;
+}
+
+void Debugger::ScheduleNextWrite() {
+    using namespace std::chrono;
+    const auto elapsed = duration_cast<milliseconds>(steady_clock::now() - write_start_time_).count();
+
+    // 手动模式下错过了整个周期（例如界面阻塞），直接跳到当前周期，不补发
+    if (!IsPlaying() && elapsed - NextPlannedTime() >= DEBUG_WRIRE_DATA_INTERVAL) {
+        write_index_ = static_cast<size_t>(elapsed / DEBUG_WRIRE_DATA_INTERVAL);
+    }
+
+    const auto remaining = std::max<qint64>(0, NextPlannedTime() - elapsed);
+    timer_id_for_write_ = startTimer(static_cast<int>(remaining), Qt::PreciseTimer);
+    assert(timer_id_for_write_ != 0);
+}
+
+void Debugger::OnWriteSent() {
+    using namespace std::chrono;
+    const auto elapsed = duration_cast<microseconds>(steady_clock::now() - write_start_time_).count();
+    const auto late_ms = elapsed / 1000.0 - NextPlannedTime();
+    timing_stats_.add(late_ms);
+}
+
+// 应答截止时刻由超时模型按波特率、帧长和实测应答时间给出
+void Debugger::ArmResponseTimeout(int request_bytes) {
+    // 上一个应答还没收到时沿用原截止时刻，否则设备无应答时会被每次发送不断推迟
+    if (awaiting_rsp_) {
+        return;
+    }
+
+    // 退避期间周期发送先到，本次发送即作为重发
+    DisarmResponseTimeout();
+    if (attempts_ == 0) {
+        transaction_start_ = std::chrono::steady_clock::now();
+    }
+    attempts_++;
+
+    timeout_model_.SetLink(SerialComm::Instance()->settings());
+    const auto timeout_ms = timeout_model_.ResponseTimeoutMs(request_bytes, DEBUG_RSP_BYTE_COUNT);
+    request_time_ = std::chrono::steady_clock::now();
+    awaiting_rsp_ = true;
+    timer_id_for_read_ = startTimer(static_cast<int>(timeout_ms), Qt::PreciseTimer);
+    assert(timer_id_for_read_ != 0);
+}
+
+void Debugger::DisarmResponseTimeout() {
+    awaiting_rsp_ = false;
+    retry_pending_ = false;
+    if (timer_id_for_read_ != 0) {
+        killTimer(timer_id_for_read_);
+        timer_id_for_read_ = 0;
+    }
 }
 
 void Debugger::handleReadTimer() {
+    if (retry_pending_) {
+        // 设定值是绝对量，重发当前设定值是幂等的
+        retry_pending_ = false;
+        Write();
+        return;
+    }
+
     using namespace std::chrono;
     auto current_time = steady_clock::now();
-    auto diff = duration_cast<milliseconds>(current_time - last_read_time_).count();
+    auto diff = duration_cast<milliseconds>(current_time - request_time_).count();
+    awaiting_rsp_ = false;
+
+    // report error
+    qCritical() << "Debugger::timerEvent, timeout. "
+                << "op_mode=" << static_cast<int>(op_mode_)
+                << ", attempt=" << attempts_
+                << ", time diff=" << diff
+                << ", " << timeout_model_.toString();
+    if (attempts_ > retry_policy_.max_retries) {
+        // 调试时电机在运行，设备持续无应答必须断开
+        FinishTransaction(TransactionResult::TIMEOUT);
+        SerialComm::Instance()->closeSerialPort(ERR_NO_RESPONSE);
+        return;
+    }
 
-    bool has_error = false;
-    if (data_read_.isEmpty()) {
-        if (diff >= DEBUG_MAX_WAIT_FOR_RSP_TIME) {
-            has_error = true;
-        }
-    } else if (diff >= DEBUG_WRIRE_DATA_INTERVAL) {
-       has_error = true;
+    data_read_.clear();
+    retry_pending_ = true;
+    timer_id_for_read_ = startTimer(static_cast<int>(retry_policy_.BackoffMs(attempts_)), Qt::PreciseTimer);
+    assert(timer_id_for_read_ != 0);
+}
+
+void Debugger::FinishTransaction(TransactionResult::Status status) {
+    using namespace std::chrono;
+    TransactionResult result;
+    result.kind = TransactionResult::DEBUG;
+    result.status = status;
+    result.attempts = attempts_;
+    result.elapsed_ms = duration_cast<milliseconds>(steady_clock::now() - transaction_start_).count();
+    attempts_ = 0;
+    qCritical() << "Debugger::FinishTransaction," << result.toString();
+    if (status == TransactionResult::TIMEOUT) {
+        SerialComm::Instance()->ReportTransaction(false);
     }
 
-    if (has_error) {
-        // report error
-        qCritical() << "Debugger::timerEvent, timeout. "
-                    << "op_mode=" << static_cast<int>(op_mode_)
-                    << ", time diff=" << diff;
-        assert(false);
-        SetClosedMode();
+    // 调试帧每个周期都发送，只上报经过重试的结果
+    if (result.attempts > 1 && data_changed_cb_) {
+        data_changed_cb_->onTransactionDone(result);
     }
 }
 
@@ -136,9 +386,17 @@ void Debugger::onRead(QByteArray &&data) {
         return;
     }
 
-    last_read_time_ = std::chrono::steady_clock::now();
     data_read_.push_back(data);
     if (CheckPackage(data_read_)) {
+        // 退避期间收到的迟到应答同样有效
+        if (awaiting_rsp_ || retry_pending_) {
+            using namespace std::chrono;
+            timeout_model_.AddResponse(duration_cast<microseconds>(steady_clock::now() - request_time_).count());
+            DisarmResponseTimeout();
+            FinishTransaction(TransactionResult::OK);
+            SerialComm::Instance()->ReportTransaction(true);
+        }
+
         const auto data_size = data_read_.size();
         bool is_ok = false;
         if (data_size == DEBUG_RSP_BYTE_COUNT) {
@@ -152,10 +410,25 @@ void Debugger::onRead(QByteArray &&data) {
         if (is_ok && data_changed_cb_) {
             data_changed_cb_->onDataChange();
         }
-        SetClosedMode();
+        Record(data_read_);
+        // 应答完整，等待下一个应答
+        data_read_.clear();
     }
 }
 
+void Debugger::Record(const QByteArray &data) {
+    if (!recorder_.IsOpen() || data.size() < static_cast<int>(DEBUG_RSP_BYTE_COUNT)) {
+        return;
+    }
+
+    TelemetrySample sample;
+    sample.timestamp_ms = QDateTime::currentMSecsSinceEpoch();
+    sample.values[TF_VSP] = sent_vsp_;
+    sample.values[TF_CURRENT] = static_cast<quint8>(data[DEBUG_RSP_CURRENT_POS]);
+    sample.values[TF_SPEED] = static_cast<quint8>(data[DEBUG_RSP_SPEED_POS]);
+    recorder_.Append(sample);
+}
+
 void Debugger::onClose(int err) {
     qCritical() << "Debugger::onClose, err code=" << err
                 << ", op_mode=" << static_cast<int>(op_mode_);
@@ -168,15 +441,21 @@ void Debugger::onClose(int err) {
         data_changed_cb_->onError(err);
     }
 
+    // 端口已关闭，先退出调试模式，回放结束时不再重新排程
     SetClosedMode();
+    StopTrajectory();
+    StopTimers();
 }
 
 // 型号  数据字节数（不包含校验和）  数据  校验和
 // 每个数据的长度为一个字节
 // 校验和计算方式：字节数 + 各个数据 等和的最低字节
 bool Debugger::Pack(QByteArray& data) {
-    const auto& devMgr = DeviceManager::Instance();
-    const auto& items = devMgr.getItems();
+    if (protocol_ == PROTOCOL_SETPOINT) {
+        return PackSetpoint(data);
+    }
+
+    const auto& items = DeviceManager::Instance().getImage();
     const auto item_count = items.size();
     qCritical() << "Debugger::Pack, item count=" << item_count;
     assert(item_count == CK3864S_ITEM_COUNT ||
@@ -189,10 +468,9 @@ bool Debugger::Pack(QByteArray& data) {
     data.clear();
     char cmd = DEBUG_CMD;
     data.push_back(cmd);
-    data.push_back(static_cast<char>(items.size()));
-    for (const auto& item: items) {
-        const auto value = static_cast<char>(item.getValue());
-        data.push_back(value);
+    data.push_back(static_cast<char>(item_count));
+    for (const auto value: items) {
+        data.push_back(static_cast<char>(value));
     }
     const auto check = GetCheckSum(data, 1, -1);
     data.push_back(static_cast<char>(check));
@@ -200,6 +478,30 @@ bool Debugger::Pack(QByteArray& data) {
     return true;
 }
 
+bool Debugger::PackSetpoint(QByteArray& data) {
+    qCritical() << "Debugger::PackSetpoint, vsp=" << static_cast<int>(setpoint_.vsp)
+                << ", fr=" << setpoint_.fr << ", bk=" << setpoint_.bk;
+
+    quint8 flags = 0;
+    if (setpoint_.fr) {
+        flags |= DEBUG_FLAG_FR;
+    }
+    if (setpoint_.bk) {
+        flags |= DEBUG_FLAG_BK;
+    }
+
+    data.clear();
+    char cmd = DEBUG_CMD;
+    data.push_back(cmd);
+    data.push_back(static_cast<char>(2));
+    data.push_back(static_cast<char>(setpoint_.vsp));
+    data.push_back(static_cast<char>(flags));
+    const auto check = GetCheckSum(data, 1, -1);
+    data.push_back(static_cast<char>(check));
+
+    return true;
+}
+
 bool Debugger::CheckPackage(const QByteArray &data) {
     const auto byte_count = static_cast<unsigned int>(data.size());
     qCritical() << "Debugger::CheckPackage, data len=" << byte_count;
@@ -261,6 +563,10 @@ void Debugger::SetDebugMode() {
     data_read_.clear();
     pkg_status = PKG_STATUS::COMPLETED;
     op_mode_ = OP_MODE::DEBUG;
+    awaiting_rsp_ = false;
+    retry_pending_ = false;
+    attempts_ = 0;
+    sent_vsp_ = 0;
 }
 
 bool Debugger::IsInDebugging() {
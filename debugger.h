@@ -1,10 +1,14 @@
-#ifndef DATATRANSFER_H
-#define DATATRANSFER_H
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
 
 #include <chrono>
 #include <QTimerEvent>
 #include "serialcomm.h"
 #include "deviceitem.h"
+#include "telemetrystore.h"
+#include "trajectory.h"
+#include "linktimeout.h"
+#include "transaction.h"
 
 class Debugger: public QObject, public IDataRead {
     Q_OBJECT
@@ -16,6 +20,29 @@ public:
     void Start();
     void Stop();
     bool IsInDebugging();
+    void SetVsp(quint8 vsp);
+    void SetFr(bool on);
+    void SetBk(bool on);
+
+    // 按计划时刻回放轨迹，回放期间忽略手动设定
+    bool PlayTrajectory(const Trajectory& trajectory);
+    void StopTrajectory();
+    bool IsPlaying() const;
+    const SendTimingStats& GetTimingStats() const;
+    const TimeoutModel& GetTimeoutModel() const;
+    void SetRetryPolicy(const RetryPolicy& policy);
+
+    bool StartRecording(const QString& path = QString());
+    void StopRecording();
+    bool IsRecording() const;
+
+    // 设定帧的协议版本，见 debugger.cpp 开头的说明
+    enum Protocol {
+        PROTOCOL_PARAMS = 1,
+        PROTOCOL_SETPOINT = 2
+    };
+    // settings.ini 中配置的协议，Start 时生效
+    static Protocol ConfiguredProtocol();
 
 protected:
     void timerEvent(QTimerEvent *event) override;
@@ -31,25 +58,52 @@ private:
     ~Debugger();
 
 private:
-    bool Write();
+    bool Write(SerialComm::Priority priority = SerialComm::PRIORITY_CONTROL);
+    void SendUrgent();
     void Shutdown();
     bool Pack(QByteArray& data);
+    bool PackSetpoint(QByteArray& data);
     bool Unpack();
     bool CheckPackage(const QByteArray& data);
     quint8 GetCheckSum(const QByteArray& data, int pos, int len);
 
     void SetClosedMode();
     void SetDebugMode();
+    void StartSchedule();
+    void StopTimers();
+    void ScheduleNextWrite();
+    qint64 NextPlannedTime() const;
+    void OnWriteSent();
+    void ArmResponseTimeout(int request_bytes);
+    void DisarmResponseTimeout();
+    void FinishTransaction(TransactionResult::Status status);
+    void Record(const QByteArray& data);
 
 private:
     int timer_id_for_write_ = 0;
     int timer_id_for_read_ = 0;
-    std::chrono::time_point<std::chrono::steady_clock> last_read_time_;
+    std::chrono::time_point<std::chrono::steady_clock> request_time_;
+    std::chrono::time_point<std::chrono::steady_clock> write_start_time_;
+    size_t write_index_ = 0;
 
     QByteArray data_writen_;
     QByteArray data_read_;
     IDataChanged *data_changed_cb_ = nullptr;
     IShowStatus *show_status_cb_ = nullptr;
+    DebugSetpoint setpoint_;
+    Trajectory trajectory_;
+    std::vector<qint64> plan_;
+    SendTimingStats timing_stats_;
+    TelemetryRecorder recorder_;
+    TimeoutModel timeout_model_;
+    bool awaiting_rsp_ = false;
+    Protocol protocol_ = PROTOCOL_PARAMS;
+    quint8 sent_vsp_ = 0;           // 最近一帧实际发出的 VSP，协议 1 的帧不含 VSP，为 0
+
+    RetryPolicy retry_policy_;
+    int attempts_ = 0;              // 当前未应答设定值已发送的次数
+    bool retry_pending_ = false;
+    std::chrono::time_point<std::chrono::steady_clock> transaction_start_;
 
     enum class PKG_STATUS {
         ONGOING = 1,
@@ -63,4 +117,4 @@ private:
     };
     OP_MODE op_mode_ = OP_MODE::CLOSED;
 };
-#endif // DATATRANSFER_H
+#endif // DEBUGGER_H
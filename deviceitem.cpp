@@ -3,10 +3,14 @@
 #include <iomanip>
 #include <QString>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QTextStream>
+#include <QDebug>
 #include "mainwindow.h"
+#include "profilefile.h"
 #include "basic_def.h"
 
 
@@ -15,10 +19,8 @@ static const char* FILE_CK3862S_BIN = "CK3862S.bin";
 static const char* FILE_CK3864S_JSON = "CK3864S.json";
 static const char* FILE_CK3862S_JSON = "CK3862S.json";
 
-static const char* J_DEVICENAME = "device_name";
 static const char* J_VERSION = "version";
 static const char* J_META = "meta";
-static const char* J_ITEMS = "items";
 
 static const char* J_NAME       = "name";
 static const char* J_ITEM_TYPE  = "item_type";
@@ -29,6 +31,16 @@ static const char* J_VALUE      = "value";
 
 static const unsigned int VERSION = 1;  // 递增
 
+constexpr quint8 CK3864S_CMD = 0xAA;
+constexpr quint8 CK3862S_CMD = 0x55;
+
+// 数值以字符串保存，必须是 0~255 的整数
+static bool isValueString(const QJsonValue& value) {
+    bool ok = false;
+    const auto v = value.isString() ? value.toString().toUInt(&ok) : 0;
+    return ok && v <= 0xFF;
+}
+
 DeviceItem::DeviceItem() {
 }
 
@@ -55,7 +67,7 @@ bool DeviceItem::read(const QJsonObject &json) {
         is_ok = false;
     }
 
-    if (is_ok && json.contains(J_MIN_VALUE) && json[J_MIN_VALUE].isString()) {
+    if (is_ok && json.contains(J_MIN_VALUE) && isValueString(json[J_MIN_VALUE])) {
         auto valueStr = json[J_MIN_VALUE].toString();
         setMinValue(valueStr);
     } else {
@@ -63,7 +75,7 @@ bool DeviceItem::read(const QJsonObject &json) {
     }
 
 
-    if (is_ok && json.contains(J_MAX_VALUE) && json[J_MAX_VALUE].isString()) {
+    if (is_ok && json.contains(J_MAX_VALUE) && isValueString(json[J_MAX_VALUE])) {
         auto valueStr = json[J_MAX_VALUE].toString();
         setMaxValue(valueStr);
     } else {
@@ -71,18 +83,18 @@ bool DeviceItem::read(const QJsonObject &json) {
     }
 
 
-    if (is_ok && json.contains(J_VALUE) && json[J_VALUE].isString()) {
+    if (is_ok && json.contains(J_VALUE) && isValueString(json[J_VALUE])) {
         auto valueStr = json[J_VALUE].toString();
         setValue(valueStr);
     } else {
         is_ok = false;
     }
 
-    assert(is_ok);
+    // 批量导入时格式错误的记录只跳过，不在这里断言
     return is_ok;
 }
 
-void DeviceItem::makeItem(const char* n, ValueType min, ValueType max, ValueType value, const QString& d) {
+void DeviceItem::makeItem(const QString& n, ValueType min, ValueType max, ValueType value, const QString& d) {
    name_ = n;
    min_value_ = min;
    max_value_ = max;
@@ -147,7 +159,41 @@ ValueType DeviceItem::getValue() const {
 }
 
 ////////////////////////////////////////////////////////
-DeviceManager::DeviceManager() {
+static ModelSchema makeCK3864SSchema() {
+    ModelSchema schema(CK3864S, CK3864S_CMD);
+    schema.addItem("A-Limit:",          1, 250      , 12, A_LIMIT          );
+    schema.addItem("A-OverLoad:",       1, 250      , 20, A_OVERLOAD       );
+    schema.addItem("Spd:",              1, 100      , 10, SPD              );
+    schema.addItem("Locked Rotor-Time:",1, 100      , 5,  LOCKED_ROTOR_TIME);
+    schema.addItem("Reboot-Count:",     1, 255      , 5,  REBOOT_COUNT     );
+    schema.addItem("Reboot-Interval:",  1, 250      , 30, REBOOT_INTERVAL  );
+    schema.addItem("Stall:",            1, 250      , 25, STALL            );
+    schema.addItem("StartP:",           1, 120      , 15, STARTP           );
+    schema.addItem("StartT:",           5, 100      , 25, STARTT           );
+    schema.addItem("Evol-Count:",       1, 30       , 5,  EVOL_COUNT       );
+    schema.addItem("ZC-Limit:",         1, 200      , 10, ZC_LIMIT         );
+    schema.addItem("Start-Limit:",      1, 250      , 4,  START_LIMIT      );
+    schema.addItem("Start-Step:",       1, 250      , 2,  START_STEP       );
+    assert(schema.size() == CK3864S_ITEM_COUNT);
+    return schema;
+}
+
+static ModelSchema makeCK3862SSchema() {
+    ModelSchema schema(CK3862S, CK3862S_CMD);
+    schema.addItem("A-Limit:",          1, 250      , 12, A_LIMIT          );
+    schema.addItem("A-OverLoad:",       1, 250      , 20, A_OVERLOAD       );
+    schema.addItem("Spd:",              1, 100      , 10, SPD              );
+    schema.addItem("Locked Rotor-Time:",1, 100      , 5 , LOCKED_ROTOR_TIME);
+    schema.addItem("Reboot-Count:",     1, 255      , 5 , REBOOT_COUNT     );
+    schema.addItem("Reboot-Interval:",  1, 250      , 30, REBOOT_INTERVAL  );
+    schema.addItem("Stall:",            1, 250      , 25, STALL            );
+    schema.addItem("StartP:",           1, 120      , 5 , STARTP           );
+    assert(schema.size() == CK3862S_ITEM_COUNT);
+    return schema;
+}
+
+DeviceManager::DeviceManager()
+    : schema_(&getSchema(DeviceType::CK3864S)) {
 }
 
 DeviceManager &DeviceManager::Instance() {
@@ -155,41 +201,66 @@ DeviceManager &DeviceManager::Instance() {
     return inst;
 }
 
+// 参数表在第一次使用时生成，之后所有镜像共用
+const ModelSchema &DeviceManager::getSchema(DeviceType type) {
+    static const ModelSchema ck3864s = makeCK3864SSchema();
+    static const ModelSchema ck3862s = makeCK3862SSchema();
+    return (type == DeviceType::CK3864S) ? ck3864s : ck3862s;
+}
+
+// 换机型后原来的设备、文件参数不再适用
+void DeviceManager::switchType(DeviceType type) {
+    device_type_ = type;
+    if (schema_ != &getSchema(type)) {
+        schema_ = &getSchema(type);
+        device_image_.clear();
+        file_image_.clear();
+    }
+}
+
+void DeviceManager::loadDefault(DeviceType type) {
+    switchType(type);
+    image_ = schema_->defaults();
+}
+
 void DeviceManager::load_CK3864S_Default() {
-    device_type_ = DeviceType::CK3864S;
-    items_.clear();
-
-    addItem("A-Limit:",          1, 250      , 12, A_LIMIT          );
-    addItem("A-OverLoad:",       1, 250      , 20, A_OVERLOAD       );
-    addItem("Spd:",              1, 100      , 10, SPD              );
-    addItem("Locked Rotor-Time:",1, 100      , 5,  LOCKED_ROTOR_TIME);
-    addItem("Reboot-Count:",     1, 255      , 5,  REBOOT_COUNT     );
-    addItem("Reboot-Interval:",  1, 250      , 30, REBOOT_INTERVAL  );
-    addItem("Stall:",            1, 250      , 25, STALL            );
-    addItem("StartP:",           1, 120      , 15, STARTP           );
-    addItem("StartT:",           5, 100      , 25, STARTT           );
-    addItem("Evol-Count:",       1, 30       , 5,  EVOL_COUNT       );
-    addItem("ZC-Limit:",         1, 200      , 10, ZC_LIMIT         );
-    addItem("Start-Limit:",      1, 250      , 4,  START_LIMIT      );
-    addItem("Start-Step:",       1, 250      , 2,  START_STEP       );
+    loadDefault(DeviceType::CK3864S);
 }
 
 void DeviceManager::load_CK3862S_Default() {
-    device_type_ = DeviceType::CK3862S;
-    items_.clear();
+    loadDefault(DeviceType::CK3862S);
+}
 
-    addItem("A-Limit:",          1, 250      , 12, A_LIMIT          );
-    addItem("A-OverLoad:",       1, 250      , 20, A_OVERLOAD       );
-    addItem("Spd:",              1, 100      , 10, SPD              );
-    addItem("Locked Rotor-Time:",1, 100      , 5 , LOCKED_ROTOR_TIME);
-    addItem("Reboot-Count:",     1, 255      , 5 , REBOOT_COUNT     );
-    addItem("Reboot-Interval:",  1, 250      , 30, REBOOT_INTERVAL  );
-    addItem("Stall:",            1, 250      , 25, STALL            );
-    addItem("StartP:",           1, 120      , 5 , STARTP           );
+const ModelSchema &DeviceManager::getSchema() const {
+    return *schema_;
 }
 
-const ItemVector &DeviceManager::getItems() const {
-    return items_;
+const ParamImage &DeviceManager::getImage() const {
+    return image_;
+}
+
+const ParamImage &DeviceManager::getDeviceImage() const {
+    return device_image_;
+}
+
+const ParamImage &DeviceManager::getFileImage() const {
+    return file_image_;
+}
+
+// 下发的帧由 image_ 打包，设备应答一致后设备上的参数即为 image_
+void DeviceManager::confirmWrite() {
+    device_image_ = image_;
+}
+
+bool DeviceManager::findValue(const QString &name, ValueType *value) const {
+    const auto index = schema_->indexOf(name);
+    if (index < 0 || static_cast<size_t>(index) >= image_.size()) {
+        return false;
+    }
+    if (value != nullptr) {
+        *value = image_[static_cast<size_t>(index)];
+    }
+    return true;
 }
 
 DeviceManager::DeviceType DeviceManager::getDeviceType() {
@@ -205,33 +276,19 @@ bool DeviceManager::isCK3862S() const {
 }
 
 bool DeviceManager::isInValidRange(const QByteArray &data) const {
-    if (data.size() != static_cast<int>(items_.size())) {
-        return false;
-    }
-
-    bool all_match = true;
-    quint32 index = 0;
-    for (auto& item: items_) {
-        auto value = data[index++];
-        if (value < item.getMin() || value > item.getMax()) {
-            all_match = false;
-            break;
-        }
-    }
-
-    return all_match;
+    // 按无符号字节比较，大于 127 的值不能当成负数
+    return schema_->isInRange(reinterpret_cast<const ValueType*>(data.constData()),
+                              static_cast<size_t>(data.size()));
 }
 
 void DeviceManager::updateValue(const QByteArray &data) {
-    if (data.size() != static_cast<int>(items_.size())) {
+    if (data.size() != static_cast<int>(schema_->size())) {
         return;
     }
 
-    quint32 index = 0;
-    for (auto& item: items_) {
-        auto value = static_cast<ValueType>(data[index++]);
-        item.setValue(value);
-    }
+    const auto values = reinterpret_cast<const ValueType*>(data.constData());
+    image_.assign(values, values + data.size());
+    device_image_ = image_;
 }
 
 bool DeviceManager::updateCK3864S(const QByteArray &data) {
@@ -240,7 +297,7 @@ bool DeviceManager::updateCK3864S(const QByteArray &data) {
     }
 
     if (data.size() != CK3864S_ITEM_COUNT ||
-            data.size() != static_cast<int>(items_.size())) {
+            data.size() != static_cast<int>(schema_->size())) {
        return false;
     }
 
@@ -258,7 +315,7 @@ bool DeviceManager::updateCK3862S(const QByteArray &data) {
     }
 
     if (data.size() != CK3862S_ITEM_COUNT ||
-            data.size() != static_cast<int>(items_.size())) {
+            data.size() != static_cast<int>(schema_->size())) {
        return false;
     }
 
@@ -283,16 +340,13 @@ void DeviceManager::refreshItemData(MainWindow* ui) {
         return;
     }
 
-    unsigned int index = 1;
-    for (auto& item: items_) {
-        std::string prefix = "item_" + std::to_string(index) + "_";
-        QLineEdit* edit = ui->findChild<QLineEdit*>(std::string(prefix+"value").c_str());
-        assert(edit != nullptr);
-        if (edit != nullptr) {
-            item.setValue(edit->text());
-        }
-        index++;
+    ui->commitParamEdits();
+    const auto& model = ui->paramModel();
+    assert(&model.schema() == schema_);
+    if (&model.schema() != schema_ || !schema_->isInRange(model.image())) {
+        return;
     }
+    image_ = model.image();
 }
 
 QString DeviceManager::defaultFileName(SaveFormat save_format) const {
@@ -303,13 +357,23 @@ QString DeviceManager::defaultFileName(SaveFormat save_format) const {
     }
 }
 
-void DeviceManager::addItem(const char *name, ValueType min, ValueType max, ValueType value, const wchar_t* desc) {
-   DeviceItem item;
-   item.makeItem(name, min, max, value, (desc != nullptr ? QString::fromWCharArray(desc) : QString()));
-   items_.push_back(item);
-}
-
 bool DeviceManager::load_from_file(SaveFormat save_format) {
+    if (save_format == Binary) {
+        // 二进制文件映射后只做校验，不存在、损坏或 JSON 被手工改过时由调用方改用 JSON
+        const QFileInfo bin(defaultFileName(Binary));
+        const QFileInfo json(defaultFileName(Json));
+        if (!bin.exists() || (json.exists() && json.lastModified() > bin.lastModified())) {
+            return false;
+        }
+        ProfileFile profile;
+        const auto is_ok = profile.Open(defaultFileName(save_format)) && loadImage(profile.view());
+        qCritical() << "DeviceManager::load_from_file, binary result=" << is_ok;
+        if (is_ok) {
+            file_image_ = image_;
+        }
+        return is_ok;
+    }
+
     bool is_ok = false;
     QFile loadFile(defaultFileName(save_format));
 
@@ -319,23 +383,31 @@ bool DeviceManager::load_from_file(SaveFormat save_format) {
     }
 
     QByteArray saveData = loadFile.readAll();
-
-    QJsonDocument loadDoc(save_format == Json
-        ? QJsonDocument::fromJson(saveData)
-        : QJsonDocument::fromBinaryData(saveData));
-
+    QJsonDocument loadDoc(QJsonDocument::fromJson(saveData));
     is_ok = read(loadDoc.object());
 
-    QTextStream(stdout) << "Loaded save result: " << is_ok << ", using "
-                        << (save_format != Json ? "binary " : "") << "JSON...\n";
+    QTextStream(stdout) << "Loaded save result: " << is_ok << ", using JSON...\n";
+    if (is_ok) {
+        file_image_ = image_;
+    }
 
     assert(is_ok);
     return is_ok;
 }
 
 bool DeviceManager::save_to_file(SaveFormat save_format) {
+    if (save_format == Binary) {
+        const auto is_ok = ProfileFile::Save(defaultFileName(save_format), schema_->command(), image_);
+        assert(is_ok);
+        if (is_ok) {
+            file_image_ = image_;
+        }
+        return is_ok;
+    }
+
     bool is_ok = false;
-    QFile saveFile(defaultFileName(save_format));
+    // 写入临时文件后再替换，中途异常退出时原文件不受影响
+    QSaveFile saveFile(defaultFileName(save_format));
 
     if (!saveFile.open(QIODevice::WriteOnly)) {
         qWarning("Couldn't open save file.");
@@ -345,15 +417,34 @@ bool DeviceManager::save_to_file(SaveFormat save_format) {
     QJsonObject gameObject;
     write(gameObject);
     QJsonDocument saveDoc(gameObject);
-    const auto wtByte = saveFile.write(save_format == Json
-        ? saveDoc.toJson()
-        : saveDoc.toBinaryData());
+    const auto wtByte = saveFile.write(saveDoc.toJson());
 
-    is_ok = (wtByte != -1);
+    is_ok = (wtByte != -1) && saveFile.commit();
     assert(is_ok);
+    if (is_ok) {
+        file_image_ = image_;
+    }
     return is_ok;
 }
 
+// 按命令字找到机型，范围正确才替换当前参数
+bool DeviceManager::loadImage(const ProfileView &view) {
+    for (auto type: {DeviceType::CK3864S, DeviceType::CK3862S}) {
+        const auto& schema = getSchema(type);
+        if (schema.command() != view.command) {
+            continue;
+        }
+        if (!schema.isInRange(view.values, view.count)) {
+            return false;
+        }
+
+        switchType(type);
+        image_.assign(view.values, view.values + view.count);
+        return true;
+    }
+    return false;
+}
+
 bool DeviceManager::readMeta(const QJsonObject &json) {
     bool has_name = false;
     if (json.contains(J_DEVICENAME) && json[J_DEVICENAME].isString()) {
@@ -386,26 +477,39 @@ void DeviceManager::writeMeta(QJsonObject &json) const {
    json[J_VERSION] = std::to_string(VERSION).c_str();
 }
 
+// 名称、范围以机型参数表为准，文件中只取数值
 bool DeviceManager::read(const QJsonObject &json) {
+    const auto prev_type = device_type_;
     bool is_ok = false;
     if (json.contains(J_META) && json[J_META].isObject())
         is_ok = readMeta(json[J_META].toObject());
 
     if (!is_ok) {
+        device_type_ = prev_type;
         return false;
     }
 
+    const auto& schema = getSchema(device_type_);
+    ParamImage image = schema.defaults();
     if (json.contains(J_ITEMS) && json[J_ITEMS].isArray()) {
         QJsonArray itemArray = json[J_ITEMS].toArray();
-        items_.clear();
-        items_.reserve(static_cast<size_t>(itemArray.size()));
-        for (int level= 0; level< itemArray.size(); ++level) {
+        is_ok = (static_cast<size_t>(itemArray.size()) == schema.size());
+        for (int level= 0; is_ok && level< itemArray.size(); ++level) {
             QJsonObject itemObject = itemArray[level].toObject();
             DeviceItem item;
-            item.read(itemObject);
-            items_.push_back(item);
+            is_ok = item.read(itemObject) && item.getName() == schema.name(static_cast<size_t>(level));
+            image[static_cast<size_t>(level)] = item.getValue();
         }
     }
+
+    if (!is_ok || !schema.isInRange(image)) {
+        qCritical() << "DeviceManager::read, items do not match" << schema.model();
+        device_type_ = prev_type;
+        return false;
+    }
+
+    switchType(device_type_);
+    image_ = std::move(image);
     return true;
 }
 
@@ -415,7 +519,10 @@ void DeviceManager::write(QJsonObject &json) const {
     json[J_META] = meta;
 
     QJsonArray itemArray;
-    for (const auto &item : items_) {
+    for (size_t index = 0; index < image_.size(); index++) {
+        DeviceItem item;
+        item.makeItem(schema_->name(index), schema_->min(index), schema_->max(index),
+                      image_[index], schema_->desc(index));
         QJsonObject levelObject;
         item.write(levelObject);
         itemArray.append(levelObject);
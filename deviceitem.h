@@ -6,19 +6,21 @@
 #include <vector>
 #include <QJsonObject>
 #include <QObject>
+#include "paramimage.h"
 
 
 static const char* CK3864S = "CK3864S";
 static const char* CK3862S = "CK3862S";
 
+// 参数文件和批量记录共用的字段名
+static const char* J_DEVICENAME = "device_name";
+static const char* J_ITEMS = "items";
+
 constexpr unsigned int CK3864S_ITEM_COUNT = 13;
 constexpr unsigned int CK3862S_ITEM_COUNT = 8;
 
 
-class DeviceItem;
-using ItemVector = std::vector<DeviceItem>;
-using ValueType = quint8;
-
+// 参数文件中的一项，只在读写文件时使用
 class DeviceItem {
 public:
     DeviceItem();
@@ -27,7 +29,7 @@ public:
     void write(QJsonObject &json) const;
     bool read(const QJsonObject &json);
 
-    void makeItem(const char* name_, ValueType min, ValueType max, ValueType value, const QString& desc_);
+    void makeItem(const QString& name_, ValueType min, ValueType max, ValueType value, const QString& desc_);
     void setValue(const QString& strValue);
     void setValue(ValueType value);
     void setMinValue(const QString& strValue);
@@ -54,6 +56,7 @@ private:
 };
 
 class MainWindow;
+struct ProfileView;
 class DeviceManager: public QObject {
     Q_OBJECT
 public:
@@ -62,9 +65,16 @@ public:
 
 public:
     static DeviceManager& Instance();
+    static const ModelSchema& getSchema(DeviceType type);
     void load_CK3864S_Default();
     void load_CK3862S_Default();
-    const ItemVector& getItems() const;
+    const ModelSchema& getSchema() const;
+    const ParamImage& getImage() const;
+    // 最近一次从设备读回或写入设备成功的参数、最近一次读写参数文件的参数，没有时为空
+    const ParamImage& getDeviceImage() const;
+    const ParamImage& getFileImage() const;
+    void confirmWrite();
+    bool findValue(const QString& name, ValueType* value) const;
     DeviceType getDeviceType();
     bool isCK3864S() const;
     bool isCK3862S() const;
@@ -74,6 +84,7 @@ public:
     void refreshItemData(MainWindow* ui);
     bool load_from_file(SaveFormat save_format);
     bool save_to_file(SaveFormat save_format);
+    bool loadImage(const ProfileView& view);
 
 private:
     DeviceManager();
@@ -88,10 +99,14 @@ private:
     bool readMeta(const QJsonObject &json);
     void writeMeta(QJsonObject &json) const;
     QString defaultFileName(SaveFormat save_format) const;
-    void addItem(const char* name, ValueType min, ValueType max, ValueType value, const wchar_t* desc);
+    void loadDefault(DeviceType type);
+    void switchType(DeviceType type);
 
 private:
-    ItemVector items_;
+    const ModelSchema* schema_ = nullptr;
+    ParamImage image_;
+    ParamImage device_image_;
+    ParamImage file_image_;
     DeviceType device_type_ = DeviceType::CK3864S;
 };
 
@@ -0,0 +1,327 @@
+#include "devicerecords.h"
+#include "deviceitem.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDebug>
+
+static const char* R_STATION = "station";
+static const char* R_TIMESTAMP = "timestamp";
+
+constexpr int CSV_META_COLUMNS = 3;     // station,device_name,timestamp
+
+static const ModelSchema* findSchema(const QString& model) {
+    for (auto type: {DeviceManager::DeviceType::CK3864S, DeviceManager::DeviceType::CK3862S}) {
+        const auto& schema = DeviceManager::getSchema(type);
+        if (model == schema.model()) {
+            return &schema;
+        }
+    }
+    return nullptr;
+}
+
+static const ModelSchema* findSchema(quint8 command) {
+    for (auto type: {DeviceManager::DeviceType::CK3864S, DeviceManager::DeviceType::CK3862S}) {
+        const auto& schema = DeviceManager::getSchema(type);
+        if (command == schema.command()) {
+            return &schema;
+        }
+    }
+    return nullptr;
+}
+
+static QString formatTime(qint64 ms) {
+    return QDateTime::fromMSecsSinceEpoch(ms).toString(Qt::ISODateWithMs);
+}
+
+static bool parseTime(const QString& s, qint64* ms) {
+    const auto time = QDateTime::fromString(s, Qt::ISODateWithMs);
+    if (!time.isValid()) {
+        return false;
+    }
+    *ms = time.toMSecsSinceEpoch();
+    return true;
+}
+
+// 含逗号、引号的字段加引号，引号写两次；换行替换为空格，保证一条记录一行
+static QString csvField(QString s) {
+    s.replace('\r', ' ').replace('\n', ' ');
+    if (s.contains(',') || s.contains('"')) {
+        s.replace("\"", "\"\"");
+        return '"' + s + '"';
+    }
+    return s;
+}
+
+static QStringList splitCsv(const QString& line) {
+    QStringList fields;
+    QString field;
+    bool quoted = false;
+    for (int i = 0; i < line.size(); i++) {
+        const auto c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                field += c;
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields << field;
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    fields << field;
+    return fields;
+}
+
+static QByteArray trimLine(const QByteArray& line) {
+    auto size = line.size();
+    while (size > 0 && (line[size - 1] == '\n' || line[size - 1] == '\r')) {
+        size--;
+    }
+    return line.left(size);
+}
+
+RecordFormat RecordFormatOf(const QString &path) {
+    return (QFileInfo(path).suffix().compare("csv", Qt::CaseInsensitive) == 0) ? RF_CSV : RF_JSONL;
+}
+
+////////////////////////////////////////////////////////
+RecordWriter::~RecordWriter() {
+    Close();
+}
+
+bool RecordWriter::Open(const QString &path) {
+    Close();
+    format_ = RecordFormatOf(path);
+    file_.setFileName(path);
+
+    // 追加到已有的 CSV 时沿用第一行的表头
+    if (format_ == RF_CSV && file_.open(QIODevice::ReadOnly)) {
+        const auto header = trimLine(file_.readLine());
+        if (!header.isEmpty()) {
+            header_ = splitCsv(QString::fromUtf8(header));
+        }
+        file_.close();
+    }
+
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCritical() << "RecordWriter::Open, failed, error=" << file_.errorString();
+        return false;
+    }
+    return true;
+}
+
+void RecordWriter::Close() {
+    if (file_.isOpen()) {
+        file_.close();
+        qCritical() << "RecordWriter::Close, file=" << file_.fileName() << ", count=" << count_;
+    }
+    header_.clear();
+    count_ = 0;
+}
+
+bool RecordWriter::IsOpen() const {
+    return file_.isOpen();
+}
+
+bool RecordWriter::Write(const DeviceRecord &record) {
+    const auto schema = findSchema(record.command);
+    if (!file_.isOpen() || schema == nullptr || record.image.size() != schema->size()) {
+        return false;
+    }
+
+    const auto is_ok = (format_ == RF_CSV) ? WriteCsv(record) : WriteJson(record);
+    if (is_ok) {
+        count_++;
+    }
+    return is_ok;
+}
+
+// 参数按表头中的名称写入对应的列，机型与表头不符时不写
+bool RecordWriter::WriteCsv(const DeviceRecord &record) {
+    const auto& schema = *findSchema(record.command);
+    if (!header_.isEmpty() && header_.size() - CSV_META_COLUMNS != static_cast<int>(schema.size())) {
+        qCritical() << "RecordWriter::WriteCsv, header does not match" << schema.model();
+        return false;
+    }
+    if (header_.isEmpty()) {
+        header_ << R_STATION << J_DEVICENAME << R_TIMESTAMP;
+        for (size_t i = 0; i < schema.size(); i++) {
+            header_ << schema.name(i);
+        }
+        QStringList fields;
+        for (const auto& h: header_) {
+            fields << csvField(h);
+        }
+        if (file_.write((fields.join(',') + '\n').toUtf8()) < 0) {
+            return false;
+        }
+    }
+
+    QStringList fields;
+    fields << csvField(record.station) << schema.model() << formatTime(record.timestamp_ms);
+    for (int column = CSV_META_COLUMNS; column < header_.size(); column++) {
+        const auto index = schema.indexOf(header_[column]);
+        if (index < 0) {
+            qCritical() << "RecordWriter::WriteCsv, no column" << header_[column] << "in" << schema.model();
+            return false;
+        }
+        fields << QString::number(record.image[static_cast<size_t>(index)]);
+    }
+    return file_.write((fields.join(',') + '\n').toUtf8()) >= 0;
+}
+
+bool RecordWriter::WriteJson(const DeviceRecord &record) {
+    const auto& schema = *findSchema(record.command);
+    QJsonObject json;
+    json[R_STATION] = record.station;
+    json[J_DEVICENAME] = schema.model();
+    json[R_TIMESTAMP] = formatTime(record.timestamp_ms);
+
+    QJsonArray items;
+    for (size_t i = 0; i < schema.size(); i++) {
+        DeviceItem item;
+        item.makeItem(schema.name(i), schema.min(i), schema.max(i), record.image[i], schema.desc(i));
+        QJsonObject object;
+        item.write(object);
+        items.append(object);
+    }
+    json[J_ITEMS] = items;
+    return file_.write(QJsonDocument(json).toJson(QJsonDocument::Compact) + '\n') >= 0;
+}
+
+size_t RecordWriter::count() const {
+    return count_;
+}
+
+////////////////////////////////////////////////////////
+RecordReader::~RecordReader() {
+    Close();
+}
+
+bool RecordReader::Open(const QString &path) {
+    Close();
+    format_ = RecordFormatOf(path);
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        qCritical() << "RecordReader::Open, failed, error=" << file_.errorString();
+        return false;
+    }
+
+    if (format_ == RF_CSV) {
+        header_ = splitCsv(QString::fromUtf8(trimLine(file_.readLine())));
+        if (header_.size() <= CSV_META_COLUMNS || header_[0] != R_STATION ||
+                header_[1] != J_DEVICENAME || header_[2] != R_TIMESTAMP) {
+            qCritical() << "RecordReader::Open, bad csv header" << header_;
+            file_.close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void RecordReader::Close() {
+    if (file_.isOpen()) {
+        file_.close();
+        qCritical() << "RecordReader::Close, file=" << file_.fileName()
+                    << ", count=" << count_ << ", errors=" << errors_;
+    }
+    header_.clear();
+    columns_.clear();
+    count_ = 0;
+    errors_ = 0;
+}
+
+bool RecordReader::IsOpen() const {
+    return file_.isOpen();
+}
+
+bool RecordReader::Next(DeviceRecord &record) {
+    while (file_.isOpen() && !file_.atEnd()) {
+        const auto line = trimLine(file_.readLine());
+        if (line.trimmed().isEmpty()) {
+            continue;
+        }
+
+        const auto is_ok = (format_ == RF_CSV) ? ParseCsv(line, record) : ParseJson(line, record);
+        if (is_ok) {
+            count_++;
+            return true;
+        }
+        errors_++;
+    }
+    return false;
+}
+
+bool RecordReader::ParseCsv(const QByteArray &line, DeviceRecord &record) {
+    const auto fields = splitCsv(QString::fromUtf8(line));
+    const auto schema = (fields.size() == header_.size()) ? findSchema(fields[1]) : nullptr;
+    if (schema == nullptr || !parseTime(fields[2], &record.timestamp_ms)) {
+        return false;
+    }
+
+    // 列号按机型在第一次遇到时查出，之后直接取用
+    auto it = columns_.find(schema->command());
+    if (it == columns_.end()) {
+        std::vector<int> columns(schema->size(), -1);
+        for (size_t i = 0; i < schema->size(); i++) {
+            const auto column = header_.indexOf(schema->name(i));
+            columns[i] = (column >= CSV_META_COLUMNS) ? column : -1;
+        }
+        it = columns_.emplace(schema->command(), std::move(columns)).first;
+    }
+
+    record.image.resize(schema->size());
+    for (size_t i = 0; i < schema->size(); i++) {
+        bool ok = false;
+        const auto column = it->second[i];
+        const auto value = (column >= 0) ? fields[column].toUInt(&ok) : 0;
+        if (!ok || value > 0xFF) {
+            return false;
+        }
+        record.image[i] = static_cast<ValueType>(value);
+    }
+
+    record.station = fields[0];
+    record.command = schema->command();
+    return schema->isInRange(record.image);
+}
+
+bool RecordReader::ParseJson(const QByteArray &line, DeviceRecord &record) const {
+    QJsonParseError error;
+    const auto doc = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        return false;
+    }
+
+    const auto json = doc.object();
+    const auto schema = findSchema(json[J_DEVICENAME].toString());
+    const auto items = json[J_ITEMS].toArray();
+    if (schema == nullptr || !json[R_STATION].isString() || !parseTime(json[R_TIMESTAMP].toString(), &record.timestamp_ms) ||
+            static_cast<size_t>(items.size()) != schema->size()) {
+        return false;
+    }
+
+    record.image.resize(schema->size());
+    for (int i = 0; i < items.size(); i++) {
+        DeviceItem item;
+        if (!items[i].isObject() || !item.read(items[i].toObject()) ||
+                item.getName() != schema->name(static_cast<size_t>(i))) {
+            return false;
+        }
+        record.image[static_cast<size_t>(i)] = item.getValue();
+    }
+
+    record.station = json[R_STATION].toString();
+    record.command = schema->command();
+    return schema->isInRange(record.image);
+}
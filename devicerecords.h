@@ -0,0 +1,83 @@
+#ifndef DEVICERECORDS_H
+#define DEVICERECORDS_H
+
+#include <map>
+#include <vector>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include "paramimage.h"
+
+// 一台设备的参数记录，批量导入导出时每行一条
+struct DeviceRecord {
+    QString station;            // 写入该设备时使用的串口
+    quint8 command = 0;         // 机型命令字
+    qint64 timestamp_ms = 0;
+    ParamImage image;
+};
+
+// CSV：第一行为表头 station,device_name,timestamp,各参数名称，一个文件只保存一种机型
+// JSON Lines：每行一个 JSON 对象，items 的每一项与参数文件相同，由 DeviceItem 读写
+enum RecordFormat {
+    RF_CSV = 0,
+    RF_JSONL = 1
+};
+
+// 按扩展名区分格式，.csv 以外都按 JSON Lines 处理
+RecordFormat RecordFormatOf(const QString& path);
+
+// 逐条写入，追加到已有文件的末尾；只缓存一行，导出数量不影响内存占用
+class RecordWriter {
+public:
+    RecordWriter() = default;
+    ~RecordWriter();
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    bool Open(const QString& path);
+    void Close();
+    bool IsOpen() const;
+    bool Write(const DeviceRecord& record);
+    size_t count() const;
+
+private:
+    bool WriteCsv(const DeviceRecord& record);
+    bool WriteJson(const DeviceRecord& record);
+
+private:
+    QFile file_;
+    RecordFormat format_ = RF_CSV;
+    QStringList header_;        // CSV 已有的表头，空文件在第一条记录时生成
+    size_t count_ = 0;
+};
+
+// 逐行读取，格式错误、机型不明、名称不符或超出范围的行跳过并计数
+class RecordReader {
+public:
+    RecordReader() = default;
+    ~RecordReader();
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    bool Open(const QString& path);
+    void Close();
+    bool IsOpen() const;
+    // 读到下一条有效记录返回 true，文件结束返回 false
+    bool Next(DeviceRecord& record);
+    size_t count() const;
+    size_t errors() const;
+
+private:
+    bool ParseCsv(const QByteArray& line, DeviceRecord& record);
+    bool ParseJson(const QByteArray& line, DeviceRecord& record) const;
+
+private:
+    QFile file_;
+    RecordFormat format_ = RF_CSV;
+    QStringList header_;
+    std::map<quint8, std::vector<int>> columns_;    // 每种机型各参数在 CSV 中的列号
+    size_t count_ = 0;
+    size_t errors_ = 0;
+};
+
+#endif // DEVICERECORDS_H
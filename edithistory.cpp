@@ -0,0 +1,126 @@
+#include "edithistory.h"
+#include <QDateTime>
+
+constexpr qint64 MERGE_EDIT_MS = 1000;
+
+EditHistory::EditHistory(size_t capacity)
+    : ring_(capacity > 0 ? capacity : 1) {
+}
+
+void EditHistory::Clear() {
+    steps_.clear();
+    current_ = 0;
+}
+
+EditHistory::Delta &EditHistory::At(quint64 pos) {
+    return ring_[static_cast<size_t>(pos % ring_.size())];
+}
+
+void EditHistory::Record(Kind kind, const ParamImage &before, const ParamImage &after) {
+    if (before.size() != after.size()) {
+        Clear();
+        return;
+    }
+
+    std::vector<Delta> deltas;
+    for (size_t i = 0; i < after.size() && i <= 0xFF; i++) {
+        if (before[i] != after[i]) {
+            deltas.push_back({static_cast<quint8>(i), before[i], after[i]});
+        }
+    }
+    if (!deltas.empty()) {
+        Push(kind, deltas);
+    }
+}
+
+void EditHistory::RecordEdit(size_t index, ValueType old_value, ValueType new_value) {
+    if (old_value == new_value || index > 0xFF) {
+        return;
+    }
+
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+    if (current_ == steps_.size() && !steps_.empty()) {
+        auto& last = steps_.back();
+        if (last.kind == EDIT && last.count == 1 && At(last.start).index == index &&
+                now - last.time_ms < MERGE_EDIT_MS) {
+            At(last.start).new_value = new_value;
+            last.time_ms = now;
+            return;
+        }
+    }
+    Push(EDIT, {{static_cast<quint8>(index), old_value, new_value}});
+}
+
+void EditHistory::Push(Kind kind, const std::vector<Delta> &deltas) {
+    if (deltas.size() > ring_.size()) {
+        Clear();
+        return;
+    }
+
+    // 新的一步使重做记录失效
+    steps_.resize(current_);
+    const quint64 head = steps_.empty() ? 0 : steps_.back().start + steps_.back().count;
+    while (!steps_.empty() && head + deltas.size() - steps_.front().start > ring_.size()) {
+        steps_.pop_front();
+    }
+
+    for (size_t i = 0; i < deltas.size(); i++) {
+        At(head + i) = deltas[i];
+    }
+    steps_.push_back({head, static_cast<quint32>(deltas.size()), kind, QDateTime::currentMSecsSinceEpoch()});
+    current_ = steps_.size();
+}
+
+bool EditHistory::CanUndo() const {
+    return current_ > 0;
+}
+
+bool EditHistory::CanRedo() const {
+    return current_ < steps_.size();
+}
+
+size_t EditHistory::UndoCount() const {
+    return current_;
+}
+
+size_t EditHistory::RedoCount() const {
+    return steps_.size() - current_;
+}
+
+bool EditHistory::Undo(ParamImage &image, Kind *kind) {
+    if (!CanUndo()) {
+        return false;
+    }
+
+    const auto& step = steps_[current_ - 1];
+    for (quint32 i = step.count; i > 0; i--) {
+        const auto& d = At(step.start + i - 1);
+        if (d.index < image.size()) {
+            image[d.index] = d.old_value;
+        }
+    }
+    if (kind != nullptr) {
+        *kind = step.kind;
+    }
+    current_--;
+    return true;
+}
+
+bool EditHistory::Redo(ParamImage &image, Kind *kind) {
+    if (!CanRedo()) {
+        return false;
+    }
+
+    const auto& step = steps_[current_];
+    for (quint32 i = 0; i < step.count; i++) {
+        const auto& d = At(step.start + i);
+        if (d.index < image.size()) {
+            image[d.index] = d.new_value;
+        }
+    }
+    if (kind != nullptr) {
+        *kind = step.kind;
+    }
+    current_++;
+    return true;
+}
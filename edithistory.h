@@ -0,0 +1,56 @@
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include <deque>
+#include <vector>
+#include "paramimage.h"
+
+// 参数的撤销/重做记录
+// 每一步只保存有变化的参数（序号, 旧值, 新值），所有步骤的记录依次写入一个环形缓冲区，
+// 写满后丢弃最早的步骤；同一机型内有效，切换机型时清空
+class EditHistory {
+public:
+    enum Kind {EDIT, READ, LOAD};
+
+    explicit EditHistory(size_t capacity = DEFAULT_CAPACITY);
+
+    void Clear();
+    // before 与 after 逐项比较，没有变化时不记录
+    void Record(Kind kind, const ParamImage& before, const ParamImage& after);
+    // 连续拖动同一个参数时合并为一步
+    void RecordEdit(size_t index, ValueType old_value, ValueType new_value);
+
+    bool CanUndo() const;
+    bool CanRedo() const;
+    size_t UndoCount() const;
+    size_t RedoCount() const;
+    // 在 image 上直接改回旧值 / 重新设为新值
+    bool Undo(ParamImage& image, Kind* kind = nullptr);
+    bool Redo(ParamImage& image, Kind* kind = nullptr);
+
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+private:
+    struct Delta {
+        quint8 index;
+        ValueType old_value;
+        ValueType new_value;
+    };
+
+    struct Step {
+        quint64 start;          // 第一条记录在缓冲区中的绝对位置
+        quint32 count;
+        Kind kind;
+        qint64 time_ms;
+    };
+
+    void Push(Kind kind, const std::vector<Delta>& deltas);
+    Delta& At(quint64 pos);
+
+private:
+    std::vector<Delta> ring_;
+    std::deque<Step> steps_;
+    size_t current_ = 0;        // steps_[0, current_) 可撤销，其余可重做
+};
+
+#endif // EDITHISTORY_H
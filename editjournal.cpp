@@ -0,0 +1,241 @@
+#include "editjournal.h"
+#include "profilefile.h"
+#include <QDir>
+#include <QSaveFile>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char* AUTOSAVE_FOLDER = "autosave";
+static const char* SNAPSHOT_FILE = "params.snapshot";
+static const char* JOURNAL_FILE = "params.journal";
+
+constexpr quint32 EJ_MAGIC = 0x4A454B43;    // "CKEJ"
+constexpr quint32 EJ_SNAPSHOT_MAGIC = 0x53454B43;   // "CKES"
+// 快照头: magic(4) 代号(8)，之后是完整的 ProfileFile 内容
+constexpr int EJ_SNAPSHOT_HEADER_SIZE = 12;
+// 日志头: magic(4) 基于的快照代号(8)
+constexpr int EJ_HEADER_SIZE = 12;
+// 记录: tag(1) 命令字(1) 序号(1) 数值(1) 校验(1)，写到一半的记录校验不通过，恢复时丢弃
+constexpr int EJ_RECORD_SIZE = 5;
+constexpr quint8 EJ_RECORD_TAG = 0xE5;
+constexpr int EJ_SYNC_INTERVAL_MS = 500;
+constexpr int EJ_COMPACT_RECORDS = 256;
+
+static bool syncFile(QFile& file) {
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+static quint8 recordCheck(const uchar* record) {
+    return static_cast<quint8>(~(record[0] + record[1] + record[2] + record[3]));
+}
+
+EditJournal::EditJournal() {
+    timer_.setInterval(EJ_SYNC_INTERVAL_MS);
+    connect(&timer_, &QTimer::timeout, this, [this]() { OnTimer(); });
+}
+
+EditJournal::~EditJournal() {
+    Close(false);
+}
+
+QString EditJournal::DefaultDir() {
+    return QDir::current().filePath(AUTOSAVE_FOLDER);
+}
+
+QString EditJournal::SnapshotPath() const {
+    return QDir(dir_).filePath(SNAPSHOT_FILE);
+}
+
+QString EditJournal::JournalPath() const {
+    return QDir(dir_).filePath(JOURNAL_FILE);
+}
+
+bool EditJournal::Open(const QString &dir) {
+    dir_ = dir;
+    if (!QDir().mkpath(dir_)) {
+        qCritical() << "EditJournal::Open, failed to create" << dir_;
+        return false;
+    }
+    return true;
+}
+
+void EditJournal::Close(bool discard) {
+    timer_.stop();
+    if (journal_.isOpen()) {
+        if (!discard) {
+            syncFile(journal_);
+        }
+        journal_.close();
+    }
+    if (discard && !dir_.isEmpty()) {
+        QFile::remove(JournalPath());
+        QFile::remove(SnapshotPath());
+    }
+    records_ = 0;
+    unsynced_ = false;
+    snapshot_pending_ = false;
+}
+
+bool EditJournal::IsOpen() const {
+    return journal_.isOpen();
+}
+
+bool EditJournal::Recover(quint8 command, ParamImage &image) const {
+    if (dir_.isEmpty()) {
+        return false;
+    }
+
+    QFile snapshot(SnapshotPath());
+    if (!snapshot.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const auto snapshot_data = snapshot.readAll();
+    const auto s = reinterpret_cast<const uchar*>(snapshot_data.constData());
+    ProfileView view;
+    if (snapshot_data.size() < EJ_SNAPSHOT_HEADER_SIZE || qFromLittleEndian<quint32>(s) != EJ_SNAPSHOT_MAGIC ||
+        !ProfileFile::Parse(s + EJ_SNAPSHOT_HEADER_SIZE, snapshot_data.size() - EJ_SNAPSHOT_HEADER_SIZE, &view) ||
+        view.command != command) {
+        return false;
+    }
+    const auto generation = qFromLittleEndian<quint64>(s + 4);
+    ParamImage recovered(view.values, view.values + view.count);
+
+    // 只重放基于这份快照的日志，遇到不完整或损坏的记录即停止
+    int replayed = 0;
+    QFile journal(JournalPath());
+    if (journal.open(QIODevice::ReadOnly)) {
+        const auto data = journal.readAll();
+        const auto p = reinterpret_cast<const uchar*>(data.constData());
+        if (data.size() >= EJ_HEADER_SIZE &&
+            qFromLittleEndian<quint32>(p) == EJ_MAGIC &&
+            qFromLittleEndian<quint64>(p + 4) == generation) {
+            for (int pos = EJ_HEADER_SIZE; pos + EJ_RECORD_SIZE <= data.size(); pos += EJ_RECORD_SIZE) {
+                const uchar* r = p + pos;
+                if (r[0] != EJ_RECORD_TAG || r[4] != recordCheck(r) || r[1] != command || r[2] >= recovered.size()) {
+                    break;
+                }
+                recovered[r[2]] = r[3];
+                replayed++;
+            }
+        }
+    }
+
+    qCritical() << "EditJournal::Recover, command=" << command << ", replayed=" << replayed;
+    image = std::move(recovered);
+    return true;
+}
+
+void EditJournal::Reset(quint8 command, const ParamImage &image) {
+    if (dir_.isEmpty() || (command == command_ && image == image_ && journal_.isOpen())) {
+        return;
+    }
+
+    command_ = command;
+    image_ = image;
+    snapshot_pending_ = true;
+    // 本次运行的第一份快照立即写入，之后的编辑才有基准
+    if (!journal_.isOpen()) {
+        Compact();
+    }
+}
+
+void EditJournal::Record(quint8 command, size_t index, ValueType value) {
+    if (dir_.isEmpty() || command != command_ || index >= image_.size()) {
+        return;
+    }
+
+    image_[index] = value;
+    // 快照落后于当前参数时，日志必须基于新快照
+    if (snapshot_pending_ || !journal_.isOpen()) {
+        Compact();
+        return;
+    }
+
+    uchar record[EJ_RECORD_SIZE] = {EJ_RECORD_TAG, command, static_cast<uchar>(index), value, 0};
+    record[4] = recordCheck(record);
+    if (journal_.write(reinterpret_cast<const char*>(record), EJ_RECORD_SIZE) != EJ_RECORD_SIZE || !journal_.flush()) {
+        qCritical() << "EditJournal::Record, write failed, error=" << journal_.errorString();
+        snapshot_pending_ = true;
+        return;
+    }
+    records_++;
+    unsynced_ = true;
+}
+
+void EditJournal::Sync() {
+    if (unsynced_ && journal_.isOpen()) {
+        unsynced_ = !syncFile(journal_);
+    }
+}
+
+bool EditJournal::StartJournal(quint64 generation) {
+    if (journal_.isOpen()) {
+        journal_.close();
+    }
+
+    journal_.setFileName(JournalPath());
+    if (!journal_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "EditJournal::StartJournal, failed, error=" << journal_.errorString();
+        return false;
+    }
+
+    uchar header[EJ_HEADER_SIZE];
+    qToLittleEndian<quint32>(EJ_MAGIC, header);
+    qToLittleEndian<quint64>(generation, header + 4);
+    if (journal_.write(reinterpret_cast<const char*>(header), EJ_HEADER_SIZE) != EJ_HEADER_SIZE || !syncFile(journal_)) {
+        journal_.close();
+        return false;
+    }
+
+    records_ = 0;
+    unsynced_ = false;
+    if (!timer_.isActive()) {
+        timer_.start();
+    }
+    return true;
+}
+
+// 先替换快照再重建日志；两步之间异常退出时旧日志的代号与新快照不符，不会被重放
+bool EditJournal::Compact() {
+    if (image_.empty()) {
+        return false;
+    }
+
+    const auto generation = QRandomGenerator::system()->generate64();
+    uchar header[EJ_SNAPSHOT_HEADER_SIZE];
+    qToLittleEndian<quint32>(EJ_SNAPSHOT_MAGIC, header);
+    qToLittleEndian<quint64>(generation, header + 4);
+    const auto data = ProfileFile::Encode(command_, image_);
+    QSaveFile file(SnapshotPath());
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(reinterpret_cast<const char*>(header), EJ_SNAPSHOT_HEADER_SIZE) != EJ_SNAPSHOT_HEADER_SIZE ||
+        file.write(data) != data.size() || !file.commit()) {
+        qCritical() << "EditJournal::Compact, snapshot failed, error=" << file.errorString();
+        return false;
+    }
+
+    snapshot_pending_ = !StartJournal(generation);
+    return !snapshot_pending_;
+}
+
+void EditJournal::OnTimer() {
+    if (snapshot_pending_ || records_ >= EJ_COMPACT_RECORDS) {
+        Compact();
+    } else {
+        Sync();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QFile>
+#include <QObject>
+#include <QTimer>
+#include "paramimage.h"
+
+// 参数编辑的自动保存
+// 快照为 代号 + ProfileFile 内容，通过临时文件替换写入；之后的每次编辑追加到日志，
+// 每份快照生成新的随机代号，日志头记录所基于快照的代号，快照更新后旧日志自动失效
+// 日志每条记录都立即写入系统缓存，定时批量 fsync；记录数较多或整体替换后定时压缩为新快照
+// 正常退出时删除，下次启动仍存在说明上次异常退出，按 快照 + 日志 恢复
+class EditJournal: public QObject {
+public:
+    EditJournal();
+    ~EditJournal();
+
+    static QString DefaultDir();
+
+    bool Open(const QString& dir = DefaultDir());
+    void Close(bool discard);
+    bool IsOpen() const;
+
+    // 读取上次异常退出时的参数，机型不同或没有记录时返回 false
+    bool Recover(quint8 command, ParamImage& image) const;
+    // 参数整体变化（加载、读取设备、切换机型），稍后写入新快照
+    void Reset(quint8 command, const ParamImage& image);
+    void Record(quint8 command, size_t index, ValueType value);
+
+    void Sync();
+    bool Compact();
+
+private:
+    QString SnapshotPath() const;
+    QString JournalPath() const;
+    bool StartJournal(quint64 generation);
+    void OnTimer();
+
+private:
+    QString dir_;
+    QFile journal_;
+    QTimer timer_;
+    quint8 command_ = 0;
+    ParamImage image_;
+    int records_ = 0;           // 当前日志中的记录数
+    bool unsynced_ = false;
+    bool snapshot_pending_ = false;
+};
+
+#endif // EDITJOURNAL_H
@@ -0,0 +1,401 @@
+#include "imagekernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE_KERNELS_X86
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define IMAGE_KERNELS_X86
+#include <intrin.h>
+#include <immintrin.h>
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+constexpr size_t PACK_CHUNK = 256;      // 打包时每次计算校验和的镜像数
+constexpr size_t MAX_PATTERN = 32 * 64; // 向量化范围检查支持的最大镜像长度为 64 字节
+
+using ValidateFn = size_t (*)(const ValueType* mins, const ValueType* maxs, size_t stride,
+                              const ValueType* images, size_t count, quint8* ok);
+using ChecksumFn = void (*)(const ValueType* images, size_t count, size_t stride, quint8* sums);
+
+static bool checkOne(const ValueType* mins, const ValueType* maxs, size_t stride, const ValueType* image) {
+    unsigned int bad = 0;
+    for (size_t j = 0; j < stride; j++) {
+        bad |= static_cast<unsigned int>(image[j] < mins[j]) | static_cast<unsigned int>(image[j] > maxs[j]);
+    }
+    return bad == 0;
+}
+
+static quint8 sumOne(const ValueType* image, size_t stride) {
+    unsigned int sum = static_cast<unsigned int>(stride);
+    for (size_t j = 0; j < stride; j++) {
+        sum += image[j];
+    }
+    return static_cast<quint8>(sum & 0xFF);
+}
+
+static size_t validateScalar(const ValueType* mins, const ValueType* maxs, size_t stride,
+                             const ValueType* images, size_t count, quint8* ok) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+        ok[i] = checkOne(mins, maxs, stride, images + i * stride) ? 1 : 0;
+        valid += ok[i];
+    }
+    return valid;
+}
+
+static void checksumScalar(const ValueType* images, size_t count, size_t stride, quint8* sums) {
+    for (size_t i = 0; i < count; i++) {
+        sums[i] = sumOne(images + i * stride, stride);
+    }
+}
+
+#ifdef IMAGE_KERNELS_X86
+// W 个镜像共 W * stride 字节，正好是 stride 个向量；把范围重复 W 次后逐向量比较
+// 整块都在范围内时一次标记 W 个镜像，有超限的块再逐个确认
+template <size_t W>
+static void makePattern(const ValueType* src, size_t stride, ValueType* pattern) {
+    for (size_t k = 0; k < W; k++) {
+        memcpy(pattern + k * stride, src, stride);
+    }
+}
+
+TARGET_SSE2
+static size_t validateSse2(const ValueType* mins, const ValueType* maxs, size_t stride,
+                           const ValueType* images, size_t count, quint8* ok) {
+    constexpr size_t W = 16;
+    if (stride * W > MAX_PATTERN) {
+        return validateScalar(mins, maxs, stride, images, count, ok);
+    }
+
+    alignas(16) ValueType lo[MAX_PATTERN];
+    alignas(16) ValueType hi[MAX_PATTERN];
+    makePattern<W>(mins, stride, lo);
+    makePattern<W>(maxs, stride, hi);
+
+    size_t valid = 0;
+    size_t i = 0;
+    for (; i + W <= count; i += W) {
+        const ValueType* block = images + i * stride;
+        __m128i bad = _mm_setzero_si128();
+        for (size_t j = 0; j < stride; j++) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + j * W));
+            const __m128i l = _mm_load_si128(reinterpret_cast<const __m128i*>(lo + j * W));
+            const __m128i h = _mm_load_si128(reinterpret_cast<const __m128i*>(hi + j * W));
+            const __m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, l), v),
+                                             _mm_cmpeq_epi8(_mm_min_epu8(v, h), v));
+            bad = _mm_or_si128(bad, _mm_andnot_si128(in, _mm_set1_epi8(-1)));
+        }
+        if (_mm_movemask_epi8(bad) == 0) {
+            memset(ok + i, 1, W);
+            valid += W;
+        } else {
+            valid += validateScalar(mins, maxs, stride, block, W, ok + i);
+        }
+    }
+    return valid + validateScalar(mins, maxs, stride, images + i * stride, count - i, ok + i);
+}
+
+TARGET_AVX2
+static size_t validateAvx2(const ValueType* mins, const ValueType* maxs, size_t stride,
+                           const ValueType* images, size_t count, quint8* ok) {
+    constexpr size_t W = 32;
+    if (stride * W > MAX_PATTERN) {
+        return validateScalar(mins, maxs, stride, images, count, ok);
+    }
+
+    alignas(32) ValueType lo[MAX_PATTERN];
+    alignas(32) ValueType hi[MAX_PATTERN];
+    makePattern<W>(mins, stride, lo);
+    makePattern<W>(maxs, stride, hi);
+
+    size_t valid = 0;
+    size_t i = 0;
+    for (; i + W <= count; i += W) {
+        const ValueType* block = images + i * stride;
+        __m256i bad = _mm256_setzero_si256();
+        for (size_t j = 0; j < stride; j++) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + j * W));
+            const __m256i l = _mm256_load_si256(reinterpret_cast<const __m256i*>(lo + j * W));
+            const __m256i h = _mm256_load_si256(reinterpret_cast<const __m256i*>(hi + j * W));
+            const __m256i in = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, l), v),
+                                                _mm256_cmpeq_epi8(_mm256_min_epu8(v, h), v));
+            bad = _mm256_or_si256(bad, _mm256_andnot_si256(in, _mm256_set1_epi8(-1)));
+        }
+        if (_mm256_movemask_epi8(bad) == 0) {
+            memset(ok + i, 1, W);
+            valid += W;
+        } else {
+            valid += validateScalar(mins, maxs, stride, block, W, ok + i);
+        }
+    }
+    return valid + validateScalar(mins, maxs, stride, images + i * stride, count - i, ok + i);
+}
+
+// 镜像不超过 16 字节时，每个镜像一次读取 16 字节，屏蔽多余部分后用 SAD 求和
+// 最后几个镜像读取会越过数据末尾，改用逐字节求和
+static size_t vectorCount(size_t count, size_t stride) {
+    if (stride == 0 || stride > 16 || count == 0) {
+        return 0;
+    }
+    const size_t total = count * stride;
+    return (total < 16) ? 0 : (total - 16) / stride + 1;
+}
+
+static const ValueType* tailMask(size_t stride) {
+    alignas(16) static const ValueType ones[32] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    };
+    return ones + 16 - stride;  // 前 stride 个字节为 0xFF
+}
+
+TARGET_SSE2
+static void checksumSse2(const ValueType* images, size_t count, size_t stride, quint8* sums) {
+    const size_t n = vectorCount(count, stride);
+    if (n > 0) {
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tailMask(stride)));
+        const __m128i zero = _mm_setzero_si128();
+        for (size_t i = 0; i < n; i++) {
+            const __m128i v = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(images + i * stride)), mask);
+            const __m128i s = _mm_sad_epu8(v, zero);
+            const unsigned int sum = static_cast<unsigned int>(_mm_cvtsi128_si32(s) + _mm_extract_epi16(s, 4));
+            sums[i] = static_cast<quint8>((sum + stride) & 0xFF);
+        }
+    }
+    checksumScalar(images + n * stride, count - n, stride, sums + n);
+}
+
+TARGET_AVX2
+static void checksumAvx2(const ValueType* images, size_t count, size_t stride, quint8* sums) {
+    const size_t n = vectorCount(count, stride) & ~static_cast<size_t>(1);
+    if (n > 0) {
+        const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tailMask(stride)));
+        const __m256i mask = _mm256_inserti128_si256(_mm256_castsi128_si256(half), half, 1);
+        const __m256i zero = _mm256_setzero_si256();
+        for (size_t i = 0; i < n; i += 2) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(images + i * stride));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(images + (i + 1) * stride));
+            const __m256i v = _mm256_and_si256(_mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1), mask);
+            const __m256i s = _mm256_sad_epu8(v, zero);
+            const unsigned int sa = static_cast<unsigned int>(_mm256_extract_epi16(s, 0) + _mm256_extract_epi16(s, 4));
+            const unsigned int sb = static_cast<unsigned int>(_mm256_extract_epi16(s, 8) + _mm256_extract_epi16(s, 12));
+            sums[i] = static_cast<quint8>((sa + stride) & 0xFF);
+            sums[i + 1] = static_cast<quint8>((sb + stride) & 0xFF);
+        }
+    }
+    checksumScalar(images + n * stride, count - n, stride, sums + n);
+}
+
+static bool cpuHasAvx2() {
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+    __cpuidex(info, 7, 0);
+    return os_avx && (info[1] & (1 << 5));
+#endif
+}
+
+static bool cpuHasSse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    int info[4] = {};
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#endif
+}
+#endif // IMAGE_KERNELS_X86
+
+static std::atomic<int> current_isa(-1);
+
+ImageKernels::Isa ImageKernels::BestIsa() {
+#ifdef IMAGE_KERNELS_X86
+    static const Isa best = cpuHasAvx2() ? ISA_AVX2 : (cpuHasSse2() ? ISA_SSE2 : ISA_SCALAR);
+    return best;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+ImageKernels::Isa ImageKernels::CurrentIsa() {
+    int isa = current_isa.load(std::memory_order_relaxed);
+    if (isa < 0) {
+        isa = BestIsa();
+        current_isa.store(isa, std::memory_order_relaxed);
+        qCritical() << "ImageKernels, isa=" << IsaName(static_cast<Isa>(isa));
+    }
+    return static_cast<Isa>(isa);
+}
+
+bool ImageKernels::SetIsa(Isa isa) {
+    if (isa > BestIsa()) {
+        return false;
+    }
+    current_isa.store(isa, std::memory_order_relaxed);
+    return true;
+}
+
+const char *ImageKernels::IsaName(Isa isa) {
+    switch (isa) {
+    case ISA_AVX2: return "avx2";
+    case ISA_SSE2: return "sse2";
+    default:       return "scalar";
+    }
+}
+
+static ValidateFn validateFn() {
+#ifdef IMAGE_KERNELS_X86
+    switch (ImageKernels::CurrentIsa()) {
+    case ImageKernels::ISA_AVX2: return validateAvx2;
+    case ImageKernels::ISA_SSE2: return validateSse2;
+    default: break;
+    }
+#endif
+    return validateScalar;
+}
+
+static ChecksumFn checksumFn() {
+#ifdef IMAGE_KERNELS_X86
+    switch (ImageKernels::CurrentIsa()) {
+    case ImageKernels::ISA_AVX2: return checksumAvx2;
+    case ImageKernels::ISA_SSE2: return checksumSse2;
+    default: break;
+    }
+#endif
+    return checksumScalar;
+}
+
+size_t ImageKernels::Validate(const ModelSchema &schema, const ValueType *images, size_t count, quint8 *ok) {
+    if (images == nullptr || ok == nullptr || count == 0 || schema.size() == 0) {
+        return 0;
+    }
+    return validateFn()(schema.mins().data(), schema.maxs().data(), schema.size(), images, count, ok);
+}
+
+void ImageKernels::Checksum(const ValueType *images, size_t count, size_t stride, quint8 *sums) {
+    if (images == nullptr || sums == nullptr || count == 0 || stride == 0) {
+        return;
+    }
+    checksumFn()(images, count, stride, sums);
+}
+
+size_t ImageKernels::Pack(quint8 cmd, const ValueType *images, size_t count, size_t stride, char *out) {
+    if (images == nullptr || out == nullptr || stride == 0 || stride > 0xFF) {
+        return 0;
+    }
+
+    const auto checksum = checksumFn();
+    const size_t frame = stride + 3;
+    quint8 sums[PACK_CHUNK];
+    for (size_t i = 0; i < count; i += PACK_CHUNK) {
+        const size_t n = std::min(PACK_CHUNK, count - i);
+        checksum(images + i * stride, n, stride, sums);
+        for (size_t k = 0; k < n; k++) {
+            char* p = out + (i + k) * frame;
+            p[0] = static_cast<char>(cmd);
+            p[1] = static_cast<char>(stride);
+            memcpy(p + 2, images + (i + k) * stride, stride);
+            p[stride + 2] = static_cast<char>(sums[k]);
+        }
+    }
+    return count * frame;
+}
+
+size_t ImageKernels::Validate(const ImageStore &store, std::vector<quint8> &ok) {
+    ok.resize(store.size());
+    return Validate(store.schema(), store.data(), store.size(), ok.data());
+}
+
+QByteArray ImageKernels::Pack(quint8 cmd, const ImageStore &store) {
+    QByteArray frames;
+    frames.resize(static_cast<int>(store.size() * (store.stride() + 3)));
+    Pack(cmd, store.data(), store.size(), store.stride(), frames.data());
+    return frames;
+}
+
+////////////////////////////////////////////////////////
+std::vector<ImageBenchResult> ImageBench::Run(const ModelSchema &schema, size_t images, int rounds) {
+    std::vector<ImageBenchResult> results;
+    if (images == 0 || rounds <= 0 || schema.size() == 0) {
+        return results;
+    }
+
+    // 约百分之一的镜像带一个超限值，走到逐个确认的分支
+    ImageStore store(schema);
+    store.reserve(images);
+    std::mt19937 rng(20240501);
+    ParamImage image(schema.size());
+    for (size_t i = 0; i < images; i++) {
+        for (size_t j = 0; j < image.size(); j++) {
+            std::uniform_int_distribution<int> dist(schema.min(j), schema.max(j));
+            image[j] = static_cast<ValueType>(dist(rng));
+        }
+        if (rng() % 100 == 0 && schema.min(0) > 0) {
+            image[0] = 0;
+        }
+        store.append(image);
+    }
+
+    const auto saved = ImageKernels::CurrentIsa();
+    std::vector<quint8> expected_ok;
+    QByteArray expected_frames;
+    for (int isa = ImageKernels::ISA_SCALAR; isa <= ImageKernels::BestIsa(); isa++) {
+        ImageKernels::SetIsa(static_cast<ImageKernels::Isa>(isa));
+        ImageBenchResult result;
+        result.isa = static_cast<ImageKernels::Isa>(isa);
+        result.images = images;
+
+        std::vector<quint8> ok;
+        QElapsedTimer timer;
+        timer.start();
+        for (int r = 0; r < rounds; r++) {
+            ImageKernels::Validate(store, ok);
+        }
+        result.validate_per_sec = images * rounds * 1e9 / std::max<qint64>(timer.nsecsElapsed(), 1);
+
+        QByteArray frames;
+        timer.restart();
+        for (int r = 0; r < rounds; r++) {
+            frames = ImageKernels::Pack(0xAA, store);
+        }
+        result.pack_per_sec = images * rounds * 1e9 / std::max<qint64>(timer.nsecsElapsed(), 1);
+
+        if (isa == ImageKernels::ISA_SCALAR) {
+            expected_ok = ok;
+            expected_frames = frames;
+        } else {
+            result.matches_scalar = (ok == expected_ok && frames == expected_frames);
+        }
+        results.push_back(result);
+    }
+    ImageKernels::SetIsa(saved);
+    return results;
+}
+
+QString ImageBench::Summary(const std::vector<ImageBenchResult> &results) {
+    QString summary;
+    for (const auto& r: results) {
+        summary += QString("%1: images=%2, validate=%3 M/s, pack=%4 M/s%5\n")
+                .arg(QString(ImageKernels::IsaName(r.isa)), -6)
+                .arg(r.images)
+                .arg(r.validate_per_sec / 1e6, 0, 'f', 2)
+                .arg(r.pack_per_sec / 1e6, 0, 'f', 2)
+                .arg(r.matches_scalar ? "" : ", MISMATCH");
+    }
+    return summary;
+}
@@ -0,0 +1,45 @@
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#include <vector>
+#include <QString>
+#include "paramimage.h"
+
+// 参数镜像的批量处理：范围检查、校验和、打包成下发帧
+// 按 CPU 支持的指令集在运行时选择实现，不支持时使用逐字节的版本
+class ImageKernels {
+public:
+    enum Isa {ISA_SCALAR, ISA_SSE2, ISA_AVX2};
+
+    static Isa BestIsa();
+    static Isa CurrentIsa();
+    static bool SetIsa(Isa isa);        // CPU 不支持时返回 false，测速时用来对比
+    static const char* IsaName(Isa isa);
+
+    // images 中连续存放 count 个镜像，每个 schema.size() 字节；ok 中每个镜像一个字节，1 表示范围正确
+    static size_t Validate(const ModelSchema& schema, const ValueType* images, size_t count, quint8* ok);
+    // 校验和：字节数 + 各个数据 之和的最低字节，与 DataTransfer::GetCheckSum 一致
+    static void Checksum(const ValueType* images, size_t count, size_t stride, quint8* sums);
+    // 每帧为 命令 字节数 数据 校验和，out 至少 count * (stride + 3) 字节，返回写入的字节数
+    static size_t Pack(quint8 cmd, const ValueType* images, size_t count, size_t stride, char* out);
+
+    static size_t Validate(const ImageStore& store, std::vector<quint8>& ok);
+    static QByteArray Pack(quint8 cmd, const ImageStore& store);
+};
+
+struct ImageBenchResult {
+    ImageKernels::Isa isa = ImageKernels::ISA_SCALAR;
+    size_t images = 0;
+    double validate_per_sec = 0;
+    double pack_per_sec = 0;
+    bool matches_scalar = true;     // 结果与逐字节版本一致
+};
+
+// 随机生成镜像，分别用各指令集处理，输出每秒处理的镜像数
+class ImageBench {
+public:
+    static std::vector<ImageBenchResult> Run(const ModelSchema& schema, size_t images, int rounds);
+    static QString Summary(const std::vector<ImageBenchResult>& results);
+};
+
+#endif // IMAGEKERNELS_H
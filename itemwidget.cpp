@@ -1,16 +1,44 @@
 #include "itemwidget.h"
 #include "mainwindow.h"
 #include <string>
+#include <QPixmapCache>
+#include <QtConcurrent>
 
 constexpr unsigned int VSP_MIN = 0;
 constexpr unsigned int VSP_MAX = 222;
 constexpr unsigned int POLE_MIN = 1;
 constexpr unsigned int POLE_MAX = 250;
-constexpr unsigned int MAX_ITEM_COUNT = 13;
 constexpr const char* ICON_BUTTON_ON = ":/images/button_on.png";
 constexpr const char* ICON_BUTTON_OFF = ":/images/button_off.png";
 constexpr const char* ICON_SWITCH_ON = ":/images/switch_on.png";
 constexpr const char* ICON_SWITCH_OFF = ":/images/switch_off.png";
+constexpr QSize DEBUG_ICON_SIZE(100, 100);
+constexpr QSize SWITCH_ICON_SIZE(87, 32);
+
+struct IconSpec {
+    const char* path;
+    QSize size;
+};
+
+static QString iconKey(const IconSpec& spec) {
+    return QString("%1@%2x%3").arg(spec.path).arg(spec.size.width()).arg(spec.size.height());
+}
+
+// 原图远大于按钮，按显示尺寸缩放后缓存，切换状态时不再重新解码
+static QImage decodeIcon(const IconSpec& spec) {
+    return QImage(spec.path).scaled(spec.size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+static QIcon cachedIcon(const char* path, const QSize& size) {
+    const IconSpec spec = {path, size};
+    const auto key = iconKey(spec);
+    QPixmap pixmap;
+    if (!QPixmapCache::find(key, &pixmap)) {
+        pixmap = QPixmap::fromImage(decodeIcon(spec));
+        QPixmapCache::insert(key, pixmap);
+    }
+    return QIcon(pixmap);
+}
 
 void DeviceBindData(MainWindow* ui) {
     assert(ui != nullptr);
@@ -18,37 +46,30 @@ void DeviceBindData(MainWindow* ui) {
         return;
     }
 
-   const auto& items = DeviceManager::Instance().getItems();
-   ui->removeItemsConnection();
-
-   ItemWidgetHelper item_widget(ui);
-   unsigned int index = 1;
-   for (const auto& item: items) {
-       item_widget.Reset(index++);
-       item_widget.SetVisible(true);
-       item_widget.SetValue(item);
-   }
-
-   while (index <= MAX_ITEM_COUNT) {
-       item_widget.Reset(index++);
-       item_widget.SetVisible(false);
-   }
+   const auto& devMgr = DeviceManager::Instance();
+   ui->paramModel().bind(devMgr.getSchema(), devMgr.getImage());
+   DeviceBindReference(ui);
 }
 
-void DeviceEnableState(MainWindow* ui, bool enable) {
+// 设备和文件中的参数只用于对比，不改变界面上的数值
+void DeviceBindReference(MainWindow* ui) {
     assert(ui != nullptr);
     if (ui == nullptr) {
         return;
     }
 
-   const auto& items = DeviceManager::Instance().getItems();
-   ui->removeItemsConnection();
+   const auto& devMgr = DeviceManager::Instance();
+   ui->paramModel().setReference(ParamDiff::DEVICE, devMgr.getDeviceImage());
+   ui->paramModel().setReference(ParamDiff::FILE, devMgr.getFileImage());
+}
 
-   ItemWidgetHelper item_widget(ui);
-   for (unsigned int index = 1; index <= items.size(); index++) {
-       item_widget.Reset(index);
-       item_widget.Enable(enable);
-   }
+void DeviceEnableState(MainWindow* ui, bool enable) {
+    assert(ui != nullptr);
+    if (ui == nullptr) {
+        return;
+    }
+
+   ui->paramModel().setEditable(enable);
 }
 
 DbgWidgetMgr::DbgWidgetMgr() {
@@ -105,6 +126,28 @@ bool DbgWidgetMgr::IsInDebugging() {
     return is_in_debugging;
 }
 
+bool DbgWidgetMgr::IsFrOn() const {
+    return is_fr_on;
+}
+
+bool DbgWidgetMgr::IsBkOn() const {
+    return is_bk_on;
+}
+
+// QImage 可以在工作线程中解码，QPixmap 只能在界面线程中创建
+void DbgWidgetMgr::PreloadIcons() {
+    const QList<IconSpec> specs = {
+        {ICON_BUTTON_ON, DEBUG_ICON_SIZE},
+        {ICON_BUTTON_OFF, DEBUG_ICON_SIZE},
+        {ICON_SWITCH_ON, SWITCH_ICON_SIZE},
+        {ICON_SWITCH_OFF, SWITCH_ICON_SIZE}
+    };
+    const auto images = QtConcurrent::blockingMapped<QList<QImage>>(specs, decodeIcon);
+    for (int i = 0; i < specs.size(); i++) {
+        QPixmapCache::insert(iconKey(specs[i]), QPixmap::fromImage(images[i]));
+    }
+}
+
 void DbgWidgetMgr::setEnableDbgState(bool enable) {
     if (pb_debug_switch) {
         pb_debug_switch->setEnabled(enable);
@@ -173,9 +216,8 @@ void DbgWidgetMgr::setDebugIcon() {
         return;
     }
 
-    QIcon icon((is_in_debugging ? ICON_BUTTON_OFF : ICON_BUTTON_ON));
-    pb_debug_switch->setIcon(icon);
-    pb_debug_switch->setIconSize(QSize(100, 100));
+    pb_debug_switch->setIcon(cachedIcon((is_in_debugging ? ICON_BUTTON_OFF : ICON_BUTTON_ON), DEBUG_ICON_SIZE));
+    pb_debug_switch->setIconSize(DEBUG_ICON_SIZE);
 }
 
 void DbgWidgetMgr::setFrIcon() {
@@ -183,9 +225,8 @@ void DbgWidgetMgr::setFrIcon() {
         return;
     }
 
-    QIcon icon((is_fr_on ? ICON_SWITCH_OFF : ICON_SWITCH_ON));
-    pb_fr->setIcon(icon);
-    pb_fr->setIconSize(QSize(87, 32));
+    pb_fr->setIcon(cachedIcon((is_fr_on ? ICON_SWITCH_OFF : ICON_SWITCH_ON), SWITCH_ICON_SIZE));
+    pb_fr->setIconSize(SWITCH_ICON_SIZE);
 }
 
 void DbgWidgetMgr::setBkIcon() {
@@ -193,9 +234,8 @@ void DbgWidgetMgr::setBkIcon() {
         return;
     }
 
-    QIcon icon((is_bk_on ? ICON_SWITCH_OFF : ICON_SWITCH_ON));
-    pb_bk->setIcon(icon);
-    pb_bk->setIconSize(QSize(87, 32));
+    pb_bk->setIcon(cachedIcon((is_bk_on ? ICON_SWITCH_OFF : ICON_SWITCH_ON), SWITCH_ICON_SIZE));
+    pb_bk->setIconSize(SWITCH_ICON_SIZE);
 }
 
 void DbgWidgetMgr::initVSP() {
@@ -208,8 +248,8 @@ void DbgWidgetMgr::initVSP() {
     }
 
     slider->setRange(VSP_MIN, VSP_MAX);
-    edit->setValidator(new QIntValidator(VSP_MIN, VSP_MAX));
-    ui->connectItemChange(slider, edit, false);
+    edit->setValidator(new QIntValidator(VSP_MIN, VSP_MAX, edit));
+    ui->connectItemChange(slider, edit);
     edit->setText("0");
 }
 
@@ -237,84 +277,3 @@ void DbgWidgetMgr::initPole() {
 
     flickPI(is_pi_checked_);
 }
-
-void ItemWidgetHelper::SetValue(const DeviceItem& item) {
-    if (name != nullptr) {
-        name->setText(item.getName());
-    }
-
-    if (min != nullptr && max != nullptr) {
-        min->setText(item.getMinString());
-        max->setText(item.getMaxString());
-    }
-
-    if (desc != nullptr) {
-        desc->setText(item.getDesc());
-    }
-
-    if (slider != nullptr && edit != nullptr) {
-        slider->setRange(item.getMin(), item.getMax());
-        edit->setValidator(new QIntValidator(item.getMin(), item.getMax()));
-    }
-    if (ui != nullptr) {
-        ui->connectItemChange(slider, edit);
-    }
-    if (edit != nullptr) {
-        edit->setText(item.getValueString());
-    }
-}
-
-void ItemWidgetHelper::SetVisible(bool is_visible) {
-    if (name != nullptr) {
-        name->setVisible(is_visible);
-    }
-
-    if (min != nullptr && max != nullptr) {
-        min->setVisible(is_visible);
-        max->setVisible(is_visible);
-    }
-
-    if (desc != nullptr) {
-        desc->setVisible(is_visible);
-    }
-
-    if (slider != nullptr && edit != nullptr) {
-        slider->setVisible(is_visible);
-        edit->setVisible(is_visible);
-    }
-}
-
-void ItemWidgetHelper::Enable(bool enable) {
-    if (slider != nullptr && edit != nullptr) {
-        slider->setEnabled(enable);
-        edit->setEnabled(enable);
-    }
-}
-
-void ItemWidgetHelper::Reset(unsigned int index) {
-    name = nullptr;
-    min = nullptr;
-    max = nullptr;
-    desc = nullptr;
-    slider = nullptr;
-    edit = nullptr;
-
-    if (ui == nullptr) {
-        return;
-    }
-
-    const std::string prefix = "item_" + std::to_string(index++) + "_";
-    name = ui->findChild<QLabel*>(std::string(prefix+"name").c_str());
-
-    min = ui->findChild<QLabel*>(std::string(prefix+"min").c_str());
-    max = ui->findChild<QLabel*>(std::string(prefix+"max").c_str());
-
-    desc = ui->findChild<QLabel*>(std::string(prefix+"desc").c_str());
-
-    slider = ui->findChild<QSlider*>(std::string(prefix+"range").c_str());
-    edit = ui->findChild<QLineEdit*>(std::string(prefix+"value").c_str());
-}
-
-ItemWidgetHelper::ItemWidgetHelper(MainWindow *mw) {
-    ui = mw;
-}
@@ -7,24 +7,9 @@
 #include <QSlider>
 
 class MainWindow;
-class ItemWidgetHelper {
-public:
-    ItemWidgetHelper(MainWindow* mw);
-    void Reset(unsigned int index);
-    void SetValue(const DeviceItem& item);
-    void SetVisible(bool is_visible);
-    void Enable(bool enable);
 
-private:
-    MainWindow* ui = nullptr;
-    QLabel* name = nullptr;
-    QLabel* min = nullptr;
-    QLabel* max = nullptr;
-    QLabel* desc = nullptr;
-    QSlider* slider = nullptr;
-    QLineEdit* edit = nullptr;
-};
 void DeviceBindData(MainWindow* ui);
+void DeviceBindReference(MainWindow* ui);
 void DeviceEnableState(MainWindow* ui, bool enable);
 
 class DbgWidgetMgr {
@@ -42,6 +27,10 @@ void EnableDebugBtn();
     void setEnableDbgState(bool enable);
     void setEnableState(bool enable, bool is_global = true);
     bool IsInDebugging();
+    bool IsFrOn() const;
+    bool IsBkOn() const;
+    // 在工作线程中并行解码按钮图片并放入缓存
+    static void PreloadIcons();
 
 private:
     void findAllItems();
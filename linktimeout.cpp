@@ -0,0 +1,86 @@
+#include "linktimeout.h"
+#include <algorithm>
+
+constexpr size_t RESPONSE_WINDOW = 64;
+constexpr size_t MIN_SAMPLES = 8;
+constexpr qint64 DEVICE_TURNAROUND_US = 20000;  // 没有样本时假定的设备处理时间
+constexpr qint64 USB_LATENCY_US = 16000;        // USB 转串口的缓冲延迟
+constexpr double RESPONSE_PERCENTILE = 0.99;
+constexpr double RESPONSE_MARGIN = 1.5;
+constexpr qint64 MIN_TIMEOUT_MS = 10;
+constexpr qint64 MAX_TIMEOUT_MS = 1000;
+
+TimeoutModel::TimeoutModel() {
+    samples_.reserve(RESPONSE_WINDOW);
+}
+
+int TimeoutModel::BitsPerByte(const SettingsDialog::Settings &settings) {
+    int bits = 1 + static_cast<int>(settings.dataBits);
+    if (settings.parity != QSerialPort::NoParity) {
+        bits += 1;
+    }
+    bits += (settings.stopBits == QSerialPort::OneStop) ? 1 : 2;
+    return bits;
+}
+
+void TimeoutModel::SetLink(const SettingsDialog::Settings &settings) {
+    const auto bits = BitsPerByte(settings);
+    if (settings.baudRate != baud_rate_ || bits != bits_per_byte_) {
+        baud_rate_ = settings.baudRate;
+        bits_per_byte_ = bits;
+        Clear();
+    }
+}
+
+qint64 TimeoutModel::FrameTimeUs(int byte_count) const {
+    if (baud_rate_ <= 0) {
+        return 0;
+    }
+    return static_cast<qint64>(byte_count) * bits_per_byte_ * 1000000 / baud_rate_;
+}
+
+void TimeoutModel::AddResponse(qint64 us) {
+    if (samples_.size() < RESPONSE_WINDOW) {
+        samples_.push_back(us);
+    } else {
+        samples_[next_] = us;
+    }
+    next_ = (next_ + 1) % RESPONSE_WINDOW;
+}
+
+void TimeoutModel::Clear() {
+    samples_.clear();
+    next_ = 0;
+}
+
+qint64 TimeoutModel::ResponseTimeoutMs(int request_bytes, int response_bytes) const {
+    const auto transfer_us = FrameTimeUs(request_bytes + response_bytes) + USB_LATENCY_US;
+
+    qint64 timeout_us = transfer_us + DEVICE_TURNAROUND_US;
+    if (samples_.size() >= MIN_SAMPLES) {
+        // 实测值已包含传输时间，但不能低于传输本身所需的时间
+        const auto measured_us = static_cast<qint64>(Percentile(RESPONSE_PERCENTILE) * RESPONSE_MARGIN);
+        timeout_us = std::max(transfer_us, measured_us);
+    }
+
+    return std::min(MAX_TIMEOUT_MS, std::max(MIN_TIMEOUT_MS, (timeout_us + 999) / 1000));
+}
+
+qint64 TimeoutModel::Percentile(double p) const {
+    if (samples_.empty()) {
+        return 0;
+    }
+
+    auto sorted = samples_;
+    const auto index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(index), sorted.end());
+    return sorted[index];
+}
+
+QString TimeoutModel::toString() const {
+    return QString("baud=%1, samples=%2, p50=%3us, p99=%4us")
+            .arg(baud_rate_)
+            .arg(samples_.size())
+            .arg(Percentile(0.5))
+            .arg(Percentile(RESPONSE_PERCENTILE));
+}
@@ -0,0 +1,36 @@
+#ifndef LINKTIMEOUT_H
+#define LINKTIMEOUT_H
+
+#include <vector>
+#include <QString>
+#include "settingsdialog.h"
+
+// 应答超时模型
+// 基准值 = 命令与应答在当前波特率下的传输时间 + 设备处理时间
+// 积累足够样本后，按实测应答时间的高百分位放宽或收紧
+class TimeoutModel {
+public:
+    TimeoutModel();
+
+    // 波特率或帧格式变化时清空已有样本
+    void SetLink(const SettingsDialog::Settings& settings);
+    qint64 FrameTimeUs(int byte_count) const;
+    // 每个字节在线路上占用的位数：起始位 + 数据位 + 校验位 + 停止位
+    static int BitsPerByte(const SettingsDialog::Settings& settings);
+
+    // 从发出命令到收到完整应答的时间
+    void AddResponse(qint64 us);
+    void Clear();
+
+    qint64 ResponseTimeoutMs(int request_bytes, int response_bytes) const;
+    qint64 Percentile(double p) const;
+    QString toString() const;
+
+private:
+    qint32 baud_rate_ = 0;
+    int bits_per_byte_ = 10;
+    std::vector<qint64> samples_;   // 最近的应答时间，环形覆盖
+    size_t next_ = 0;
+};
+
+#endif // LINKTIMEOUT_H
@@ -1,15 +1,33 @@
 #include "mainwindow.h"
 #include "logutils.h"
+#include "startupbench.h"
+#include "imagekernels.h"
+#include "deviceitem.h"
 
 #include <QApplication>
+#include <QTextStream>
 
 int main(int argc, char *argv[])
 {
+#ifdef Q_OS_WIN
     FreeConsole();
+#endif
+    auto& bench = StartupBench::Instance();
+    bench.Start();
     QApplication a(argc, argv);
     LOGUTILS::initLogging();
+    bench.Mark("application");
+
+    // 参数镜像批量处理测速，输出各指令集每秒处理的镜像数后退出
+    if (a.arguments().contains("--image-benchmark")) {
+        const auto& schema = DeviceManager::getSchema(DeviceManager::DeviceType::CK3864S);
+        QTextStream(stdout) << ImageBench::Summary(ImageBench::Run(schema, 1000000, 10)) << Qt::flush;
+        return 0;
+    }
 
     MainWindow w;
+    bench.Mark("main window");
     w.show();
+    bench.WatchFirstFrame(&w, a.arguments().contains("--startup-benchmark"));
     return a.exec();
 }
@@ -3,31 +3,60 @@
 #include <iomanip>
 #include "ui_mainwindow.h"
 #include "datatransfer.h"
+#include "debugger.h"
+#include "telemetryanalytics.h"
+#include "startupsim.h"
+#include "serialbench.h"
+#include "portwatcher.h"
+#include "startupbench.h"
+#include "profilefile.h"
+#include "profilelibrary.h"
+#include "devicerecords.h"
+#include "programhistory.h"
+#include "baudprobe.h"
+#include <QtConcurrent>
 
 constexpr const char* ICON_LOGO = ":/images/logo.jpg";
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       ui(new Ui::MainWindow),
-      m_status(new QLabel) {
+      m_status(new QLabel),
+      ui_refresh_([this]() { DeviceBindData(this); }) {
             ui->setupUi(this);
     // setWindowFlags(Qt::Dialog | Qt::MSWindowsFixedSizeDialogHint);
     setFixedSize(width(), height());
     ui->statusbar->addWidget(m_status);
     setStatus(QString::fromWCharArray(DISCONNECTED));
     DataTransfer::Instance()->SetShowStatusCallback(this);
+    Debugger::Instance()->SetShowStatusCallback(this);
     SerialComm::Instance()->SetShowStatusCallback(this);
+    // logo 在第一帧之后才显示，先在后台解码；按钮图片第一帧就要用，并行解码
+    logo_image_ = QtConcurrent::run([]() { return QImage(ICON_LOGO); });
+    connect(&baud_probe_, &QFutureWatcher<qint32>::finished, this, &MainWindow::onBaudProbed);
+    connect(&discovery_, &QFutureWatcher<std::vector<DiscoveredDevice>>::finished,
+            this, &MainWindow::onDevicesDiscovered);
+    DbgWidgetMgr::PreloadIcons();
     widgetMgr.init(this);
+    initParamView();
+    if (auto screen = QGuiApplication::primaryScreen()) {
+        ui_refresh_.SetFrameRate(screen->refreshRate());
+    }
 
-    setLogo();
     createAction();
     connectDbgItems();
-    deviceTypeChanged(CK3864S);
+    warm_state_ = WarmState::Load();
+    restoreDeviceType();
     setDisconnectMode();
+
+    connect(PortWatcher::Instance(), &PortWatcher::portAdded, this, &MainWindow::onPortAdded);
 }
 
 MainWindow::~MainWindow() {
+    // 正常退出不保留自动保存
+    journal_.Close(true);
     DataTransfer::Instance()->SetShowStatusCallback(nullptr);
+    Debugger::Instance()->SetShowStatusCallback(nullptr);
     SerialComm::Instance()->SetShowStatusCallback(nullptr);
 
     delete m_status;
@@ -43,29 +72,198 @@ void MainWindow::setLogo() {
         assert(false);
         return;
     }
-    QPixmap image(ICON_LOGO);
-    view->setPixmap(image);
+    view->setPixmap(QPixmap::fromImage(logo_image_.result()));
     view->setScaledContents(true);
 }
 
-void MainWindow::removeItemsConnection() {
-    for (auto c: item_connections) {
-        QObject::disconnect(c);
+ParamTableModel &MainWindow::paramModel() {
+    return param_model_;
+}
+
+const UiRefreshGate &MainWindow::uiRefresh() const {
+    return ui_refresh_;
+}
+
+// 工具栏按钮不抢焦点，正在编辑的数值需要手动提交
+// 先补上尚未显示的设备数据，再提交编辑框，以操作员最后的输入为准
+void MainWindow::commitParamEdits() {
+    ui_refresh_.Flush();
+    QTableView* view = ui->tv_items;
+    const QModelIndex index = view->currentIndex();
+    QWidget* editor = index.isValid() ? view->indexWidget(index) : nullptr;
+    if (editor != nullptr) {
+        view->itemDelegate()->setModelData(editor, &param_model_, index);
     }
-    item_connections.clear();
+}
+
+void MainWindow::initParamView() {
+    connect(&param_model_, &ParamTableModel::valueEdited, this, &MainWindow::onValueEdited);
+    connect(&param_model_, &ParamTableModel::imageBound, this, &MainWindow::onImageBound);
+
+    QTableView* view = ui->tv_items;
+    view->setModel(&param_model_);
+    view->setItemDelegate(new ParamItemDelegate(view));
+    view->setEditTriggers(QAbstractItemView::AllEditTriggers);
+    view->setSelectionMode(QAbstractItemView::NoSelection);
+    view->setWordWrap(false);
+    view->verticalHeader()->hide();
+    // 行高固定，参数再多也不用逐行计算尺寸
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(36);
+
+    auto header = view->horizontalHeader();
+    header->setSectionResizeMode(QHeaderView::Fixed);
+    header->resizeSection(ParamTableModel::COL_NAME, 120);
+    header->resizeSection(ParamTableModel::COL_MIN, 36);
+    header->resizeSection(ParamTableModel::COL_RANGE, 210);
+    header->resizeSection(ParamTableModel::COL_MAX, 36);
+    header->resizeSection(ParamTableModel::COL_VALUE, 60);
+    header->setStretchLastSection(true);
 }
 
 void MainWindow::deviceTypeChanged(const QString &type) {
+   if (!loadDefaults(type)) {
+       return;
+   }
+
+   WarmState::SaveModel(type, false);
+   DeviceBindData(this);
+}
+
+bool MainWindow::loadDefaults(const QString &type) {
    if (type == CK3862S) {
        DeviceManager::Instance().load_CK3862S_Default();
    }  else if (type == CK3864S) {
        DeviceManager::Instance().load_CK3864S_Default();
    } else {
        assert(false);
-       return;
+       return false;
    }
+   return true;
+}
 
-   DeviceBindData(this);
+// 恢复上次的型号和参数来源，只绑定一次界面
+void MainWindow::restoreDeviceType() {
+    {
+        const QSignalBlocker blocker(type_combo_);
+        type_combo_->setCurrentText(warm_state_.model);
+    }
+
+    loadDefaults(type_combo_->currentText());
+    if (warm_state_.profile_loaded) {
+        auto& devMgr = DeviceManager::Instance();
+        if (!devMgr.load_from_file(DeviceManager::Binary)) {
+            devMgr.load_from_file(DeviceManager::Json);
+        }
+    }
+    DeviceBindData(this);
+    recoverEdits();
+}
+
+void MainWindow::onValueEdited(int row, ValueType old_value, ValueType value) {
+    const auto index = static_cast<size_t>(row);
+    journal_.Record(param_model_.schema().command(), index, value);
+    if (index < history_base_.size()) {
+        history_.RecordEdit(index, old_value, value);
+        history_base_[index] = value;
+    }
+    updateHistoryActions();
+}
+
+// 设备读取、加载参数后界面整体更新，只记录有变化的项；切换机型后旧记录不再适用
+void MainWindow::onImageBound() {
+    const auto& schema = param_model_.schema();
+    const auto& image = param_model_.image();
+    journal_.Reset(schema.command(), image);
+
+    if (schema.command() != history_command_ || history_base_.size() != image.size()) {
+        history_.Clear();
+    } else if (!applying_history_) {
+        history_.Record(bind_kind_, history_base_, image);
+    }
+    history_command_ = schema.command();
+    history_base_ = image;
+    bind_kind_ = EditHistory::READ;
+    updateHistoryActions();
+}
+
+void MainWindow::undo() {
+    stepHistory(true);
+}
+
+void MainWindow::redo() {
+    stepHistory(false);
+}
+
+// 只改动有变化的行，不需要重新绑定整个表格
+void MainWindow::stepHistory(bool is_undo) {
+    commitParamEdits();
+    ParamImage image = param_model_.image();
+    auto kind = EditHistory::EDIT;
+    const auto is_ok = is_undo ? history_.Undo(image, &kind) : history_.Redo(image, &kind);
+    if (!is_ok) {
+        return;
+    }
+
+    applying_history_ = true;
+    param_model_.bind(param_model_.schema(), image);
+    applying_history_ = false;
+
+    const wchar_t* source = (kind == EditHistory::EDIT) ? L"修改" : (kind == EditHistory::LOAD ? L"加载" : L"读取");
+    setStatus(QString::fromWCharArray(L"%1%2，可撤销 %3 步，可重做 %4 步")
+              .arg(QString::fromWCharArray(is_undo ? UNDO_EDIT : REDO_EDIT))
+              .arg(QString::fromWCharArray(source))
+              .arg(history_.UndoCount()).arg(history_.RedoCount()));
+}
+
+void MainWindow::updateHistoryActions() {
+    if (undo_act_ != nullptr && redo_act_ != nullptr) {
+        undo_act_->setEnabled(history_.CanUndo());
+        redo_act_->setEnabled(history_.CanRedo());
+    }
+}
+
+// 自动保存还在说明上次异常退出，恢复当时界面上的参数，之后的编辑开始记录
+void MainWindow::recoverEdits() {
+    if (!journal_.Open()) {
+        return;
+    }
+
+    const auto& schema = param_model_.schema();
+    ParamImage recovered;
+    if (journal_.Recover(schema.command(), recovered) && schema.isInRange(recovered) &&
+            recovered != param_model_.image()) {
+        param_model_.bind(schema, recovered);
+        setStatus(QString::fromWCharArray(L"已恢复上次未保存的参数"));
+    }
+    journal_.Reset(schema.command(), param_model_.image());
+}
+
+void MainWindow::paintEvent(QPaintEvent *event) {
+    QMainWindow::paintEvent(event);
+    if (!first_frame_done_) {
+        first_frame_done_ = true;
+        QTimer::singleShot(0, this, &MainWindow::deferredInit);
+    }
+}
+
+// 第一帧之后再做的初始化：显示 logo、开始监视串口、打开生产记录、重连上次的端口
+void MainWindow::deferredInit() {
+    setLogo();
+    PortWatcher::Instance()->Start();
+    if (!ProgramHistory::Instance().Open()) {
+        qCritical() << "MainWindow::deferredInit, failed to open program history";
+    }
+    StartupBench::Instance().Mark("deferred init");
+
+    if (warm_state_.port.isEmpty() || !PortWatcher::Instance()->contains(warm_state_.port)) {
+        return;
+    }
+    qCritical() << "MainWindow::deferredInit, warm reconnect" << warm_state_.port;
+    if (SerialComm::Instance()->selectPort(warm_state_.port)) {
+        openSerialPort();
+        StartupBench::Instance().Mark("warm reconnect");
+    }
 }
 
 bool MainWindow::isConnected() {
@@ -84,10 +282,19 @@ void MainWindow::setDisconnectMode() {
     qCritical() << "MainWindow::SetDisconnectMode";
     op_mode_ = OP_MODE::DISCONNECT;
 
+    auto dbg = Debugger::Instance();
+    dbg->SetDataChangedCallback(nullptr);
+    dbg->Stop();
+
     auto dt = DataTransfer::Instance();
     dt->SetDataChangedCallback(nullptr);
     dt->Close();
 
+    ui_refresh_.Flush();
+    if (ui_refresh_.GetRequestCount() > 0) {
+        qCritical() << "MainWindow::SetDisconnectMode, ui refresh:" << ui_refresh_.toString();
+        ui_refresh_.ClearStats();
+    }
     widgetMgr.setEnableState(false);
     DeviceEnableState(this, false);
 }
@@ -96,6 +303,10 @@ void MainWindow::setNormalMode() {
     qCritical() << "MainWindow::SetNormalMode";
     op_mode_ = OP_MODE::NORMAL;
 
+    auto dbg = Debugger::Instance();
+    dbg->SetDataChangedCallback(nullptr);
+    dbg->Stop();
+
     auto dt = DataTransfer::Instance();
     dt->SetDataChangedCallback(this);
     dt->Open();
@@ -112,6 +323,14 @@ void MainWindow::setDebugMode() {
     dt->SetDataChangedCallback(nullptr);
     dt->Close();
 
+    auto dbg = Debugger::Instance();
+    dbg->SetDataChangedCallback(this);
+    dbg->Start();
+    dbg->StartRecording();
+    if (!play_act_->isEnabled()) {
+        setStatus(QString::fromWCharArray(PLAY_UNSUPPORTED));
+    }
+
     widgetMgr.setEnableState(true);
     DeviceEnableState(this, false);
 }
@@ -123,9 +342,13 @@ void MainWindow::load() {
         return;
     }
 
+    // 优先加载二进制参数文件，没有时再读 JSON
     auto& devMgr = DeviceManager::Instance();
-    auto is_ok = devMgr.load_from_file(DeviceManager::Json);
+    auto is_ok = devMgr.load_from_file(DeviceManager::Binary) ||
+                 devMgr.load_from_file(DeviceManager::Json);
     if (is_ok) {
+        WarmState::SaveModel(type_combo_->currentText(), true);
+        bind_kind_ = EditHistory::LOAD;
         DeviceBindData(this);
     }
 }
@@ -139,8 +362,80 @@ bool MainWindow::save() {
 
     auto& devMgr = DeviceManager::Instance();
     devMgr.refreshItemData(this);
-    devMgr.save_to_file(DeviceManager::Json);
-    return true;
+    // JSON 便于查看和手工修改，二进制文件用于快速加载
+    const auto is_ok = devMgr.save_to_file(DeviceManager::Json) &&
+                       devMgr.save_to_file(DeviceManager::Binary);
+    DeviceBindReference(this);
+    return is_ok;
+}
+
+// 从参数库中选择当前机型的配方，索引已在内存中，切换不需要读文件
+void MainWindow::loadRecipe() {
+    qCritical() << "MainWindow::loadRecipe, op_mode=" << static_cast<int>(op_mode_);
+    if (!isInNormalMode()) {
+        assert(false);
+        return;
+    }
+
+    auto& library = ProfileLibrary::Instance();
+    auto& devMgr = DeviceManager::Instance();
+    const auto names = library.Open() ? library.Names(devMgr.getSchema().command()) : QStringList();
+    if (names.isEmpty()) {
+        setStatus(QString::fromWCharArray(L"参数库中没有 %1 的配方").arg(devMgr.getSchema().model()));
+        return;
+    }
+
+    bool ok = false;
+    const auto name = QInputDialog::getItem(this, QString::fromWCharArray(LOAD_RECIPE),
+                                            QString::fromWCharArray(RECIPE_NAME), names, 0, false, &ok);
+    const auto entry = ok ? library.Find(name) : nullptr;
+    if (entry == nullptr) {
+        return;
+    }
+
+    ProfileView view;
+    view.command = entry->command;
+    view.values = entry->image.data();
+    view.count = entry->image.size();
+    if (devMgr.loadImage(view)) {
+        bind_kind_ = EditHistory::LOAD;
+        DeviceBindData(this);
+        setStatus(QString::fromWCharArray(L"已加载配方 %1 v%2").arg(entry->name).arg(entry->version));
+    }
+}
+
+void MainWindow::saveRecipe() {
+    qCritical() << "MainWindow::saveRecipe, op_mode=" << static_cast<int>(op_mode_);
+    if (!isInNormalMode()) {
+        assert(false);
+        return;
+    }
+
+    bool ok = false;
+    const auto name = QInputDialog::getText(this, QString::fromWCharArray(SAVE_RECIPE),
+                                            QString::fromWCharArray(RECIPE_NAME), QLineEdit::Normal,
+                                            QString(), &ok).trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+    const auto tag_text = QInputDialog::getText(this, QString::fromWCharArray(SAVE_RECIPE),
+                                                QString::fromWCharArray(RECIPE_TAGS));
+    QStringList tags;
+    for (const auto& tag: tag_text.split(',', Qt::SkipEmptyParts)) {
+        tags << tag.trimmed();
+    }
+
+    auto& devMgr = DeviceManager::Instance();
+    devMgr.refreshItemData(this);
+    auto& library = ProfileLibrary::Instance();
+    const auto entry = library.Open()
+            ? library.Save(name, devMgr.getSchema().command(), devMgr.getImage(), tags)
+            : nullptr;
+    if (entry != nullptr) {
+        setStatus(QString::fromWCharArray(L"已保存配方 %1 v%2，共 %3 个版本，%4 个参数文件")
+                  .arg(entry->name).arg(entry->version)
+                  .arg(library.EntryCount()).arg(library.ObjectCount()));
+    }
 }
 
 void MainWindow::write() {
@@ -169,6 +464,212 @@ void MainWindow::help() {
     qCritical() << "MainWindow::help";
 }
 
+void MainWindow::analyzeRecords() {
+    qCritical() << "MainWindow::analyzeRecords";
+    const auto paths = QFileDialog::getOpenFileNames(this, QString::fromWCharArray(ANALYZE_RECORDS),
+                                                     "records", "Telemetry (*.ckt)");
+    if (paths.isEmpty()) {
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const auto limits = LimitSettings::FromDeviceManager();
+    const auto stats = TelemetryAnalytics::AnalyzeAll(paths, limits);
+    QDir().mkpath("records");
+    const auto report = QString("records/Report_%1.csv")
+            .arg(QDateTime::currentDateTime().toString("yyyy_MM_dd__hh_mm_ss"));
+    const auto is_ok = TelemetryAnalytics::WriteReport(report, stats);
+    QApplication::restoreOverrideCursor();
+
+    int failed = 0;
+    for (const auto& s: stats) {
+        if (!s.IsWithinLimits()) {
+            failed++;
+        }
+    }
+    qCritical() << "MainWindow::analyzeRecords, count=" << stats.size()
+                << ", failed=" << failed << ", report=" << report << ", result=" << is_ok;
+    setStatus(QString::fromWCharArray(L"分析完成 %1 个记录，超限 %2 个，报告 %3")
+              .arg(stats.size()).arg(failed).arg(report));
+}
+
+// 生产记录中当前机型的每台设备导出一行，逐条读取逐条写入，记录再多内存占用也不变
+void MainWindow::exportRecords() {
+    qCritical() << "MainWindow::exportRecords";
+    auto& history = ProgramHistory::Instance();
+    if (!history.Open()) {
+        setStatus(QString::fromWCharArray(L"无法打开生产记录"));
+        return;
+    }
+
+    const auto path = QFileDialog::getSaveFileName(this, QString::fromWCharArray(EXPORT_RECORDS), "records",
+                                                   "Records (*.csv *.jsonl)", nullptr,
+                                                   QFileDialog::DontConfirmOverwrite);
+    RecordWriter writer;
+    if (path.isEmpty() || !writer.Open(path)) {
+        return;
+    }
+
+    const auto command = param_model_.schema().command();
+    size_t others = 0;
+    bool is_ok = true;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    for (size_t i = 0; i < history.size() && is_ok; i++) {
+        const auto unit = history.At(i);
+        if (unit.command != command) {
+            others++;
+            continue;
+        }
+
+        DeviceRecord record;
+        record.station = unit.station;
+        record.command = unit.command;
+        record.timestamp_ms = unit.timestamp_ms;
+        record.image = unit.image;
+        is_ok = writer.Write(record);
+    }
+    QApplication::restoreOverrideCursor();
+
+    qCritical() << "MainWindow::exportRecords, path=" << path << ", count=" << writer.count()
+                << ", others=" << others << ", result=" << is_ok;
+    setStatus(is_ok ? QString::fromWCharArray(L"已导出 %1 台 %2 的生产记录到 %3，其它机型 %4 条")
+                      .arg(writer.count()).arg(param_model_.schema().model()).arg(path).arg(others)
+                    : QString::fromWCharArray(L"导出失败，文件中的机型或参数与当前不符: %1").arg(path));
+}
+
+// 逐条读取记录，按块与界面上的参数比较，记录再多内存占用也不变
+void MainWindow::importRecords() {
+    qCritical() << "MainWindow::importRecords";
+    const auto path = QFileDialog::getOpenFileName(this, QString::fromWCharArray(IMPORT_RECORDS), "records",
+                                                   "Records (*.csv *.jsonl)");
+    RecordReader reader;
+    if (path.isEmpty() || !reader.Open(path)) {
+        return;
+    }
+
+    commitParamEdits();
+    constexpr size_t IMPORT_BLOCK = 1 << 16;
+    const auto& schema = param_model_.schema();
+    const auto& recipe = param_model_.image();
+    ImageStore store(schema);
+    store.reserve(IMPORT_BLOCK);
+    std::vector<quint64> item_counts(schema.size(), 0);
+    size_t matched = 0;
+    size_t others = 0;
+    const auto compare = [&]() {
+        const auto result = ParamDiff::Compare(recipe, store);
+        matched += result.matched;
+        for (size_t i = 0; i < result.item_counts.size(); i++) {
+            item_counts[i] += result.item_counts[i];
+        }
+        store.clear();
+    };
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    DeviceRecord record;
+    while (reader.Next(record)) {
+        if (record.command != schema.command()) {
+            others++;
+            continue;
+        }
+        store.append(record.image);
+        if (store.size() == IMPORT_BLOCK) {
+            compare();
+        }
+    }
+    compare();
+    QApplication::restoreOverrideCursor();
+
+    QString worst = "-";
+    const auto it = std::max_element(item_counts.begin(), item_counts.end());
+    if (it != item_counts.end() && *it > 0) {
+        worst = QString("%1 (%2)").arg(schema.name(static_cast<size_t>(it - item_counts.begin()))).arg(*it);
+    }
+    qCritical() << "MainWindow::importRecords, path=" << path << ", count=" << reader.count()
+                << ", matched=" << matched << ", others=" << others << ", errors=" << reader.errors();
+    setStatus(QString::fromWCharArray(L"导入 %1 条记录，%2 与当前参数一致 %3 条，差异最多: %4，其它机型 %5 条，错误 %6 行")
+              .arg(reader.count()).arg(schema.model()).arg(matched).arg(worst).arg(others).arg(reader.errors()));
+}
+
+// 最近一周按界面上的参数写入的台数，以及各串口的平均校验耗时
+void MainWindow::programHistory() {
+    qCritical() << "MainWindow::programHistory";
+    auto& history = ProgramHistory::Instance();
+    if (!history.Open()) {
+        setStatus(QString::fromWCharArray(L"无法打开生产记录"));
+        return;
+    }
+
+    commitParamEdits();
+    constexpr qint64 WEEK_MS = 7LL * 24 * 3600 * 1000;
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+    const auto units = history.FindByImage(param_model_.schema().command(), param_model_.image(), now - WEEK_MS);
+    QStringList stations;
+    for (const auto& s: history.Stations()) {
+        qCritical() << "MainWindow::programHistory, station=" << s.station << ", count=" << s.count
+                    << ", avg verify ms=" << s.avg_verify_ms << ", avg total ms=" << s.avg_total_ms;
+        stations << QString("%1 %2ms").arg(s.station).arg(s.avg_verify_ms, 0, 'f', 1);
+    }
+    setStatus(QString::fromWCharArray(L"共 %1 条记录，最近一周按当前参数写入 %2 台，平均校验耗时: %3")
+              .arg(history.size()).arg(units.size()).arg(stations.isEmpty() ? "-" : stations.join(", ")));
+}
+
+void MainWindow::simulateStartup() {
+    qCritical() << "MainWindow::simulateStartup";
+    MotorModel motor;
+    const auto has_model = motor.load("motor.json");
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const auto candidates = StartupSimulator::MakeGrid(StartupParams::FromDeviceManager());
+    const auto results = StartupSimulator(motor).Evaluate(candidates);
+    QDir().mkpath("records");
+    const auto report = QString("records/Startup_%1.csv")
+            .arg(QDateTime::currentDateTime().toString("yyyy_MM_dd__hh_mm_ss"));
+    const auto is_ok = StartupSimulator::WriteReport(report, candidates, results);
+    QApplication::restoreOverrideCursor();
+
+    int succeeded = 0;
+    float fastest = 0.0f;
+    for (const auto& r: results) {
+        if (r.success) {
+            fastest = (succeeded == 0) ? r.time_ms : std::min(fastest, r.time_ms);
+            succeeded++;
+        }
+    }
+    qCritical() << "MainWindow::simulateStartup, motor.json=" << has_model
+                << ", candidates=" << candidates.size() << ", succeeded=" << succeeded
+                << ", report=" << report << ", result=" << is_ok;
+    setStatus(QString::fromWCharArray(L"仿真 %1 组参数，成功 %2 组，最快 %3 ms，报告 %4")
+              .arg(candidates.size()).arg(succeeded).arg(static_cast<double>(fastest), 0, 'f', 1)
+              .arg(report));
+}
+
+void MainWindow::playTrajectory() {
+    qCritical() << "MainWindow::playTrajectory, op_mode=" << static_cast<int>(op_mode_);
+    if (!isInDebugMode()) {
+        return;
+    }
+
+    auto dbg = Debugger::Instance();
+    if (dbg->IsPlaying()) {
+        dbg->StopTrajectory();
+        return;
+    }
+
+    const auto path = QFileDialog::getOpenFileName(this, QString::fromWCharArray(PLAY_TRAJECTORY),
+                                                   QString(), "Trajectory (*.trj *.txt)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    Trajectory trajectory;
+    if (!trajectory.load(path) || !dbg->PlayTrajectory(trajectory)) {
+        setStatus(QString::fromWCharArray(L"无法回放轨迹 %1").arg(path));
+        return;
+    }
+    setStatus(QString::fromWCharArray(L"正在回放轨迹 %1").arg(path));
+}
+
 void MainWindow::onDbgBtnClicked() {
     qCritical() << "MainWindow::onDbgBtnClicked, op_mode=" << static_cast<int>(op_mode_);
     if (!isConnected()) {
@@ -192,6 +693,7 @@ void MainWindow::onFrBtnClicked() {
     }
 
    widgetMgr.flickFr();
+   Debugger::Instance()->SetFr(widgetMgr.IsFrOn());
 }
 
 void MainWindow::onBkBtnClicked() {
@@ -202,6 +704,7 @@ void MainWindow::onBkBtnClicked() {
     }
 
     widgetMgr.flickBk();
+    Debugger::Instance()->SetBk(widgetMgr.IsBkOn());
 }
 
 void MainWindow::onPIChanged(bool checked) {
@@ -232,6 +735,14 @@ void MainWindow::createAction() {
     connect(disconnAct, &QAction::triggered, this, &MainWindow::closeSerialPort);
     commToolBar->addAction(disconnAct);
 
+    QAction *benchAct = new QAction(QString::fromWCharArray(COM_BENCHMARK), this);
+    connect(benchAct, &QAction::triggered, this, &MainWindow::benchmarkSerialPort);
+    commToolBar->addAction(benchAct);
+
+    QAction *discoverAct = new QAction(QString::fromWCharArray(COM_DISCOVER), this);
+    connect(discoverAct, &QAction::triggered, this, &MainWindow::discoverDevices);
+    commToolBar->addAction(discoverAct);
+
     ////////////////////////////////////////////////
     QToolBar *fileToolBar = addToolBar(tr("File"));
     const QIcon openIcon = QIcon::fromTheme("document-open", QIcon(":/images/open.png"));
@@ -246,15 +757,34 @@ void MainWindow::createAction() {
     connect(saveAct, &QAction::triggered, this, &MainWindow::save);
     fileToolBar->addAction(saveAct);
 
+    QAction *loadRecipeAct = new QAction(QString::fromWCharArray(LOAD_RECIPE), this);
+    connect(loadRecipeAct, &QAction::triggered, this, &MainWindow::loadRecipe);
+    fileToolBar->addAction(loadRecipeAct);
+
+    QAction *saveRecipeAct = new QAction(QString::fromWCharArray(SAVE_RECIPE), this);
+    connect(saveRecipeAct, &QAction::triggered, this, &MainWindow::saveRecipe);
+    fileToolBar->addAction(saveRecipeAct);
+
+    undo_act_ = new QAction(QIcon::fromTheme("edit-undo"), QString::fromWCharArray(UNDO_EDIT), this);
+    undo_act_->setShortcuts(QKeySequence::Undo);
+    connect(undo_act_, &QAction::triggered, this, &MainWindow::undo);
+    fileToolBar->addAction(undo_act_);
+
+    redo_act_ = new QAction(QIcon::fromTheme("edit-redo"), QString::fromWCharArray(REDO_EDIT), this);
+    redo_act_->setShortcuts(QKeySequence::Redo);
+    connect(redo_act_, &QAction::triggered, this, &MainWindow::redo);
+    fileToolBar->addAction(redo_act_);
+    updateHistoryActions();
+
     ////////////////////////////////////////////////
     QToolBar *typeToolBar = addToolBar(tr("Type"));
-    QComboBox *typeCombo = new QComboBox;
-    typeCombo->setEditable(false);
-    typeCombo->addItem(CK3864S);
-    typeCombo->addItem(CK3862S);
-    connect(typeCombo, QOverload<const QString &>::of(&QComboBox::currentIndexChanged),
+    type_combo_ = new QComboBox;
+    type_combo_->setEditable(false);
+    type_combo_->addItem(CK3864S);
+    type_combo_->addItem(CK3862S);
+    connect(type_combo_, QOverload<const QString &>::of(&QComboBox::currentIndexChanged),
             this, &MainWindow::deviceTypeChanged);
-    typeToolBar->addWidget(typeCombo);
+    typeToolBar->addWidget(type_combo_);
 
     ////////////////////////////////////////////////
     QToolBar *operToolBar = addToolBar(tr("Operation"));
@@ -268,6 +798,35 @@ void MainWindow::createAction() {
     connect(upAct, &QAction::triggered, this, &MainWindow::read);
     operToolBar->addAction(upAct);
 
+    QAction *analyzeAct = new QAction(QString::fromWCharArray(ANALYZE_RECORDS), this);
+    connect(analyzeAct, &QAction::triggered, this, &MainWindow::analyzeRecords);
+    operToolBar->addAction(analyzeAct);
+
+    QAction *simulateAct = new QAction(QString::fromWCharArray(SIMULATE_STARTUP), this);
+    connect(simulateAct, &QAction::triggered, this, &MainWindow::simulateStartup);
+    operToolBar->addAction(simulateAct);
+
+    // 协议 1 的调试帧不含 VSP，回放无从下发
+    play_act_ = new QAction(QString::fromWCharArray(PLAY_TRAJECTORY), this);
+    connect(play_act_, &QAction::triggered, this, &MainWindow::playTrajectory);
+    if (Debugger::ConfiguredProtocol() != Debugger::PROTOCOL_SETPOINT) {
+        play_act_->setEnabled(false);
+        play_act_->setToolTip(QString::fromWCharArray(PLAY_UNSUPPORTED));
+    }
+    operToolBar->addAction(play_act_);
+
+    QAction *exportAct = new QAction(QString::fromWCharArray(EXPORT_RECORDS), this);
+    connect(exportAct, &QAction::triggered, this, &MainWindow::exportRecords);
+    operToolBar->addAction(exportAct);
+
+    QAction *importAct = new QAction(QString::fromWCharArray(IMPORT_RECORDS), this);
+    connect(importAct, &QAction::triggered, this, &MainWindow::importRecords);
+    operToolBar->addAction(importAct);
+
+    QAction *historyAct = new QAction(QString::fromWCharArray(PROGRAM_HISTORY), this);
+    connect(historyAct, &QAction::triggered, this, &MainWindow::programHistory);
+    operToolBar->addAction(historyAct);
+
     ////////////////////////////////////////////////
     QToolBar *helpToolBar = addToolBar(tr("Help"));
     const QIcon helpIcon = QIcon::fromTheme("document-help", QIcon(":/images/help.png"));
@@ -281,6 +840,7 @@ void MainWindow::connectDbgItems() {
     auto pb_fr = findChild<QPushButton*>("pb_fr");
     auto pb_bk = findChild<QPushButton*>("pb_bk");
     auto gb_pi = findChild<QGroupBox*>("gb_pi");
+    auto sd_vsp = findChild<QSlider*>("sd_vsp");
     assert(pb_power != nullptr && pb_fr != nullptr && pb_bk != nullptr && gb_pi != nullptr);
     if (pb_power) {
         connect(pb_power, SIGNAL(released()), this, SLOT(onDbgBtnClicked()));
@@ -294,25 +854,25 @@ void MainWindow::connectDbgItems() {
     if (gb_pi) {
         connect(gb_pi, SIGNAL(clicked(bool)), this, SLOT(onPIChanged(bool)));
     }
+    if (sd_vsp) {
+        connect(sd_vsp, &QSlider::valueChanged,
+                [](int val)->void{Debugger::Instance()->SetVsp(static_cast<quint8>(val));});
+    }
 }
 
 
-void MainWindow::connectItemChange(QSlider* slider, QLineEdit* edit, bool need_record) {
+// 联动只在初始化时建立一次，控件存续期间一直有效
+void MainWindow::connectItemChange(QSlider* slider, QLineEdit* edit) {
     if (slider == nullptr || edit == nullptr) {
         assert(false);
         return;
     }
 
-    QMetaObject::Connection conn;
-    conn = connect(edit, &QLineEdit::textChanged,
-                   [slider](const QString& val)->void{slider->setValue(val.toInt());});
+    connect(edit, &QLineEdit::textChanged,
+            [slider](const QString& val)->void{slider->setValue(val.toInt());});
 
-    conn =  connect(slider, &QSlider::valueChanged,
-                    [edit](const int& val)->void{edit->setText(std::to_string(val).c_str());});
-
-    if (need_record && conn) {
-        item_connections << conn;
-    }
+    connect(slider, &QSlider::valueChanged,
+            [edit](const int& val)->void{edit->setText(std::to_string(val).c_str());});
 }
 
 void MainWindow::setStatus(const QString &s) {
@@ -321,8 +881,9 @@ void MainWindow::setStatus(const QString &s) {
     }
 }
 
+// 每收到一帧都会调用，合并到下一个显示帧再刷新
 void MainWindow::onDataChange() {
-    DeviceBindData(this);
+    ui_refresh_.Request();
 }
 
 void MainWindow::onError(int err) {
@@ -330,15 +891,122 @@ void MainWindow::onError(int err) {
     setDisconnectMode();
 }
 
+void MainWindow::onTransactionDone(const TransactionResult &result) {
+    if (result.kind == TransactionResult::WRITE && result.isOk()) {
+        DeviceBindReference(this);
+    }
+    setStatus(result.toString());
+}
+
+// 没有记录波特率的端口要逐档等待应答，在工作线程中协商，完成后再连接
 bool MainWindow::openSerialPort() {
+    // 搜索设备时各端口正被探测占用
+    if (discovery_.isRunning()) {
+        setStatus(QString::fromWCharArray(L"正在搜索设备，请稍后连接"));
+        return false;
+    }
+    const auto p = SerialComm::Instance()->settings();
+    if (!p.autoBaud || isConnected() || BaudProbe::IsRemembered(p.name)) {
+        return connectSerialPort();
+    }
+    if (baud_probe_.isRunning()) {
+        return false;
+    }
+
+    qCritical() << "MainWindow::openSerialPort, probe" << p.name;
+    setStatus(QString::fromWCharArray(L"正在协商波特率 %1").arg(p.name));
+    baud_probe_port_ = p.name;
+    baud_probe_.setFuture(QtConcurrent::run([p]() { return BaudProbe::Probe(p); }));
+    return false;
+}
+
+void MainWindow::onBaudProbed() {
+    const auto rate = baud_probe_.result();
+    qCritical() << "MainWindow::onBaudProbed, port=" << baud_probe_port_ << ", rate=" << rate;
+    if (isConnected()) {
+        return;
+    }
+    // 重新选中端口以取得记住的波特率；协商失败时按默认波特率连接，与不协商相同
+    BaudProbe::Remember(baud_probe_port_, rate);
+    if (SerialComm::Instance()->selectPort(baud_probe_port_)) {
+        connectSerialPort();
+    }
+}
+
+bool MainWindow::connectSerialPort() {
     const auto is_ok = SerialComm::Instance()->openSerialPort();
     qCritical() << "MainWindow::openSerialPort, result=" << is_ok;
     if (is_ok) {
+        WarmState::SavePort(SerialComm::Instance()->settings().name);
         setNormalMode();
     }
     return is_ok;
 }
 
+void MainWindow::discoverDevices() {
+    qCritical() << "MainWindow::discoverDevices, op_mode=" << static_cast<int>(op_mode_);
+    if (isConnected()) {
+        setStatus(QString::fromWCharArray(L"请先断开连接再搜索设备"));
+        return;
+    }
+
+    if (discovery_.isRunning() || baud_probe_.isRunning()) {
+        return;
+    }
+
+    // 要等每个端口探测超时，在工作线程中搜索，界面保持响应
+    setStatus(QString::fromWCharArray(L"正在搜索设备"));
+    discovery_.setFuture(QtConcurrent::run(&PortDiscovery::Discover));
+}
+
+void MainWindow::onDevicesDiscovered() {
+    const auto devices = discovery_.result();
+    qCritical() << "MainWindow::onDevicesDiscovered, found=" << devices.size();
+    // 搜索期间已连接时不再切换端口和机型
+    if (isConnected()) {
+        return;
+    }
+    if (devices.empty()) {
+        setStatus(QString::fromWCharArray(L"未找到设备"));
+        return;
+    }
+
+    // 选中第一个找到的设备，并加载对应型号的默认参数
+    const auto& device = devices.front();
+    SerialComm::Instance()->selectPort(device.port);
+    if (type_combo_->currentText() == device.modelName()) {
+        deviceTypeChanged(device.modelName());
+    } else {
+        type_combo_->setCurrentText(device.modelName());
+    }
+    setStatus(QString::fromWCharArray(L"找到设备: %1").arg(PortDiscovery::Summary(devices)));
+}
+
+// 拔出的适配器按序列号识别，插回后（设备名可能已变化）自动重连
+void MainWindow::onPortAdded(const QString &name, const QString &serial_number) {
+    const auto lost_serial = SerialComm::Instance()->lostSerialNumber();
+    if (isConnected() || serial_number.isEmpty() || serial_number != lost_serial) {
+        return;
+    }
+
+    qCritical() << "MainWindow::onPortAdded, reconnect" << name << ", serial=" << serial_number;
+    if (SerialComm::Instance()->selectPort(name)) {
+        openSerialPort();
+    }
+}
+
+void MainWindow::benchmarkSerialPort() {
+    qCritical() << "MainWindow::benchmarkSerialPort, op_mode=" << static_cast<int>(op_mode_);
+    if (isConnected()) {
+        setStatus(QString::fromWCharArray(L"请先断开连接再测速"));
+        return;
+    }
+
+    constexpr int BENCH_ITERATIONS = 100;
+    const auto results = SerialBench::Run(SerialComm::Instance()->settings(), BENCH_ITERATIONS);
+    setStatus(SerialBench::Summary(results));
+}
+
 void MainWindow::closeSerialPort() {
     qCritical() << "MainWindow::closeSerialPort";
     SerialComm::Instance()->closeSerialPort(0);
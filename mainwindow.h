@@ -4,10 +4,19 @@
 #include <QtWidgets>
 #include <QMainWindow>
 #include <QLabel>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QImage>
 #include "deviceitem.h"
 #include "serialcomm.h"
 #include "itemwidget.h"
+#include "parammodel.h"
+#include "uirefresh.h"
 #include "basic_def.h"
+#include "warmstate.h"
+#include "editjournal.h"
+#include "edithistory.h"
+#include "portdiscovery.h"
 
 QT_BEGIN_NAMESPACE
 class QAction;
@@ -21,34 +30,65 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-    void removeItemsConnection();
-    void connectItemChange(QSlider* slider, QLineEdit* edit, bool need_record=true);
+    void connectItemChange(QSlider* slider, QLineEdit* edit);
+    ParamTableModel& paramModel();
+    const UiRefreshGate& uiRefresh() const;
+    void commitParamEdits();
 
     // IDataChanged interface
     virtual void onDataChange() override;
     virtual void onError(int err) override;
+    virtual void onTransactionDone(const TransactionResult& result) override;
 
     // IShowStatus interface
     virtual void setStatus(const QString& s) override;
 
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
 private slots:
     bool openSerialPort();
     void closeSerialPort();
+    void benchmarkSerialPort();
+    void discoverDevices();
+    void onPortAdded(const QString& name, const QString& serial_number);
+    void deferredInit();
     void load();
     bool save();
+    void loadRecipe();
+    void saveRecipe();
+    void undo();
+    void redo();
     void write();
     void read();
     void help();
+    void analyzeRecords();
+    void simulateStartup();
+    void playTrajectory();
+    void exportRecords();
+    void importRecords();
+    void programHistory();
     void onDbgBtnClicked();
     void onFrBtnClicked();
     void onBkBtnClicked();
     void onPIChanged(bool checked);
 
 private:
+    bool connectSerialPort();
+    void onBaudProbed();
+    void onDevicesDiscovered();
     void setLogo();
     void createAction();
     void connectDbgItems();
+    void initParamView();
+    void recoverEdits();
+    void onValueEdited(int row, ValueType old_value, ValueType value);
+    void onImageBound();
+    void stepHistory(bool is_undo);
+    void updateHistoryActions();
     void deviceTypeChanged(const QString& type);
+    bool loadDefaults(const QString& type);
+    void restoreDeviceType();
 
     bool isConnected();
     bool isInNormalMode();
@@ -62,7 +102,26 @@ private:
 
     DbgWidgetMgr widgetMgr;
     QLabel *m_status = nullptr;
-    QList<QMetaObject::Connection> item_connections;
+    ParamTableModel param_model_;
+    UiRefreshGate ui_refresh_;
+    QComboBox *type_combo_ = nullptr;
+    QFuture<QImage> logo_image_;
+    QFutureWatcher<qint32> baud_probe_;
+    QString baud_probe_port_;
+    QFutureWatcher<std::vector<DiscoveredDevice>> discovery_;
+    WarmState warm_state_;
+    EditJournal journal_;
+
+    // 撤销记录以界面上的参数为准，history_base_ 为最近一次记录后的参数
+    EditHistory history_;
+    ParamImage history_base_;
+    quint8 history_command_ = 0;
+    EditHistory::Kind bind_kind_ = EditHistory::READ;  // 下一次 bind 的来源
+    bool applying_history_ = false;
+    QAction *undo_act_ = nullptr;
+    QAction *redo_act_ = nullptr;
+    QAction *play_act_ = nullptr;
+    bool first_frame_done_ = false;
 
     enum class OP_MODE {
         DISCONNECT = 0,
@@ -0,0 +1,143 @@
+#include "paramdiff.h"
+#include <algorithm>
+
+// 四份来源两两组合共 6 种，对应掩码的低 6 位
+constexpr quint8 PAIR_BITS[ParamDiff::SOURCE_COUNT][ParamDiff::SOURCE_COUNT] = {
+    {0x00, 0x01, 0x02, 0x04},
+    {0x01, 0x00, 0x08, 0x10},
+    {0x02, 0x08, 0x00, 0x20},
+    {0x04, 0x10, 0x20, 0x00},
+};
+
+// 每项的不同计数先累加在一个字节里，满 255 个镜像再并入 32 位计数
+constexpr size_t BATCH_BLOCK = 255;
+
+quint8 ParamDiff::PairBit(Source a, Source b) {
+    return PAIR_BITS[a][b];
+}
+
+void ParamDiff::Reset(size_t count) {
+    count_ = count;
+    for (auto& image: images_) {
+        image.clear();
+    }
+    pairs_.assign(count, 0);
+}
+
+size_t ParamDiff::size() const {
+    return count_;
+}
+
+// 重新比较 source 与其它来源在 index 项上的结果，掩码变化时返回 true
+bool ParamDiff::Update(Source source, size_t index) {
+    auto mask = pairs_[index];
+    const auto old_mask = mask;
+    for (int other = 0; other < SOURCE_COUNT; other++) {
+        if (other == source) {
+            continue;
+        }
+        const auto bit = PairBit(source, static_cast<Source>(other));
+        const auto differs = Has(source) && Has(static_cast<Source>(other)) &&
+                images_[source][index] != images_[other][index];
+        mask = differs ? (mask | bit) : (mask & ~bit);
+    }
+    pairs_[index] = mask;
+    return mask != old_mask;
+}
+
+std::vector<size_t> ParamDiff::Set(Source source, const ParamImage &image) {
+    std::vector<size_t> changed;
+    const auto has_new = (image.size() == count_ && count_ > 0);
+    auto& current = images_[source];
+    if (!has_new && current.empty()) {
+        return changed;
+    }
+
+    // 来源出现或消失时每一项都要重新比较，否则只比较数值变化的项
+    if (!has_new || current.empty()) {
+        if (has_new) {
+            current = image;
+        } else {
+            current.clear();
+        }
+        for (size_t i = 0; i < count_; i++) {
+            Update(source, i);
+            changed.push_back(i);
+        }
+        return changed;
+    }
+
+    for (size_t i = 0; i < count_; i++) {
+        if (current[i] != image[i]) {
+            current[i] = image[i];
+            Update(source, i);
+            changed.push_back(i);
+        }
+    }
+    return changed;
+}
+
+bool ParamDiff::SetValue(Source source, size_t index, ValueType value) {
+    auto& current = images_[source];
+    if (index >= current.size() || current[index] == value) {
+        return false;
+    }
+
+    current[index] = value;
+    Update(source, index);
+    return true;
+}
+
+bool ParamDiff::Has(Source source) const {
+    return !images_[source].empty();
+}
+
+ValueType ParamDiff::Value(Source source, size_t index) const {
+    const auto& image = images_[source];
+    return (index < image.size()) ? image[index] : 0;
+}
+
+bool ParamDiff::Differs(size_t index, Source a, Source b) const {
+    return index < count_ && (pairs_[index] & PairBit(a, b)) != 0;
+}
+
+size_t ParamDiff::DiffCount(Source a, Source b) const {
+    const auto bit = PairBit(a, b);
+    return static_cast<size_t>(std::count_if(pairs_.begin(), pairs_.end(),
+                                             [bit](quint8 mask) { return (mask & bit) != 0; }));
+}
+
+ParamDiff::BatchResult ParamDiff::Compare(const ParamImage &recipe, const ImageStore &store) {
+    BatchResult result;
+    const auto stride = store.stride();
+    const auto count = store.size();
+    if (recipe.size() != stride || stride == 0) {
+        return result;
+    }
+
+    result.item_counts.assign(stride, 0);
+    result.image_counts.resize(count);
+    std::vector<quint8> block(stride);
+    const ValueType* ref = recipe.data();
+    const ValueType* data = store.data();
+    for (size_t begin = 0; begin < count; begin += BATCH_BLOCK) {
+        const auto end = std::min(count, begin + BATCH_BLOCK);
+        std::fill(block.begin(), block.end(), 0);
+        for (size_t i = begin; i < end; i++) {
+            const ValueType* image = data + i * stride;
+            quint16 diffs = 0;
+            // 逐字节比较，没有分支，编译器可以向量化
+            for (size_t j = 0; j < stride; j++) {
+                const quint8 d = (image[j] != ref[j]);
+                block[j] += d;
+                diffs += d;
+            }
+            result.image_counts[i] = diffs;
+            result.matched += (diffs == 0);
+        }
+        for (size_t j = 0; j < stride; j++) {
+            result.item_counts[j] += block[j];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef PARAMDIFF_H
+#define PARAMDIFF_H
+
+#include <vector>
+#include "paramimage.h"
+
+// 参数对比：界面、设备、参数文件、机型默认值四份镜像逐项两两比较
+// 每项保存一个位掩码，某一份镜像变化时只重新比较数值变化的项
+class ParamDiff {
+public:
+    enum Source {UI = 0, DEVICE, FILE, DEFAULTS, SOURCE_COUNT};
+
+    // 机型变化时调用，所有来源清空
+    void Reset(size_t count);
+    size_t size() const;
+
+    // image 为空或长度不符表示没有这份来源；返回数值或比较结果有变化的项
+    std::vector<size_t> Set(Source source, const ParamImage& image);
+    bool SetValue(Source source, size_t index, ValueType value);
+
+    bool Has(Source source) const;
+    ValueType Value(Source source, size_t index) const;
+    // 两份来源都存在且数值不同
+    bool Differs(size_t index, Source a, Source b) const;
+    size_t DiffCount(Source a, Source b) const;
+
+    // 一个配方与大量镜像比较，一次顺序遍历 store 的连续内存
+    struct BatchResult {
+        size_t matched = 0;                 // 与配方完全一致的镜像数
+        std::vector<quint32> item_counts;   // 每项与配方不同的镜像数
+        std::vector<quint16> image_counts;  // 每个镜像与配方不同的项数
+    };
+    static BatchResult Compare(const ParamImage& recipe, const ImageStore& store);
+
+private:
+    static quint8 PairBit(Source a, Source b);
+    bool Update(Source source, size_t index);
+
+private:
+    size_t count_ = 0;
+    ParamImage images_[SOURCE_COUNT];
+    std::vector<quint8> pairs_;     // 每项一个字节，每两份来源占一位
+};
+
+#endif // PARAMDIFF_H
@@ -0,0 +1,146 @@
+#include "paramimage.h"
+#include "imagekernels.h"
+#include <cassert>
+#include <cstring>
+
+ModelSchema::ModelSchema(const char *model, quint8 command)
+    : model_(model),
+      command_(command) {
+}
+
+void ModelSchema::addItem(const char *name, ValueType min, ValueType max, ValueType value, const wchar_t *desc) {
+    assert(min <= value && value <= max);
+    names_.push_back(name);
+    descs_.push_back(desc != nullptr ? QString::fromWCharArray(desc) : QString());
+    mins_.push_back(min);
+    maxs_.push_back(max);
+    defaults_.push_back(value);
+}
+
+const char *ModelSchema::model() const {
+    return model_;
+}
+
+quint8 ModelSchema::command() const {
+    return command_;
+}
+
+size_t ModelSchema::size() const {
+    return defaults_.size();
+}
+
+int ModelSchema::indexOf(const QString &name) const {
+    for (size_t i = 0; i < names_.size(); i++) {
+        if (names_[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+const QString &ModelSchema::name(size_t index) const {
+    return names_[index];
+}
+
+const QString &ModelSchema::desc(size_t index) const {
+    return descs_[index];
+}
+
+ValueType ModelSchema::min(size_t index) const {
+    return mins_[index];
+}
+
+ValueType ModelSchema::max(size_t index) const {
+    return maxs_[index];
+}
+
+const ParamImage &ModelSchema::defaults() const {
+    return defaults_;
+}
+
+const ParamImage &ModelSchema::mins() const {
+    return mins_;
+}
+
+const ParamImage &ModelSchema::maxs() const {
+    return maxs_;
+}
+
+bool ModelSchema::isInRange(const ValueType *values, size_t count) const {
+    if (values == nullptr || count != size()) {
+        return false;
+    }
+
+    // 不提前退出，循环体没有分支，编译器可以直接向量化
+    unsigned int bad = 0;
+    for (size_t i = 0; i < count; i++) {
+        bad |= static_cast<unsigned int>(values[i] < mins_[i]) | static_cast<unsigned int>(values[i] > maxs_[i]);
+    }
+    return bad == 0;
+}
+
+bool ModelSchema::isInRange(const ParamImage &image) const {
+    return isInRange(image.data(), image.size());
+}
+
+////////////////////////////////////////////////////////
+ImageStore::ImageStore(const ModelSchema &schema)
+    : schema_(&schema) {
+}
+
+const ModelSchema &ImageStore::schema() const {
+    return *schema_;
+}
+
+size_t ImageStore::size() const {
+    return stride() == 0 ? 0 : data_.size() / stride();
+}
+
+size_t ImageStore::stride() const {
+    return schema_->size();
+}
+
+void ImageStore::reserve(size_t count) {
+    data_.reserve(count * stride());
+}
+
+void ImageStore::clear() {
+    data_.clear();
+}
+
+bool ImageStore::append(const ValueType *values, size_t count) {
+    if (values == nullptr || count != stride() || count == 0) {
+        return false;
+    }
+    data_.insert(data_.end(), values, values + count);
+    return true;
+}
+
+bool ImageStore::append(const ParamImage &image) {
+    return append(image.data(), image.size());
+}
+
+const ValueType *ImageStore::image(size_t index) const {
+    return (index < size()) ? data_.data() + index * stride() : nullptr;
+}
+
+ValueType *ImageStore::image(size_t index) {
+    return (index < size()) ? data_.data() + index * stride() : nullptr;
+}
+
+const ValueType *ImageStore::data() const {
+    return data_.data();
+}
+
+size_t ImageStore::validate(std::vector<size_t> *invalid) const {
+    std::vector<quint8> ok;
+    const auto valid = ImageKernels::Validate(*this, ok);
+    if (invalid != nullptr && valid != ok.size()) {
+        for (size_t i = 0; i < ok.size(); i++) {
+            if (ok[i] == 0) {
+                invalid->push_back(i);
+            }
+        }
+    }
+    return valid;
+}
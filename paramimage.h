@@ -0,0 +1,70 @@
+#ifndef PARAMIMAGE_H
+#define PARAMIMAGE_H
+
+#include <vector>
+#include <QString>
+
+using ValueType = quint8;
+// 一台设备的参数镜像，按参数顺序每项一个字节，和下发帧中的数据部分一致
+using ParamImage = std::vector<ValueType>;
+
+// 机型参数表：名称、说明、范围只随机型保存一份，每一列连续存放
+class ModelSchema {
+public:
+    ModelSchema(const char* model, quint8 command);
+    void addItem(const char* name, ValueType min, ValueType max, ValueType value, const wchar_t* desc);
+
+    const char* model() const;
+    quint8 command() const;     // 读写命令字，也用来在文件中标识机型
+    size_t size() const;
+    int indexOf(const QString& name) const;     // 找不到返回 -1
+
+    const QString& name(size_t index) const;
+    const QString& desc(size_t index) const;
+    ValueType min(size_t index) const;
+    ValueType max(size_t index) const;
+    const ParamImage& defaults() const;
+    const ParamImage& mins() const;
+    const ParamImage& maxs() const;
+
+    // 一次遍历连续的字节检查全部参数
+    bool isInRange(const ValueType* values, size_t count) const;
+    bool isInRange(const ParamImage& image) const;
+
+private:
+    const char* model_;
+    quint8 command_;
+    std::vector<QString> names_;
+    std::vector<QString> descs_;
+    ParamImage mins_;
+    ParamImage maxs_;
+    ParamImage defaults_;
+};
+
+// 同一机型多台设备的参数镜像，首尾相接存放在一块连续内存中
+// 用于批量作业、历史记录等需要同时处理大量镜像的场合
+class ImageStore {
+public:
+    explicit ImageStore(const ModelSchema& schema);
+
+    const ModelSchema& schema() const;
+    size_t size() const;
+    size_t stride() const;
+    void reserve(size_t count);
+    void clear();
+
+    bool append(const ValueType* values, size_t count);
+    bool append(const ParamImage& image);
+    const ValueType* image(size_t index) const;
+    ValueType* image(size_t index);
+    const ValueType* data() const;
+
+    // 返回范围正确的镜像个数，invalid 中依次记录不正确的序号
+    size_t validate(std::vector<size_t>* invalid = nullptr) const;
+
+private:
+    const ModelSchema* schema_;
+    ParamImage data_;
+};
+
+#endif // PARAMIMAGE_H
@@ -0,0 +1,305 @@
+#include "parammodel.h"
+#include "basic_def.h"
+#include <QApplication>
+#include <QColor>
+#include <QFont>
+#include <QPainter>
+#include <QSlider>
+#include <QSpinBox>
+#include <QStyleOptionSlider>
+
+// 与设备不同（尚未写入）用橙色，与参数文件不同（尚未保存）用黄色
+static const QColor DEVICE_DIFF_COLOR(255, 214, 153);
+static const QColor FILE_DIFF_COLOR(255, 245, 170);
+
+ParamTableModel::ParamTableModel(QObject *parent)
+    : QAbstractTableModel(parent),
+      schema_(&DeviceManager::getSchema(DeviceManager::DeviceType::CK3864S)) {
+}
+
+int ParamTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(image_.size());
+}
+
+int ParamTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : COL_COUNT;
+}
+
+QVariant ParamTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    const auto row = static_cast<size_t>(index.row());
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case COL_NAME:  return schema_->name(row);
+        case COL_MIN:   return QString::number(schema_->min(row));
+        case COL_MAX:   return QString::number(schema_->max(row));
+        case COL_VALUE: return QString::number(image_[row]);
+        case COL_DESC:  return schema_->desc(row);
+        default:        return QVariant();
+        }
+    }
+    if (role == Qt::EditRole && (index.column() == COL_VALUE || index.column() == COL_RANGE)) {
+        return static_cast<int>(image_[row]);
+    }
+    if (role == Qt::ToolTipRole) {
+        return diffToolTip(row);
+    }
+    if (role == Qt::BackgroundRole && index.column() == COL_VALUE) {
+        if (diff_.Differs(row, ParamDiff::UI, ParamDiff::DEVICE)) {
+            return DEVICE_DIFF_COLOR;
+        }
+        if (diff_.Differs(row, ParamDiff::UI, ParamDiff::FILE)) {
+            return FILE_DIFF_COLOR;
+        }
+        return QVariant();
+    }
+    if (role == Qt::FontRole && index.column() == COL_NAME &&
+            diff_.Differs(row, ParamDiff::UI, ParamDiff::DEFAULTS)) {
+        QFont font;
+        font.setBold(true);
+        return font;
+    }
+    if (role == Qt::TextAlignmentRole && index.column() != COL_NAME && index.column() != COL_DESC) {
+        return static_cast<int>(Qt::AlignCenter);
+    }
+    return QVariant();
+}
+
+QVariant ParamTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case COL_NAME:  return QString::fromWCharArray(ITEM_COL_NAME);
+    case COL_MIN:   return QString::fromWCharArray(ITEM_COL_MIN);
+    case COL_RANGE: return QString::fromWCharArray(ITEM_COL_RANGE);
+    case COL_MAX:   return QString::fromWCharArray(ITEM_COL_MAX);
+    case COL_VALUE: return QString::fromWCharArray(ITEM_COL_VALUE);
+    case COL_DESC:  return QString::fromWCharArray(ITEM_COL_DESC);
+    default:        return QVariant();
+    }
+}
+
+Qt::ItemFlags ParamTableModel::flags(const QModelIndex &index) const {
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+
+    if (index.column() == COL_VALUE || index.column() == COL_RANGE) {
+        // 未连接时和原来的滑块一样置灰
+        return editable_ ? (Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable) : Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEnabled;
+}
+
+bool ParamTableModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    if (!index.isValid() || role != Qt::EditRole || !(flags(index) & Qt::ItemIsEditable)) {
+        return false;
+    }
+
+    bool ok = false;
+    const int v = value.toInt(&ok);
+    const auto row = static_cast<size_t>(index.row());
+    if (!ok || v < schema_->min(row) || v > schema_->max(row)) {
+        return false;
+    }
+    if (v == image_[row]) {
+        return true;
+    }
+
+    const auto old_value = image_[row];
+    image_[row] = static_cast<ValueType>(v);
+    diff_.SetValue(ParamDiff::UI, row, image_[row]);
+    // 滑块、数值和对比标记在同一行，整行刷新
+    emit dataChanged(this->index(index.row(), 0), this->index(index.row(), COL_COUNT - 1));
+    emit valueEdited(index.row(), old_value, image_[row]);
+    return true;
+}
+
+void ParamTableModel::bind(const ModelSchema &schema, const ParamImage &image) {
+    if (&schema != schema_ || image.size() != image_.size()) {
+        beginResetModel();
+        schema_ = &schema;
+        image_ = image;
+        diff_.Reset(image_.size());
+        diff_.Set(ParamDiff::DEFAULTS, schema.defaults());
+        diff_.Set(ParamDiff::UI, image_);
+        endResetModel();
+        emit imageBound();
+        return;
+    }
+
+    const auto rows = diff_.Set(ParamDiff::UI, image);
+    image_ = image;
+    emitRowsChanged(rows);
+    emit imageBound();
+}
+
+void ParamTableModel::setReference(ParamDiff::Source source, const ParamImage &image) {
+    assert(source == ParamDiff::DEVICE || source == ParamDiff::FILE);
+    if (source != ParamDiff::DEVICE && source != ParamDiff::FILE) {
+        return;
+    }
+    emitRowsChanged(diff_.Set(source, image));
+}
+
+const ParamDiff &ParamTableModel::diff() const {
+    return diff_;
+}
+
+void ParamTableModel::emitRowsChanged(const std::vector<size_t> &rows) {
+    for (auto i: rows) {
+        const int row = static_cast<int>(i);
+        emit dataChanged(index(row, 0), index(row, COL_COUNT - 1));
+    }
+}
+
+// 说明之后列出各来源的数值，不同的项加 *
+QString ParamTableModel::diffToolTip(size_t row) const {
+    auto tip = schema_->desc(row);
+    const std::pair<ParamDiff::Source, const wchar_t*> sources[] = {
+        {ParamDiff::DEVICE, DIFF_DEVICE},
+        {ParamDiff::FILE, DIFF_FILE},
+        {ParamDiff::DEFAULTS, DIFF_DEFAULTS},
+    };
+    for (const auto& source: sources) {
+        if (!diff_.Has(source.first)) {
+            continue;
+        }
+        tip += QString("\n%1: %2%3").arg(QString::fromWCharArray(source.second))
+                .arg(diff_.Value(source.first, row))
+                .arg(diff_.Differs(row, ParamDiff::UI, source.first) ? " *" : "");
+    }
+    return tip;
+}
+
+const ModelSchema &ParamTableModel::schema() const {
+    return *schema_;
+}
+
+const ParamImage &ParamTableModel::image() const {
+    return image_;
+}
+
+void ParamTableModel::setEditable(bool editable) {
+    if (editable_ == editable) {
+        return;
+    }
+
+    editable_ = editable;
+    if (!image_.empty()) {
+        emit dataChanged(index(0, 0), index(rowCount() - 1, COL_COUNT - 1));
+    }
+}
+
+bool ParamTableModel::isEditable() const {
+    return editable_;
+}
+
+////////////////////////////////////////////////////////
+ParamItemDelegate::ParamItemDelegate(QObject *parent)
+    : QStyledItemDelegate(parent) {
+}
+
+static bool itemRange(const QModelIndex &index, int *min, int *max) {
+    auto model = qobject_cast<const ParamTableModel*>(index.model());
+    if (model == nullptr || index.row() >= static_cast<int>(model->image().size())) {
+        return false;
+    }
+
+    const auto row = static_cast<size_t>(index.row());
+    *min = model->schema().min(row);
+    *max = model->schema().max(row);
+    return true;
+}
+
+void ParamItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
+    int min = 0;
+    int max = 0;
+    if (index.column() != ParamTableModel::COL_RANGE || !itemRange(index, &min, &max)) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    // 只画出滑块的样子，不为每一行创建 QSlider
+    QStyleOptionSlider slider;
+    slider.rect = option.rect.adjusted(4, 0, -4, 0);
+    slider.state = option.state;
+    slider.palette = option.palette;
+    slider.orientation = Qt::Horizontal;
+    slider.minimum = min;
+    slider.maximum = max;
+    slider.sliderPosition = index.data(Qt::EditRole).toInt();
+    slider.sliderValue = slider.sliderPosition;
+    slider.subControls = QStyle::SC_SliderGroove | QStyle::SC_SliderHandle;
+    if (!(index.flags() & Qt::ItemIsEnabled)) {
+        slider.state &= ~QStyle::State_Enabled;
+    }
+
+    const QWidget *widget = option.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    style->drawComplexControl(QStyle::CC_Slider, &slider, painter, widget);
+}
+
+QWidget *ParamItemDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const {
+    int min = 0;
+    int max = 0;
+    if (!itemRange(index, &min, &max)) {
+        return QStyledItemDelegate::createEditor(parent, option, index);
+    }
+
+    if (index.column() == ParamTableModel::COL_RANGE) {
+        auto slider = new QSlider(Qt::Horizontal, parent);
+        slider->setRange(min, max);
+        slider->setAutoFillBackground(true);
+        // 拖动时即时写回，数值列同步显示
+        connect(slider, &QSlider::valueChanged, this, [this, slider]() {
+            emit const_cast<ParamItemDelegate*>(this)->commitData(slider);
+        });
+        return slider;
+    }
+
+    if (index.column() == ParamTableModel::COL_VALUE) {
+        auto spin = new QSpinBox(parent);
+        spin->setRange(min, max);
+        spin->setFrame(false);
+        spin->setAlignment(Qt::AlignCenter);
+        return spin;
+    }
+    return QStyledItemDelegate::createEditor(parent, option, index);
+}
+
+void ParamItemDelegate::setEditorData(QWidget *editor, const QModelIndex &index) const {
+    const int value = index.data(Qt::EditRole).toInt();
+    if (auto slider = qobject_cast<QSlider*>(editor)) {
+        QSignalBlocker blocker(slider);
+        slider->setValue(value);
+    } else if (auto spin = qobject_cast<QSpinBox*>(editor)) {
+        spin->setValue(value);
+    } else {
+        QStyledItemDelegate::setEditorData(editor, index);
+    }
+}
+
+void ParamItemDelegate::setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const {
+    if (auto slider = qobject_cast<QSlider*>(editor)) {
+        model->setData(index, slider->value(), Qt::EditRole);
+    } else if (auto spin = qobject_cast<QSpinBox*>(editor)) {
+        spin->interpretText();
+        model->setData(index, spin->value(), Qt::EditRole);
+    } else {
+        QStyledItemDelegate::setModelData(editor, model, index);
+    }
+}
+
+void ParamItemDelegate::updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option, const QModelIndex &index) const {
+    if (index.column() == ParamTableModel::COL_RANGE) {
+        editor->setGeometry(option.rect.adjusted(4, 0, -4, 0));
+        return;
+    }
+    QStyledItemDelegate::updateEditorGeometry(editor, option, index);
+}
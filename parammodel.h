@@ -0,0 +1,75 @@
+#ifndef PARAMMODEL_H
+#define PARAMMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStyledItemDelegate>
+#include "deviceitem.h"
+#include "paramdiff.h"
+
+// 参数表模型：名称、范围取自机型参数表，界面上的数值单独保存一份镜像
+// 编辑只改这份镜像，保存/写入时再同步回 DeviceManager
+// 行数随机型变化，视图只绘制可见的行，参数再多也不需要增加控件
+// 界面上的数值与设备、参数文件、默认值不同时在表格中标出
+class ParamTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Column {
+        COL_NAME = 0,
+        COL_MIN,
+        COL_RANGE,
+        COL_MAX,
+        COL_VALUE,
+        COL_DESC,
+        COL_COUNT
+    };
+
+    explicit ParamTableModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    // 机型不变时只通知数值有变化的行，否则整表重置
+    void bind(const ModelSchema &schema, const ParamImage &image);
+    const ModelSchema &schema() const;
+    const ParamImage &image() const;
+    // 设置对比用的设备、文件镜像，为空表示没有；只刷新比较结果有变化的行
+    void setReference(ParamDiff::Source source, const ParamImage &image);
+    const ParamDiff &diff() const;
+    void setEditable(bool editable);
+    bool isEditable() const;
+
+signals:
+    void valueEdited(int row, ValueType old_value, ValueType value);    // 界面上修改了一项
+    void imageBound();                              // bind 之后
+
+private:
+    void emitRowsChanged(const std::vector<size_t> &rows);
+    QString diffToolTip(size_t row) const;
+
+private:
+    const ModelSchema *schema_;
+    ParamImage image_;
+    ParamDiff diff_;
+    bool editable_ = false;
+};
+
+// 调节列画成滑块，点击后才创建真正的编辑控件；数值列用数字框编辑
+class ParamItemDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    explicit ParamItemDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    QWidget *createEditor(QWidget *parent, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    void setEditorData(QWidget *editor, const QModelIndex &index) const override;
+    void setModelData(QWidget *editor, QAbstractItemModel *model, const QModelIndex &index) const override;
+    void updateEditorGeometry(QWidget *editor, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+};
+
+#endif // PARAMMODEL_H
@@ -0,0 +1,71 @@
+#include "portdiscovery.h"
+#include <algorithm>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QSerialPortInfo>
+#include <QStringList>
+#include <QtConcurrent>
+#include <QDebug>
+#include "baudprobe.h"
+
+QString DiscoveredDevice::modelName() const {
+    return (type == DeviceManager::DeviceType::CK3862S) ? CK3862S : CK3864S;
+}
+
+static DiscoveredDevice probePort(const QSerialPortInfo &info) {
+    SettingsDialog::Settings settings;
+    settings.name = info.portName();
+    settings.baudRate = BaudProbe::RememberedRate(info.portName());
+    settings.dataBits = QSerialPort::Data8;
+    settings.parity = QSerialPort::NoParity;
+    settings.stopBits = QSerialPort::OneStop;
+    settings.flowControl = QSerialPort::NoFlowControl;
+    settings.realtime = false;
+    settings.autoBaud = true;
+    settings.backend = SettingsDialog::QtBackend;
+
+    DiscoveredDevice device;
+    device.port = info.portName();
+    device.serial_number = info.serialNumber();
+    device.baud_rate = BaudProbe::Probe(settings, &device.response);
+    if (device.baud_rate > 0) {
+        BaudProbe::ParseReadResponse(device.response, &device.type);
+    }
+    return device;
+}
+
+std::vector<DiscoveredDevice> PortDiscovery::Discover() {
+    QElapsedTimer timer;
+    timer.start();
+
+    // 探测时线程基本都在等串口应答，每个端口一个线程，不受 CPU 核数限制
+    const auto infos = QSerialPortInfo::availablePorts();
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::max(1, infos.size()));
+    QList<QFuture<DiscoveredDevice>> futures;
+    for (const auto& info: infos) {
+        futures << QtConcurrent::run(&pool, probePort, info);
+    }
+
+    std::vector<DiscoveredDevice> devices;
+    for (auto& future: futures) {
+        const auto device = future.result();
+        if (device.baud_rate > 0) {
+            BaudProbe::Remember(device.port, device.baud_rate);
+            devices.push_back(device);
+        }
+    }
+
+    qCritical() << "PortDiscovery::Discover, ports=" << infos.size()
+                << ", found=" << devices.size()
+                << ", elapsed=" << timer.elapsed() << "ms";
+    return devices;
+}
+
+QString PortDiscovery::Summary(const std::vector<DiscoveredDevice> &devices) {
+    QStringList parts;
+    for (const auto& d: devices) {
+        parts << QString("%1 %2 %3bps").arg(d.port).arg(d.modelName()).arg(d.baud_rate);
+    }
+    return parts.join(", ");
+}
@@ -0,0 +1,26 @@
+#ifndef PORTDISCOVERY_H
+#define PORTDISCOVERY_H
+
+#include <vector>
+#include <QString>
+#include "deviceitem.h"
+
+struct DiscoveredDevice {
+    QString port;
+    QString serial_number;
+    qint32 baud_rate = 0;
+    DeviceManager::DeviceType type = DeviceManager::DeviceType::CK3864S;
+    QByteArray response;        // 读取命令的应答，即设备当前参数
+
+    QString modelName() const;
+};
+
+// 对所有串口并行发送读取命令，根据应答识别控制器型号
+// 每个端口在各自的线程中用阻塞方式探测，总耗时约等于最慢的一个端口
+class PortDiscovery {
+public:
+    static std::vector<DiscoveredDevice> Discover();
+    static QString Summary(const std::vector<DiscoveredDevice>& devices);
+};
+
+#endif // PORTDISCOVERY_H
@@ -0,0 +1,210 @@
+#include "portwatcher.h"
+#include <QSet>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+
+constexpr int POLL_INTERVAL_MS = 1000;
+constexpr int UEVENT_BUFFER_SIZE = 8192;
+constexpr unsigned int UDEV_MONITOR_GROUP = 2;   // udev 处理完规则后转发的事件，此时设备节点已可用
+static const char UDEV_MONITOR_PREFIX[] = "libudev";
+
+PortWatcher::PortWatcher() {
+}
+
+PortWatcher::~PortWatcher() {
+    Stop();
+}
+
+PortWatcher* PortWatcher::Instance() {
+    static PortWatcher inst;
+    return &inst;
+}
+
+void PortWatcher::Start() {
+    if (netlink_fd_ >= 0 || poll_timer_ != nullptr) {
+        return;
+    }
+
+    // 已经枚举过时，监视启动前可能已有增减
+    if (enumerated_) {
+        refresh();
+    } else {
+        ports();
+    }
+    if (StartNetlink()) {
+        return;
+    }
+
+    qCritical() << "PortWatcher::Start, netlink unavailable, polling every" << POLL_INTERVAL_MS << "ms";
+    poll_timer_ = new QTimer(this);
+    connect(poll_timer_, &QTimer::timeout, this, &PortWatcher::refresh);
+    poll_timer_->start(POLL_INTERVAL_MS);
+}
+
+void PortWatcher::Stop() {
+    StopNetlink();
+    if (poll_timer_ != nullptr) {
+        poll_timer_->stop();
+        delete poll_timer_;
+        poll_timer_ = nullptr;
+    }
+}
+
+// 第一次用到时才枚举
+const QList<QSerialPortInfo> &PortWatcher::ports() const {
+    if (!enumerated_) {
+        ports_ = QSerialPortInfo::availablePorts();
+        enumerated_ = true;
+    }
+    return ports_;
+}
+
+bool PortWatcher::contains(const QString &port_name) const {
+    for (const auto& info: ports()) {
+        if (info.portName() == port_name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QString PortWatcher::serialNumber(const QString &port_name) const {
+    for (const auto& info: ports()) {
+        if (info.portName() == port_name) {
+            return info.serialNumber();
+        }
+    }
+    return QString();
+}
+
+// 对比前后两次的端口列表，按名字找出增加和移除的端口
+void PortWatcher::refresh() {
+    const auto current = QSerialPortInfo::availablePorts();
+
+    QSet<QString> old_names;
+    for (const auto& info: ports()) {
+        old_names.insert(info.portName());
+    }
+    QSet<QString> new_names;
+    for (const auto& info: current) {
+        new_names.insert(info.portName());
+    }
+    if (old_names == new_names) {
+        return;
+    }
+
+    const auto previous = ports_;
+    ports_ = current;
+    // 先让端口列表（设置对话框）更新，收到增减通知时再选择端口才能找到
+    emit portsChanged();
+    for (const auto& info: previous) {
+        if (!new_names.contains(info.portName())) {
+            qCritical() << "PortWatcher::refresh, removed" << info.portName() << info.serialNumber();
+            emit portRemoved(info.portName());
+        }
+    }
+    for (const auto& info: current) {
+        if (!old_names.contains(info.portName())) {
+            qCritical() << "PortWatcher::refresh, added" << info.portName() << info.serialNumber();
+            emit portAdded(info.portName(), info.serialNumber());
+        }
+    }
+}
+
+#ifdef Q_OS_LINUX
+bool PortWatcher::StartNetlink() {
+    netlink_fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (netlink_fd_ < 0) {
+        return false;
+    }
+
+    sockaddr_nl addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = UDEV_MONITOR_GROUP;
+    if (bind(netlink_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(netlink_fd_);
+        netlink_fd_ = -1;
+        return false;
+    }
+
+    notifier_ = new QSocketNotifier(netlink_fd_, QSocketNotifier::Read, this);
+    connect(notifier_, SIGNAL(activated(int)), this, SLOT(onNetlinkReady()));
+    qCritical() << "PortWatcher::StartNetlink, fd=" << netlink_fd_;
+    return true;
+}
+
+void PortWatcher::StopNetlink() {
+    if (notifier_ != nullptr) {
+        notifier_->setEnabled(false);
+        delete notifier_;
+        notifier_ = nullptr;
+    }
+    if (netlink_fd_ >= 0) {
+        ::close(netlink_fd_);
+        netlink_fd_ = -1;
+    }
+}
+
+// udev 消息为：libudev 头 + KEY=VALUE\0 属性；内核消息为：ACTION@DEVPATH\0 + KEY=VALUE\0 属性
+// 只关心 SUBSYSTEM=tty 的增减，其余事件直接丢弃
+void PortWatcher::onNetlinkReady() {
+    char buffer[UEVENT_BUFFER_SIZE];
+    bool tty_changed = false;
+
+    for (;;) {
+        const auto len = recv(netlink_fd_, buffer, sizeof(buffer) - 1, 0);
+        if (len <= 0) {
+            break;
+        }
+        buffer[len] = '\0';
+
+        size_t pos = 0;
+        if (static_cast<size_t>(len) > sizeof(UDEV_MONITOR_PREFIX) &&
+            std::memcmp(buffer, UDEV_MONITOR_PREFIX, sizeof(UDEV_MONITOR_PREFIX)) == 0) {
+            // struct udev_monitor_netlink_header: prefix[8], magic, header_size, properties_off, ...
+            unsigned int properties_off = 0;
+            std::memcpy(&properties_off, buffer + 16, sizeof(properties_off));
+            pos = properties_off;
+        } else {
+            pos = std::strlen(buffer) + 1;
+        }
+
+        bool is_tty = false;
+        bool is_add_or_remove = false;
+        while (pos < static_cast<size_t>(len)) {
+            const char* entry = buffer + pos;
+            const auto entry_len = std::strlen(entry);
+            if (std::strcmp(entry, "SUBSYSTEM=tty") == 0) {
+                is_tty = true;
+            } else if (std::strcmp(entry, "ACTION=add") == 0 || std::strcmp(entry, "ACTION=remove") == 0) {
+                is_add_or_remove = true;
+            }
+            pos += entry_len + 1;
+        }
+        tty_changed = tty_changed || (is_tty && is_add_or_remove);
+    }
+
+    if (tty_changed) {
+        refresh();
+    }
+}
+#else
+bool PortWatcher::StartNetlink() {
+    return false;
+}
+
+void PortWatcher::StopNetlink() {
+}
+
+void PortWatcher::onNetlinkReady() {
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef PORTWATCHER_H
+#define PORTWATCHER_H
+
+#include <QObject>
+#include <QList>
+#include <QSerialPortInfo>
+
+class QSocketNotifier;
+class QTimer;
+
+// 串口热插拔监视
+// Linux 上监听 udev 的 netlink 事件，只在 tty 设备增减时重新读取端口列表；其他平台定时轮询
+class PortWatcher: public QObject {
+    Q_OBJECT
+
+public:
+    static PortWatcher* Instance();
+    void Start();
+    void Stop();
+
+    const QList<QSerialPortInfo>& ports() const;
+    bool contains(const QString& port_name) const;
+    QString serialNumber(const QString& port_name) const;
+
+signals:
+    void portsChanged();
+    void portAdded(const QString& port_name, const QString& serial_number);
+    void portRemoved(const QString& port_name);
+
+private slots:
+    void onNetlinkReady();
+    void refresh();
+
+private:
+    PortWatcher();
+    ~PortWatcher();
+
+    bool StartNetlink();
+    void StopNetlink();
+
+private:
+    mutable QList<QSerialPortInfo> ports_;
+    mutable bool enumerated_ = false;
+    int netlink_fd_ = -1;
+    QSocketNotifier *notifier_ = nullptr;
+    QTimer *poll_timer_ = nullptr;
+};
+
+#endif // PORTWATCHER_H
@@ -0,0 +1,163 @@
+#include "profilefile.h"
+#include <array>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+
+constexpr quint32 PF_MAGIC = 0x46504B43;    // "CKPF"
+constexpr quint16 PF_VERSION = 1;
+constexpr quint16 PF_HEADER_SIZE = 16;
+constexpr int PF_FRAME_OVERHEAD = 3;        // 命令 字节数 ... 校验和
+
+template <typename T>
+static void appendLE(QByteArray& out, T value) {
+    uchar buf[sizeof(T)];
+    qToLittleEndian<T>(value, buf);
+    out.append(reinterpret_cast<const char*>(buf), sizeof(T));
+}
+
+template <typename T>
+static T readLE(const uchar* p) {
+    return qFromLittleEndian<T>(p);
+}
+
+static quint8 frameChecksum(const uchar* frame, size_t size) {
+    unsigned int sum = 0;
+    for (size_t i = 1; i + 1 < size; i++) {
+        sum += frame[i];
+    }
+    return static_cast<quint8>(sum & 0xFF);
+}
+
+ProfileFile::~ProfileFile() {
+    Close();
+}
+
+static std::array<quint32, 256> makeCrcTable() {
+    std::array<quint32, 256> table = {};
+    for (quint32 i = 0; i < 256; i++) {
+        quint32 c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+// CRC-32 (IEEE 802.3)，与 zlib 的 crc32 结果相同
+quint32 ProfileFile::Crc32(const uchar *data, size_t size) {
+    static const auto table = makeCrcTable();
+    quint32 crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QByteArray ProfileFile::Encode(quint8 command, const ParamImage &image) {
+    QByteArray payload;
+    payload.reserve(static_cast<int>(image.size()) + PF_FRAME_OVERHEAD);
+    payload.push_back(static_cast<char>(command));
+    payload.push_back(static_cast<char>(image.size()));
+    payload.append(reinterpret_cast<const char*>(image.data()), static_cast<int>(image.size()));
+    payload.push_back(0);
+    const auto frame = reinterpret_cast<const uchar*>(payload.constData());
+    payload[payload.size() - 1] = static_cast<char>(frameChecksum(frame, static_cast<size_t>(payload.size())));
+
+    QByteArray out;
+    out.reserve(PF_HEADER_SIZE + payload.size());
+    appendLE<quint32>(out, PF_MAGIC);
+    appendLE<quint16>(out, PF_VERSION);
+    appendLE<quint16>(out, PF_HEADER_SIZE);
+    appendLE<quint32>(out, static_cast<quint32>(payload.size()));
+    appendLE<quint32>(out, Crc32(frame, static_cast<size_t>(payload.size())));
+    out.append(payload);
+    return out;
+}
+
+bool ProfileFile::Save(const QString &path, quint8 command, const ParamImage &image) {
+    if (image.empty() || image.size() > 0xFF) {
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCritical() << "ProfileFile::Save, failed, error=" << file.errorString();
+        return false;
+    }
+    const auto data = Encode(command, image);
+    if (file.write(data) != data.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool ProfileFile::Parse(const uchar *data, qint64 size, ProfileView *view) {
+    if (data == nullptr || size < PF_HEADER_SIZE + PF_FRAME_OVERHEAD) {
+        return false;
+    }
+    if (readLE<quint32>(data) != PF_MAGIC ||
+        readLE<quint16>(data + 4) != PF_VERSION ||
+        readLE<quint16>(data + 6) != PF_HEADER_SIZE) {
+        return false;
+    }
+
+    const auto payload_size = readLE<quint32>(data + 8);
+    const auto crc = readLE<quint32>(data + 12);
+    const uchar* frame = data + PF_HEADER_SIZE;
+    if (payload_size != static_cast<quint64>(size - PF_HEADER_SIZE) ||
+        frame[1] + PF_FRAME_OVERHEAD != static_cast<int>(payload_size)) {
+        return false;
+    }
+    if (Crc32(frame, payload_size) != crc || frameChecksum(frame, payload_size) != frame[payload_size - 1]) {
+        return false;
+    }
+
+    if (view != nullptr) {
+        view->command = frame[0];
+        view->values = frame + 2;
+        view->count = frame[1];
+        view->crc = crc;
+    }
+    return true;
+}
+
+bool ProfileFile::Open(const QString &path) {
+    Close();
+
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    size_ = file_.size();
+    data_ = (size_ > 0) ? file_.map(0, size_) : nullptr;
+    if (data_ == nullptr || !Parse(data_, size_, &view_)) {
+        qCritical() << "ProfileFile::Open, invalid profile, path=" << path << ", size=" << size_;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ProfileFile::Close() {
+    if (data_ != nullptr) {
+        file_.unmap(const_cast<uchar*>(data_));
+        data_ = nullptr;
+    }
+    if (file_.isOpen()) {
+        file_.close();
+    }
+    size_ = 0;
+    view_ = ProfileView();
+}
+
+bool ProfileFile::IsOpen() const {
+    return (data_ != nullptr);
+}
+
+const ProfileView &ProfileFile::view() const {
+    return view_;
+}
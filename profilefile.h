@@ -0,0 +1,47 @@
+#ifndef PROFILEFILE_H
+#define PROFILEFILE_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include "paramimage.h"
+
+// 二进制参数文件
+// 文件布局：文件头 | 下发帧（命令 字节数 数据 校验和）
+// 文件头: magic(4) version(2) header size(2) payload size(4) crc32(4)，小端
+// 数据部分与写入设备的帧完全一致，加载时只做校验，不需要解析
+struct ProfileView {
+    quint8 command = 0;
+    const ValueType* values = nullptr;
+    size_t count = 0;
+    quint32 crc = 0;
+};
+
+class ProfileFile {
+public:
+    ProfileFile() = default;
+    ~ProfileFile();
+    ProfileFile(const ProfileFile&) = delete;
+    ProfileFile& operator=(const ProfileFile&) = delete;
+
+    static QByteArray Encode(quint8 command, const ParamImage& image);
+    // 先写临时文件再替换，写到一半异常退出不会破坏原文件
+    static bool Save(const QString& path, quint8 command, const ParamImage& image);
+    // 校验 data 中的完整文件内容，view 指向 data 内部
+    static bool Parse(const uchar* data, qint64 size, ProfileView* view);
+    static quint32 Crc32(const uchar* data, size_t size);
+
+    // 映射文件并校验，成功后 view() 指向映射的内存，直到 Close
+    bool Open(const QString& path);
+    void Close();
+    bool IsOpen() const;
+    const ProfileView& view() const;
+
+private:
+    QFile file_;
+    const uchar* data_ = nullptr;
+    qint64 size_ = 0;
+    ProfileView view_;
+};
+
+#endif // PROFILEFILE_H
@@ -0,0 +1,377 @@
+#include "profilelibrary.h"
+#include "profilefile.h"
+#include <algorithm>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+
+static const char* LIBRARY_FOLDER = "profiles";
+static const char* INDEX_FILE = "index.bin";
+static const char* OBJECT_FOLDER = "objects";
+
+constexpr quint32 PI_MAGIC = 0x49504B43;    // "CKPI"
+constexpr quint16 PI_VERSION = 2;
+// 索引头: magic(4) version(2) reserved(2) entry count(4)
+constexpr int PI_HEADER_SIZE = 12;
+// 条目: 名称长度(2) 名称 版本(4) 时间(8) 命令字(1) 哈希长度(1) 哈希 标签个数(1) 标签 ...
+constexpr int PI_MIN_ENTRY_SIZE = 17;
+
+template <typename T>
+static void appendLE(QByteArray& out, T value) {
+    uchar buf[sizeof(T)];
+    qToLittleEndian<T>(value, buf);
+    out.append(reinterpret_cast<const char*>(buf), sizeof(T));
+}
+
+static void appendString(QByteArray& out, const QString& s) {
+    const auto utf8 = s.toUtf8();
+    appendLE<quint16>(out, static_cast<quint16>(utf8.size()));
+    out.append(utf8);
+}
+
+// 顺序读取索引，越界时置 ok_ 为 false，后续读取都返回 0
+class IndexReader {
+public:
+    IndexReader(const QByteArray& data, int pos): data_(data), pos_(pos) {}
+    bool ok() const { return ok_; }
+
+    template <typename T>
+    T read() {
+        if (!need(sizeof(T))) {
+            return 0;
+        }
+        const auto value = qFromLittleEndian<T>(reinterpret_cast<const uchar*>(data_.constData() + pos_));
+        pos_ += static_cast<int>(sizeof(T));
+        return value;
+    }
+
+    QByteArray bytes(int size) {
+        if (!need(static_cast<size_t>(size))) {
+            return QByteArray();
+        }
+        const auto value = data_.mid(pos_, size);
+        pos_ += size;
+        return value;
+    }
+
+    QString string() {
+        return QString::fromUtf8(bytes(read<quint16>()));
+    }
+
+private:
+    bool need(size_t size) {
+        ok_ = ok_ && (static_cast<size_t>(data_.size() - pos_) >= size);
+        return ok_;
+    }
+
+private:
+    const QByteArray& data_;
+    int pos_ = 0;
+    bool ok_ = true;
+};
+
+ProfileLibrary &ProfileLibrary::Instance() {
+    static ProfileLibrary inst;
+    return inst;
+}
+
+QString ProfileLibrary::DefaultDir() {
+    return QDir::current().filePath(LIBRARY_FOLDER);
+}
+
+// 命令字和数值一起参与哈希，不同机型的相同数值不会合并
+QByteArray ProfileLibrary::Hash(quint8 command, const ParamImage &image) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(reinterpret_cast<const char*>(&command), 1);
+    hash.addData(reinterpret_cast<const char*>(image.data()), static_cast<int>(image.size()));
+    return hash.result();
+}
+
+bool ProfileLibrary::Open(const QString &dir) {
+    if (is_open_ && dir == dir_) {
+        return true;
+    }
+
+    dir_ = dir;
+    entries_.clear();
+    by_name_.clear();
+    by_tag_.clear();
+    objects_.clear();
+    is_open_ = QDir().mkpath(QDir(dir_).filePath(OBJECT_FOLDER)) && ReadIndex();
+
+    qCritical() << "ProfileLibrary::Open, dir=" << dir_ << ", entries=" << entries_.size()
+                << ", objects=" << objects_.size() << ", result=" << is_open_;
+    return is_open_;
+}
+
+bool ProfileLibrary::IsOpen() const {
+    return is_open_;
+}
+
+bool ProfileLibrary::ReadIndex() {
+    QFile file(QDir(dir_).filePath(INDEX_FILE));
+    if (!file.exists()) {
+        return true;    // 新建的库
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "ProfileLibrary::ReadIndex, failed, error=" << file.errorString();
+        return false;
+    }
+
+    const auto data = file.readAll();
+    IndexReader reader(data, 0);
+    if (reader.read<quint32>() != PI_MAGIC || reader.read<quint16>() != PI_VERSION) {
+        qCritical() << "ProfileLibrary::ReadIndex, unsupported index";
+        return false;
+    }
+    reader.read<quint16>();
+    const auto count = reader.read<quint32>();
+
+    // 条目数来自文件，按剩余字节数能容纳的条目数限制预留的空间
+    const auto max_count = static_cast<quint32>(std::max(0, data.size() - PI_HEADER_SIZE) / PI_MIN_ENTRY_SIZE);
+    entries_.reserve(std::min(count, max_count));
+    QHash<QByteArray, ParamImage> images;   // 同一参数文件只读一次
+    for (quint32 i = 0; i < count && reader.ok(); i++) {
+        RecipeEntry entry;
+        entry.name = reader.string();
+        entry.version = reader.read<quint32>();
+        entry.created_ms = reader.read<qint64>();
+        entry.command = reader.read<quint8>();
+        entry.hash = reader.bytes(reader.read<quint8>());
+        const auto tag_count = reader.read<quint8>();
+        for (int t = 0; t < tag_count; t++) {
+            entry.tags << reader.string();
+        }
+        if (!reader.ok()) {
+            break;
+        }
+
+        const auto it = images.constFind(entry.hash);
+        if (it != images.constEnd()) {
+            entry.image = *it;
+        } else if (LoadObject(entry)) {
+            images.insert(entry.hash, entry.image);
+        } else {
+            qCritical() << "ProfileLibrary::ReadIndex, missing object, name=" << entry.name
+                        << ", version=" << entry.version;
+            continue;
+        }
+        entries_.push_back(entry);
+        AddToIndex(entries_.size() - 1);
+    }
+
+    if (!reader.ok()) {
+        qCritical() << "ProfileLibrary::ReadIndex, truncated index, read" << entries_.size() << "of" << count;
+    }
+    return true;
+}
+
+bool ProfileLibrary::WriteIndex() const {
+    QByteArray data;
+    appendLE<quint32>(data, PI_MAGIC);
+    appendLE<quint16>(data, PI_VERSION);
+    appendLE<quint16>(data, 0);
+    appendLE<quint32>(data, static_cast<quint32>(entries_.size()));
+    for (const auto& entry: entries_) {
+        appendString(data, entry.name);
+        appendLE<quint32>(data, entry.version);
+        appendLE<qint64>(data, entry.created_ms);
+        appendLE<quint8>(data, entry.command);
+        appendLE<quint8>(data, static_cast<quint8>(entry.hash.size()));
+        data.append(entry.hash);
+        appendLE<quint8>(data, static_cast<quint8>(entry.tags.size()));
+        for (const auto& tag: entry.tags) {
+            appendString(data, tag);
+        }
+    }
+
+    QSaveFile file(QDir(dir_).filePath(INDEX_FILE));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qCritical() << "ProfileLibrary::WriteIndex, failed, error=" << file.errorString();
+        return false;
+    }
+    return file.commit();
+}
+
+void ProfileLibrary::AddToIndex(size_t index) {
+    const auto& entry = entries_[index];
+    by_name_[entry.name].push_back(index);
+    for (const auto& tag: entry.tags) {
+        by_tag_[tag].push_back(index);
+    }
+    objects_[entry.hash]++;
+}
+
+// 撤销最后一次 AddToIndex，并移除最后一个条目
+void ProfileLibrary::RemoveLast() {
+    assert(!entries_.empty());
+    if (entries_.empty()) {
+        return;
+    }
+
+    const auto& entry = entries_.back();
+    const auto unlink = [](QHash<QString, std::vector<size_t>>& index, const QString& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        it->pop_back();
+        if (it->empty()) {
+            index.erase(it);
+        }
+    };
+    unlink(by_name_, entry.name);
+    for (const auto& tag: entry.tags) {
+        unlink(by_tag_, tag);
+    }
+    if (--objects_[entry.hash] <= 0) {
+        objects_.remove(entry.hash);
+    }
+    entries_.pop_back();
+}
+
+QString ProfileLibrary::ObjectPath(const QByteArray &hash) const {
+    return QDir(dir_).filePath(QString("%1/%2.ckp").arg(OBJECT_FOLDER, QString::fromLatin1(hash.toHex())));
+}
+
+// 参数文件损坏或内容与哈希不符时返回 false
+bool ProfileLibrary::LoadObject(RecipeEntry &entry) const {
+    ProfileFile file;
+    if (!file.Open(ObjectPath(entry.hash)) || file.view().command != entry.command) {
+        return false;
+    }
+    const auto& view = file.view();
+    ParamImage image(view.values, view.values + view.count);
+    if (Hash(entry.command, image) != entry.hash) {
+        return false;
+    }
+    entry.image = std::move(image);
+    return true;
+}
+
+bool ProfileLibrary::StoreObject(const RecipeEntry &entry) {
+    if (objects_.contains(entry.hash) && QFile::exists(ObjectPath(entry.hash))) {
+        return true;    // 已有相同内容
+    }
+    return ProfileFile::Save(ObjectPath(entry.hash), entry.command, entry.image);
+}
+
+const RecipeEntry *ProfileLibrary::Save(const QString &name, quint8 command, const ParamImage &image,
+                                        const QStringList &tags) {
+    if (!is_open_ || name.isEmpty() || image.empty() || image.size() > 0xFF || tags.size() > 0xFF) {
+        return nullptr;
+    }
+
+    RecipeEntry entry;
+    entry.name = name;
+    entry.command = command;
+    entry.image = image;
+    entry.hash = Hash(command, image);
+    entry.tags = tags;
+    entry.tags.removeDuplicates();
+
+    const auto latest = Find(name);
+    if (latest != nullptr && latest->hash == entry.hash && latest->tags == entry.tags) {
+        return latest;
+    }
+    entry.version = (latest != nullptr) ? latest->version + 1 : 1;
+    entry.created_ms = QDateTime::currentMSecsSinceEpoch();
+
+    const auto is_new_object = !objects_.contains(entry.hash);
+    if (!StoreObject(entry)) {
+        qCritical() << "ProfileLibrary::Save, failed to store object, name=" << name;
+        return nullptr;
+    }
+
+    // 索引写入失败时内存中的条目与磁盘保持一致，新写入的参数文件也不留下
+    entries_.push_back(entry);
+    AddToIndex(entries_.size() - 1);
+    if (!WriteIndex()) {
+        RemoveLast();
+        if (is_new_object) {
+            QFile::remove(ObjectPath(entry.hash));
+        }
+        return nullptr;
+    }
+
+    qCritical() << "ProfileLibrary::Save, name=" << name << ", version=" << entry.version
+                << ", hash=" << entry.hash.toHex() << ", objects=" << objects_.size();
+    return &entries_.back();
+}
+
+const RecipeEntry *ProfileLibrary::Find(const QString &name, quint32 version) const {
+    const auto it = by_name_.constFind(name);
+    if (it == by_name_.constEnd() || it->empty()) {
+        return nullptr;
+    }
+    if (version == 0) {
+        return &entries_[it->back()];
+    }
+    for (auto index: *it) {
+        if (entries_[index].version == version) {
+            return &entries_[index];
+        }
+    }
+    return nullptr;
+}
+
+std::vector<const RecipeEntry *> ProfileLibrary::Latest(quint8 command) const {
+    std::vector<const RecipeEntry*> result;
+    for (auto it = by_name_.constBegin(); it != by_name_.constEnd(); ++it) {
+        const auto& entry = entries_[it->back()];
+        if (entry.command == command) {
+            result.push_back(&entry);
+        }
+    }
+    return result;
+}
+
+std::vector<const RecipeEntry *> ProfileLibrary::FindByModel(quint8 command) const {
+    return Latest(command);
+}
+
+std::vector<const RecipeEntry *> ProfileLibrary::FindByTag(const QString &tag) const {
+    std::vector<const RecipeEntry*> result;
+    const auto it = by_tag_.constFind(tag);
+    if (it == by_tag_.constEnd()) {
+        return result;
+    }
+    for (auto index: *it) {
+        const auto& entry = entries_[index];
+        if (Find(entry.name) == &entry) {
+            result.push_back(&entry);
+        }
+    }
+    return result;
+}
+
+std::vector<const RecipeEntry *> ProfileLibrary::FindByValue(quint8 command, size_t item, ValueType lo, ValueType hi) const {
+    std::vector<const RecipeEntry*> result;
+    for (auto entry: Latest(command)) {
+        if (item < entry->image.size() && lo <= entry->image[item] && entry->image[item] <= hi) {
+            result.push_back(entry);
+        }
+    }
+    return result;
+}
+
+QStringList ProfileLibrary::Names(quint8 command) const {
+    QStringList names;
+    for (auto entry: Latest(command)) {
+        names << entry->name;
+    }
+    names.sort();
+    return names;
+}
+
+size_t ProfileLibrary::EntryCount() const {
+    return entries_.size();
+}
+
+size_t ProfileLibrary::ObjectCount() const {
+    return static_cast<size_t>(objects_.size());
+}
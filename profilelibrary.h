@@ -0,0 +1,72 @@
+#ifndef PROFILELIBRARY_H
+#define PROFILELIBRARY_H
+
+#include <vector>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include "paramimage.h"
+
+// 参数库中的一个配方版本
+struct RecipeEntry {
+    QString name;
+    quint32 version = 0;
+    QStringList tags;
+    qint64 created_ms = 0;
+    QByteArray hash;            // 内容哈希，相同内容共用一个文件
+    quint8 command = 0;
+    ParamImage image;
+};
+
+// 配方参数库
+// 目录布局：index.bin 索引 | objects/<哈希>.ckp 参数文件（ProfileFile 格式）
+// 索引只记录参数的内容哈希，参数本身只在参数文件中，内容相同的配方共用一份
+// 打开时读入索引，每个参数文件读一次；之后按名称、标签的查找都是哈希表查询，切换配方不需要读文件
+class ProfileLibrary {
+public:
+    static ProfileLibrary& Instance();
+    static QString DefaultDir();
+    static QByteArray Hash(quint8 command, const ParamImage& image);
+
+    bool Open(const QString& dir = DefaultDir());
+    bool IsOpen() const;
+
+    // 返回的指针在下一次 Save 或 Open 之前有效
+    // 内容与该名称的最新版本相同时不新增版本，返回已有的版本
+    const RecipeEntry* Save(const QString& name, quint8 command, const ParamImage& image,
+                            const QStringList& tags = QStringList());
+    const RecipeEntry* Find(const QString& name, quint32 version = 0) const;    // 0 表示最新版本
+    std::vector<const RecipeEntry*> FindByModel(quint8 command) const;          // 每个名称的最新版本
+    std::vector<const RecipeEntry*> FindByTag(const QString& tag) const;
+    // 第 item 项参数在 [lo, hi] 内的配方，每个名称只取最新版本
+    std::vector<const RecipeEntry*> FindByValue(quint8 command, size_t item, ValueType lo, ValueType hi) const;
+
+    QStringList Names(quint8 command) const;
+    size_t EntryCount() const;
+    size_t ObjectCount() const;
+
+private:
+    ProfileLibrary() = default;
+    ProfileLibrary(const ProfileLibrary&) = delete;
+    ProfileLibrary& operator=(const ProfileLibrary&) = delete;
+
+    bool ReadIndex();
+    bool WriteIndex() const;
+    QString ObjectPath(const QByteArray& hash) const;
+    bool LoadObject(RecipeEntry& entry) const;
+    bool StoreObject(const RecipeEntry& entry);
+    void AddToIndex(size_t index);
+    void RemoveLast();
+    std::vector<const RecipeEntry*> Latest(quint8 command) const;
+
+private:
+    QString dir_;
+    bool is_open_ = false;
+    std::vector<RecipeEntry> entries_;
+    QHash<QString, std::vector<size_t>> by_name_;   // 版本从小到大
+    QHash<QString, std::vector<size_t>> by_tag_;
+    QHash<QByteArray, int> objects_;                // 哈希 -> 引用次数
+};
+
+#endif // PROFILELIBRARY_H
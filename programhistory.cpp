@@ -0,0 +1,422 @@
+#include "programhistory.h"
+#include "profilefile.h"
+#include "profilelibrary.h"
+#include <algorithm>
+#include <cstring>
+#include <QDir>
+#include <QtConcurrent>
+#include <QTextStream>
+#include <QtEndian>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char* HISTORY_FOLDER = "history";
+static const char* RECORD_FILE = "programs.bin";
+static const char* STATION_FILE = "stations.txt";
+
+constexpr quint32 PH_MAGIC = 0x48504B43;    // "CKPH"
+constexpr quint16 PH_VERSION = 1;
+// 文件头: magic(4) version(2) record size(2) reserved(8)
+constexpr int PH_HEADER_SIZE = 16;
+// 记录: 时间(8) 参数标识(8) 总耗时(4) 校验耗时(4) 串口(2) 命令字(1) 发送次数(1) 参数个数(1) 保留(1) 参数(30) crc32(4)
+constexpr int PH_RECORD_SIZE = 64;
+constexpr int PH_IMAGE_OFFSET = 30;
+constexpr int PH_MAX_ITEMS = 30;
+constexpr int PH_CRC_OFFSET = 60;
+
+static bool syncFile(QFile& file) {
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+static bool isRecordValid(const uchar* p) {
+    return p[28] <= PH_MAX_ITEMS &&
+           qFromLittleEndian<quint32>(p + PH_CRC_OFFSET) == ProfileFile::Crc32(p, PH_CRC_OFFSET);
+}
+
+ProgramHistory &ProgramHistory::Instance() {
+    static ProgramHistory inst;
+    return inst;
+}
+
+ProgramHistory::ProgramHistory() {
+    writer_.setMaxThreadCount(1);
+}
+
+ProgramHistory::~ProgramHistory() {
+    Close();
+}
+
+QString ProgramHistory::DefaultDir() {
+    return QDir::current().filePath(HISTORY_FOLDER);
+}
+
+quint64 ProgramHistory::ImageKey(quint8 command, const ParamImage &image) {
+    const auto hash = ProfileLibrary::Hash(command, image);
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(hash.constData()));
+}
+
+bool ProgramHistory::Open(const QString &dir) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_.isOpen() && dir == dir_) {
+            return true;
+        }
+    }
+
+    writer_.waitForDone();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Reset();
+    dir_ = dir;
+    if (!QDir().mkpath(dir_) || !ReadStations()) {
+        return false;
+    }
+
+    file_.setFileName(QDir(dir_).filePath(RECORD_FILE));
+    if (!file_.open(QIODevice::ReadWrite)) {
+        qCritical() << "ProgramHistory::Open, failed, error=" << file_.errorString();
+        return false;
+    }
+
+    if (file_.size() < PH_HEADER_SIZE) {
+        uchar header[PH_HEADER_SIZE] = {};
+        qToLittleEndian<quint32>(PH_MAGIC, header);
+        qToLittleEndian<quint16>(PH_VERSION, header + 4);
+        qToLittleEndian<quint16>(PH_RECORD_SIZE, header + 6);
+        if (!file_.resize(0) || file_.write(reinterpret_cast<const char*>(header), PH_HEADER_SIZE) != PH_HEADER_SIZE ||
+                !syncFile(file_)) {
+            file_.close();
+            return false;
+        }
+    } else {
+        uchar header[PH_HEADER_SIZE];
+        if (file_.read(reinterpret_cast<char*>(header), PH_HEADER_SIZE) != PH_HEADER_SIZE ||
+                qFromLittleEndian<quint32>(header) != PH_MAGIC ||
+                qFromLittleEndian<quint16>(header + 4) != PH_VERSION ||
+                qFromLittleEndian<quint16>(header + 6) != PH_RECORD_SIZE) {
+            qCritical() << "ProgramHistory::Open, unsupported file";
+            file_.close();
+            return false;
+        }
+    }
+
+    // 写到一半的最后一条记录丢弃
+    count_ = static_cast<size_t>((file_.size() - PH_HEADER_SIZE) / PH_RECORD_SIZE);
+    if (!Map()) {
+        file_.close();
+        return false;
+    }
+    while (count_ > 0 && !isRecordValid(RecordAt(count_ - 1))) {
+        count_--;
+    }
+    if (file_.size() != PH_HEADER_SIZE + static_cast<qint64>(count_) * PH_RECORD_SIZE) {
+        qCritical() << "ProgramHistory::Open, drop incomplete tail, size=" << file_.size();
+        Unmap();
+        if (!file_.resize(PH_HEADER_SIZE + static_cast<qint64>(count_) * PH_RECORD_SIZE) || !Map()) {
+            file_.close();
+            return false;
+        }
+    }
+
+    by_image_.reserve(static_cast<int>(std::min<size_t>(count_, 1 << 16)));
+    for (size_t i = 0; i < count_; i++) {
+        AddToIndex(i);
+    }
+
+    qCritical() << "ProgramHistory::Open, dir=" << dir_ << ", records=" << count_
+                << ", images=" << by_image_.size() << ", stations=" << stations_.size() << ", sorted=" << sorted_;
+    return true;
+}
+
+void ProgramHistory::Close() {
+    writer_.waitForDone();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Reset();
+}
+
+void ProgramHistory::Reset() {
+    Unmap();
+    if (file_.isOpen()) {
+        file_.close();
+    }
+    count_ = 0;
+    sorted_ = true;
+    stations_.clear();
+    totals_.clear();
+    by_image_.clear();
+}
+
+bool ProgramHistory::IsOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_.isOpen();
+}
+
+size_t ProgramHistory::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+ProgramRecord ProgramHistory::At(size_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(index < count_);
+    if (index >= count_) {
+        return ProgramRecord();
+    }
+    return Decode(index);
+}
+
+bool ProgramHistory::ReadStations() {
+    QFile file(QDir(dir_).filePath(STATION_FILE));
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "ProgramHistory::ReadStations, failed, error=" << file.errorString();
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    while (!in.atEnd()) {
+        stations_ << in.readLine();
+    }
+    totals_.resize(static_cast<size_t>(stations_.size()));
+    return true;
+}
+
+// 新的串口名称先写入 stations.txt，再写引用它的记录
+int ProgramHistory::StationId(const QString &station) {
+    const auto index = stations_.indexOf(station);
+    if (index >= 0) {
+        return index;
+    }
+    if (stations_.size() >= 0xFFFF) {
+        return -1;
+    }
+
+    QFile file(QDir(dir_).filePath(STATION_FILE));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qCritical() << "ProgramHistory::StationId, failed, error=" << file.errorString();
+        return -1;
+    }
+    file.write(station.toUtf8() + '\n');
+    if (!syncFile(file)) {
+        return -1;
+    }
+
+    stations_ << station;
+    totals_.resize(static_cast<size_t>(stations_.size()));
+    return stations_.size() - 1;
+}
+
+// 文件变长后重新映射，已有的记录不会移动
+bool ProgramHistory::Map() {
+    Unmap();
+    data_ = file_.map(0, file_.size());
+    if (data_ == nullptr) {
+        qCritical() << "ProgramHistory::Map, failed, error=" << file_.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ProgramHistory::Unmap() {
+    if (data_ != nullptr) {
+        file_.unmap(data_);
+        data_ = nullptr;
+    }
+}
+
+const uchar *ProgramHistory::RecordAt(size_t index) const {
+    return data_ + PH_HEADER_SIZE + index * PH_RECORD_SIZE;
+}
+
+qint64 ProgramHistory::TimeAt(size_t index) const {
+    return qFromLittleEndian<qint64>(RecordAt(index));
+}
+
+void ProgramHistory::AddToIndex(size_t index) {
+    const auto p = RecordAt(index);
+    if (index > 0 && TimeAt(index) < TimeAt(index - 1)) {
+        sorted_ = false;
+    }
+    by_image_[qFromLittleEndian<quint64>(p + 8)].push_back(static_cast<quint32>(index));
+
+    const auto station = qFromLittleEndian<quint16>(p + 24);
+    if (station >= totals_.size()) {
+        totals_.resize(station + 1u);
+    }
+    auto& totals = totals_[station];
+    totals.count++;
+    totals.total_us += qFromLittleEndian<quint32>(p + 16);
+    totals.verify_us += qFromLittleEndian<quint32>(p + 20);
+}
+
+void ProgramHistory::Post(const ProgramRecord &record) {
+    if (!IsOpen()) {
+        qCritical() << "ProgramHistory::Post, not open";
+        return;
+    }
+    QtConcurrent::run(&writer_, [this, record]() { Append(record); });
+}
+
+bool ProgramHistory::Append(const ProgramRecord &record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.isOpen() || record.image.empty() || record.image.size() > PH_MAX_ITEMS || count_ >= 0xFFFFFFFF) {
+        return false;
+    }
+    const auto station = StationId(record.station);
+    if (station < 0) {
+        return false;
+    }
+
+    uchar p[PH_RECORD_SIZE] = {};
+    qToLittleEndian<qint64>(record.timestamp_ms, p);
+    qToLittleEndian<quint64>(ImageKey(record.command, record.image), p + 8);
+    qToLittleEndian<quint32>(record.total_us, p + 16);
+    qToLittleEndian<quint32>(record.verify_us, p + 20);
+    qToLittleEndian<quint16>(static_cast<quint16>(station), p + 24);
+    p[26] = record.command;
+    p[27] = record.attempts;
+    p[28] = static_cast<uchar>(record.image.size());
+    std::memcpy(p + PH_IMAGE_OFFSET, record.image.data(), record.image.size());
+    qToLittleEndian<quint32>(ProfileFile::Crc32(p, PH_CRC_OFFSET), p + PH_CRC_OFFSET);
+
+    // 每台设备一条记录，逐条落盘，断电只可能丢失正在写的这一条
+    const auto pos = PH_HEADER_SIZE + static_cast<qint64>(count_) * PH_RECORD_SIZE;
+    if (!file_.seek(pos) || file_.write(reinterpret_cast<const char*>(p), PH_RECORD_SIZE) != PH_RECORD_SIZE ||
+            !syncFile(file_) || !Map()) {
+        qCritical() << "ProgramHistory::Append, failed, error=" << file_.errorString();
+        Unmap();
+        file_.resize(pos);
+        Map();
+        return false;
+    }
+
+    AddToIndex(count_);
+    count_++;
+    return true;
+}
+
+ProgramRecord ProgramHistory::Decode(size_t index) const {
+    const auto p = RecordAt(index);
+    const auto station = qFromLittleEndian<quint16>(p + 24);
+    ProgramRecord record;
+    record.timestamp_ms = qFromLittleEndian<qint64>(p);
+    record.total_us = qFromLittleEndian<quint32>(p + 16);
+    record.verify_us = qFromLittleEndian<quint32>(p + 20);
+    record.station = (static_cast<int>(station) < stations_.size()) ? stations_[station] : QString("#%1").arg(station);
+    record.command = p[26];
+    record.attempts = p[27];
+    record.image.assign(p + PH_IMAGE_OFFSET, p + PH_IMAGE_OFFSET + p[28]);
+    return record;
+}
+
+std::vector<size_t> ProgramHistory::IndicesByTime(qint64 from_ms, qint64 to_ms) const {
+    std::vector<size_t> indices;
+    if (!sorted_) {
+        for (size_t i = 0; i < count_; i++) {
+            const auto t = TimeAt(i);
+            if (from_ms <= t && t < to_ms) {
+                indices.push_back(i);
+            }
+        }
+        return indices;
+    }
+
+    size_t lo = 0;
+    size_t hi = count_;
+    while (lo < hi) {
+        const auto mid = lo + (hi - lo) / 2;
+        if (TimeAt(mid) < from_ms) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (auto i = lo; i < count_ && TimeAt(i) < to_ms; i++) {
+        indices.push_back(i);
+    }
+    return indices;
+}
+
+std::vector<ProgramRecord> ProgramHistory::FindByTime(qint64 from_ms, qint64 to_ms) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ProgramRecord> result;
+    for (auto i: IndicesByTime(from_ms, to_ms)) {
+        result.push_back(Decode(i));
+    }
+    return result;
+}
+
+std::vector<ProgramRecord> ProgramHistory::FindByImage(quint8 command, const ParamImage &image,
+                                                       qint64 from_ms, qint64 to_ms) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ProgramRecord> result;
+    const auto it = by_image_.constFind(ImageKey(command, image));
+    if (it == by_image_.constEnd()) {
+        return result;
+    }
+
+    // 同一标识的记录序号递增，时间有序时从第一条不早于 from_ms 的开始
+    auto begin = it->begin();
+    if (sorted_) {
+        begin = std::lower_bound(it->begin(), it->end(), from_ms,
+                                 [this](quint32 index, qint64 ms) { return TimeAt(index) < ms; });
+    }
+    for (auto i = begin; i != it->end(); ++i) {
+        const auto t = TimeAt(*i);
+        if (sorted_ && t >= to_ms) {
+            break;
+        }
+        const auto p = RecordAt(*i);
+        if (t < from_ms || t >= to_ms || p[26] != command || p[28] != image.size() ||
+                std::memcmp(p + PH_IMAGE_OFFSET, image.data(), image.size()) != 0) {
+            continue;
+        }
+        result.push_back(Decode(*i));
+    }
+    return result;
+}
+
+std::vector<StationStats> ProgramHistory::Stations(qint64 from_ms, qint64 to_ms) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Totals> totals;
+    if (from_ms <= 0 && to_ms == ALL_TIME) {
+        totals = totals_;
+    } else {
+        totals.resize(totals_.size());
+        for (auto i: IndicesByTime(from_ms, to_ms)) {
+            const auto p = RecordAt(i);
+            auto& t = totals[qFromLittleEndian<quint16>(p + 24)];
+            t.count++;
+            t.total_us += qFromLittleEndian<quint32>(p + 16);
+            t.verify_us += qFromLittleEndian<quint32>(p + 20);
+        }
+    }
+
+    std::vector<StationStats> result;
+    for (size_t i = 0; i < totals.size(); i++) {
+        if (totals[i].count == 0) {
+            continue;
+        }
+        StationStats stats;
+        stats.station = (i < static_cast<size_t>(stations_.size())) ? stations_[static_cast<int>(i)] : QString("#%1").arg(i);
+        stats.count = totals[i].count;
+        stats.avg_verify_ms = totals[i].verify_us / 1000.0 / totals[i].count;
+        stats.avg_total_ms = totals[i].total_us / 1000.0 / totals[i].count;
+        result.push_back(stats);
+    }
+    return result;
+}
@@ -0,0 +1,97 @@
+#ifndef PROGRAMHISTORY_H
+#define PROGRAMHISTORY_H
+
+#include <limits>
+#include <mutex>
+#include <vector>
+#include <QFile>
+#include <QHash>
+#include <QThreadPool>
+#include <QString>
+#include <QStringList>
+#include "paramimage.h"
+
+// 一次写入设备并校验成功的记录
+struct ProgramRecord {
+    qint64 timestamp_ms = 0;
+    QString station;            // 写入时使用的串口
+    quint8 command = 0;
+    quint8 attempts = 0;        // 发送次数，含重发
+    quint32 total_us = 0;       // 开始写入到校验完成
+    quint32 verify_us = 0;      // 最后一次发送到设备回显一致
+    ParamImage image;
+};
+
+struct StationStats {
+    QString station;
+    quint64 count = 0;
+    double avg_verify_ms = 0;
+    double avg_total_ms = 0;
+};
+
+// 生产写入记录，只追加不修改
+// 目录布局：programs.bin 文件头 | 定长记录 ... ；stations.txt 串口名称，每行一个，记录中保存行号
+// 记录文件映射到内存读取，打开时顺序扫描一遍，建立按参数内容的索引和各串口的累计耗时，
+// 之后的查询不读文件：时间范围二分查找，参数内容查哈希表，全部时间的串口统计直接取累计值
+// 写入设备后的记录由 Post 交给单独的写入线程按顺序落盘，查询与写入之间加锁
+class ProgramHistory {
+public:
+    static ProgramHistory& Instance();
+    static QString DefaultDir();
+    // 参数内容的标识，取 ProfileLibrary::Hash 的前 8 字节，同一配方的记录标识相同
+    static quint64 ImageKey(quint8 command, const ParamImage& image);
+
+    bool Open(const QString& dir = DefaultDir());
+    void Close();
+    bool IsOpen() const;
+    bool Append(const ProgramRecord& record);
+    // 不等待落盘，在写入线程中 Append；未打开时丢弃
+    void Post(const ProgramRecord& record);
+    size_t size() const;
+    // 按写入顺序逐条读取，index 小于 size()
+    ProgramRecord At(size_t index) const;
+
+    static constexpr qint64 ALL_TIME = std::numeric_limits<qint64>::max();
+    // 时间范围为 [from_ms, to_ms)，结果按写入顺序
+    std::vector<ProgramRecord> FindByTime(qint64 from_ms, qint64 to_ms) const;
+    std::vector<ProgramRecord> FindByImage(quint8 command, const ParamImage& image,
+                                           qint64 from_ms = 0, qint64 to_ms = ALL_TIME) const;
+    std::vector<StationStats> Stations(qint64 from_ms = 0, qint64 to_ms = ALL_TIME) const;
+
+private:
+    ProgramHistory();
+    ~ProgramHistory();
+    ProgramHistory(const ProgramHistory&) = delete;
+    ProgramHistory& operator=(const ProgramHistory&) = delete;
+
+    void Reset();
+    bool ReadStations();
+    int StationId(const QString& station);
+    bool Map();
+    void Unmap();
+    const uchar* RecordAt(size_t index) const;
+    qint64 TimeAt(size_t index) const;
+    std::vector<size_t> IndicesByTime(qint64 from_ms, qint64 to_ms) const;
+    ProgramRecord Decode(size_t index) const;
+    void AddToIndex(size_t index);
+
+private:
+    struct Totals {
+        quint64 count = 0;
+        quint64 verify_us = 0;
+        quint64 total_us = 0;
+    };
+
+    mutable std::mutex mutex_;
+    QThreadPool writer_;        // 单线程，保证按提交顺序写入
+    QString dir_;
+    QFile file_;
+    uchar* data_ = nullptr;
+    size_t count_ = 0;
+    bool sorted_ = true;        // 时间递增；系统时间被调回后为 false，时间查询改为顺序扫描
+    QStringList stations_;
+    std::vector<Totals> totals_;                    // 按串口行号
+    QHash<quint64, std::vector<quint32>> by_image_; // 参数标识 -> 记录序号
+};
+
+#endif // PROGRAMHISTORY_H
@@ -0,0 +1,204 @@
+#include "realtimeio.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <QSettings>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <termios.h>
+#include <linux/serial.h>
+#endif
+
+static const char* SETTINGS_FILE = "settings.ini";
+static const char* KEY_CPU = "realtime/cpu";
+static const char* KEY_LOCK_MEMORY = "realtime/lock_memory";
+
+// 每项单独记录，Disable 时只恢复成功设置过的项
+static bool low_latency_set = false;
+static bool min_read_set = false;
+static bool memory_locked = false;
+#ifdef Q_OS_LINUX
+static cc_t saved_vmin = 0;
+static cc_t saved_vtime = 0;
+#endif
+
+#ifdef Q_OS_LINUX
+static bool setLowLatency(int fd, bool on) {
+    serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+        return false;  // USB 转串口驱动不一定支持
+    }
+    if (on) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    } else {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    return (ioctl(fd, TIOCSSERIAL, &serial) == 0);
+}
+
+// VMIN=1, VTIME=0：有一个字节即返回，不做字节间等待
+// 非阻塞句柄不受影响，此设置只影响阻塞方式的读取；原来的值保存下来，Disable 时恢复
+static bool setMinimalRead(int fd, bool on) {
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        return false;
+    }
+    if (on) {
+        saved_vmin = tio.c_cc[VMIN];
+        saved_vtime = tio.c_cc[VTIME];
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+    } else {
+        tio.c_cc[VMIN] = saved_vmin;
+        tio.c_cc[VTIME] = saved_vtime;
+    }
+    return (tcsetattr(fd, TCSANOW, &tio) == 0);
+}
+#endif
+
+bool RealtimeIo::Enable(qintptr fd) {
+#ifdef Q_OS_LINUX
+    const auto handle = static_cast<int>(fd);
+    low_latency_set = setLowLatency(handle, true);
+    min_read_set = setMinimalRead(handle, true);
+    // 没有 CAP_IPC_LOCK 且超过 RLIMIT_MEMLOCK 时失败，其余设置仍然有效
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    if (settings.value(KEY_LOCK_MEMORY, true).toBool()) {
+        memory_locked = (mlockall(MCL_CURRENT) == 0);
+    }
+
+    qCritical() << "RealtimeIo::Enable, low_latency=" << low_latency_set << ", vmin/vtime=" << min_read_set
+                << ", mlock=" << memory_locked;
+    return IsEnabled();
+#else
+    Q_UNUSED(fd)
+    qCritical() << "RealtimeIo::Enable, not supported on this platform";
+    return false;
+#endif
+}
+
+void RealtimeIo::Disable(qintptr fd) {
+#ifdef Q_OS_LINUX
+    if (!IsEnabled()) {
+        return;
+    }
+
+    // 端口已关闭时设置随句柄失效，只清除记录
+    if (fd >= 0) {
+        const auto handle = static_cast<int>(fd);
+        if (low_latency_set) {
+            setLowLatency(handle, false);
+        }
+        if (min_read_set) {
+            setMinimalRead(handle, false);
+        }
+    }
+    if (memory_locked) {
+        munlockall();
+    }
+    low_latency_set = false;
+    min_read_set = false;
+    memory_locked = false;
+    qCritical() << "RealtimeIo::Disable";
+#else
+    Q_UNUSED(fd)
+#endif
+}
+
+bool RealtimeIo::IsEnabled() {
+    return low_latency_set || min_read_set || memory_locked;
+}
+
+int RealtimeIo::ConfiguredCpu() {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    const auto cpu = settings.value(KEY_CPU, ANY_CPU).toInt();
+    const auto cpu_count = static_cast<int>(std::thread::hardware_concurrency());
+    if (cpu < 0 || (cpu_count > 0 && cpu >= cpu_count)) {
+        return ANY_CPU;
+    }
+    return cpu;
+}
+
+bool RealtimeIo::RaiseCurrentThread(int priority, int cpu) {
+#ifdef Q_OS_LINUX
+    sched_param param;
+    param.sched_priority = priority;
+    const auto sched_ok = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+
+    bool affinity_ok = (cpu == ANY_CPU || (cpu >= 0 && cpu < CPU_SETSIZE));
+    if (cpu != ANY_CPU && affinity_ok) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        affinity_ok = (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0);
+    }
+
+    // 没有 CAP_SYS_NICE 时失败，线程仍以普通优先级运行
+    qCritical() << "RealtimeIo::RaiseCurrentThread, priority=" << priority << ", cpu=" << cpu
+                << ", sched=" << sched_ok << ", affinity=" << affinity_ok;
+    return sched_ok && affinity_ok;
+#else
+    Q_UNUSED(priority)
+    Q_UNUSED(cpu)
+    return false;
+#endif
+}
+
+////////////////////////////////////////////////////////
+void LatencyStats::add(qint64 latency_us) {
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && (qint64(1) << bucket) <= latency_us) {
+        bucket++;
+    }
+    buckets_[bucket]++;
+    count_++;
+    sum_ += latency_us;
+    if (latency_us > max_) {
+        max_ = latency_us;
+    }
+}
+
+void LatencyStats::clear() {
+    *this = LatencyStats();
+}
+
+quint64 LatencyStats::count() const {
+    return count_;
+}
+
+qint64 LatencyStats::max() const {
+    return max_;
+}
+
+double LatencyStats::mean() const {
+    return (count_ == 0) ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+qint64 LatencyStats::percentile(double p) const {
+    const auto rank = static_cast<quint64>(std::ceil(p * count_));
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        seen += buckets_[bucket];
+        if (seen >= rank && seen > 0) {
+            return std::min(qint64(1) << bucket, max_);
+        }
+    }
+    return max_;
+}
+
+QString LatencyStats::toString() const {
+    return QString("count=%1, mean=%2 us, p99<=%3 us, max=%4 us")
+            .arg(count_)
+            .arg(mean(), 0, 'f', 1)
+            .arg(percentile(0.99))
+            .arg(max_);
+}
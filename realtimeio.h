@@ -0,0 +1,44 @@
+#ifndef REALTIMEIO_H
+#define REALTIMEIO_H
+
+#include <QString>
+
+// 串口实时模式，仅 Linux 有效，其他平台调用直接返回 false
+// Enable 设置串口的 ASYNC_LOW_LATENCY 标志及 VMIN/VTIME，并 mlockall 锁定已映射的内存，Disable 只撤销成功设置过的项
+// 只锁定当前内存（MCL_CURRENT），MCL_FUTURE 在超过 RLIMIT_MEMLOCK 后会让之后的内存分配失败
+// SCHED_FIFO 和 CPU 亲和只用于专用的串口读线程（RaiseCurrentThread），不提升界面线程，界面忙时不会占满 CPU
+// settings.ini 中 realtime/cpu 指定读线程的 CPU（默认不限），realtime/lock_memory=0 不锁定内存
+class RealtimeIo {
+public:
+    static constexpr int DEFAULT_PRIORITY = 50;
+    static constexpr int ANY_CPU = -1;
+
+    static bool Enable(qintptr fd);
+    static void Disable(qintptr fd);
+    static bool IsEnabled();
+    // settings.ini 中配置的读线程 CPU，没有配置或超出范围时为 ANY_CPU
+    static int ConfiguredCpu();
+    // 在读线程中调用，线程退出即失效
+    static bool RaiseCurrentThread(int priority = DEFAULT_PRIORITY, int cpu = ANY_CPU);
+};
+
+// 调度延迟统计：按 2 的幂分档的直方图，单位微秒
+class LatencyStats {
+public:
+    void add(qint64 latency_us);
+    void clear();
+    quint64 count() const;
+    qint64 max() const;
+    double mean() const;
+    qint64 percentile(double p) const;  // 返回所在分档的上界
+    QString toString() const;
+
+private:
+    static constexpr int BUCKET_COUNT = 32;
+    quint64 buckets_[BUCKET_COUNT] = {};
+    quint64 count_ = 0;
+    qint64 sum_ = 0;
+    qint64 max_ = 0;
+};
+
+#endif // REALTIMEIO_H
@@ -0,0 +1,437 @@
+#include "serialbackend.h"
+#include <algorithm>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+std::unique_ptr<ISerialBackend> ISerialBackend::Create(SettingsDialog::Backend type, ISerialEvents *events) {
+#ifdef Q_OS_LINUX
+    if (type == SettingsDialog::NativeBackend) {
+        return std::unique_ptr<ISerialBackend>(new NativeSerialBackend(events));
+    }
+#else
+    if (type == SettingsDialog::NativeBackend) {
+        qCritical() << "ISerialBackend::Create, native backend not supported, using QSerialPort";
+    }
+#endif
+    return std::unique_ptr<ISerialBackend>(new QtSerialBackend(events));
+}
+
+////////////////////////////////////////////////////////
+QtSerialBackend::QtSerialBackend(ISerialEvents *events):
+    serial_(new QSerialPort(this)),
+    events_(events) {
+
+    connect(serial_, &QSerialPort::errorOccurred, this, &QtSerialBackend::handleError);
+
+    connect(serial_, &QSerialPort::readyRead, this, [this]() {
+        if (events_) {
+            events_->onReadyRead();
+        }
+    });
+}
+
+QtSerialBackend::~QtSerialBackend() {
+    close();
+}
+
+bool QtSerialBackend::open(const SettingsDialog::Settings &s) {
+    serial_->setPortName(s.name);
+    serial_->setBaudRate(s.baudRate);
+    serial_->setDataBits(s.dataBits);
+    serial_->setParity(s.parity);
+    serial_->setStopBits(s.stopBits);
+    serial_->setFlowControl(s.flowControl);
+    return serial_->open(QIODevice::ReadWrite);
+}
+
+void QtSerialBackend::close() {
+    if (serial_->isOpen()) {
+        serial_->close();
+    }
+}
+
+bool QtSerialBackend::isOpen() const {
+    return serial_->isOpen();
+}
+
+qint64 QtSerialBackend::write(const QByteArray &data) {
+    return serial_->write(data);
+}
+
+qint64 QtSerialBackend::read(char *buffer, qint64 max_size) {
+    return serial_->read(buffer, max_size);
+}
+
+qintptr QtSerialBackend::handle() const {
+    return serial_->handle();
+}
+
+QString QtSerialBackend::errorString() const {
+    return serial_->errorString();
+}
+
+void QtSerialBackend::handleError(QSerialPort::SerialPortError error) {
+    qCritical() << "QtSerialBackend::handleError, error_code=" << error
+                << ", error_msg=" << serial_->errorString();
+    if (error == QSerialPort::ResourceError && events_) {
+        events_->onFatalError(-2);
+    }
+}
+
+////////////////////////////////////////////////////////
+#ifdef Q_OS_LINUX
+static speed_t toSpeed(qint32 baud_rate) {
+    switch (baud_rate) {
+    case 1200:   return B1200;
+    case 2400:   return B2400;
+    case 4800:   return B4800;
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default:     return B0;
+    }
+}
+
+// 921600bps 下约 0.7 秒的数据，主线程每次事件循环都会取走
+constexpr size_t RX_RING_SIZE = 1 << 16;
+static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0, "RX_RING_SIZE must be a power of two");
+constexpr qint64 LATENCY_PROBE_INTERVAL_NS = 10 * 1000 * 1000;
+
+static qint64 monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+NativeSerialBackend::NativeSerialBackend(ISerialEvents *events):
+    rx_ring_(RX_RING_SIZE),
+    events_(events) {
+}
+
+NativeSerialBackend::~NativeSerialBackend() {
+    close();
+}
+
+bool NativeSerialBackend::open(const SettingsDialog::Settings &s) {
+    close();
+
+    const auto path = s.name.startsWith('/') ? s.name : QString("/dev/%1").arg(s.name);
+    fd_ = ::open(path.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        setError("open");
+        return false;
+    }
+
+    if (!configure(s)) {
+        close();
+        return false;
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLERR | EPOLLHUP;
+    ev.data.fd = fd_;
+    epoll_event wake;
+    std::memset(&wake, 0, sizeof(wake));
+    wake.events = EPOLLIN;
+    wake.data.fd = wake_fd_;
+    if (epoll_fd_ < 0 || wake_fd_ < 0 ||
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd_, &ev) != 0 ||
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &wake) != 0) {
+        setError("epoll");
+        close();
+        return false;
+    }
+
+    realtime_ = s.realtime;
+    realtime_cpu_ = RealtimeIo::ConfiguredCpu();
+    if (realtime_) {
+        latency_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        epoll_event timer;
+        std::memset(&timer, 0, sizeof(timer));
+        timer.events = EPOLLIN;
+        timer.data.fd = latency_fd_;
+        if (latency_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, latency_fd_, &timer) != 0) {
+            setError("timerfd");
+            close();
+            return false;
+        }
+    }
+
+    session_++;
+    notify_pending_ = false;
+    wakeup_latency_.clear();
+    reader_ = std::thread(&NativeSerialBackend::readerLoop, this, session_);
+
+    qCritical() << "NativeSerialBackend::open, path=" << path << ", fd=" << fd_;
+    return true;
+}
+
+bool NativeSerialBackend::configure(const SettingsDialog::Settings &s) {
+    termios tio;
+    if (tcgetattr(fd_, &tio) != 0) {
+        setError("tcgetattr");
+        return false;
+    }
+
+    cfmakeraw(&tio);
+    const auto speed = toSpeed(s.baudRate);
+    if (speed == B0) {
+        error_ = QString("unsupported baud rate %1").arg(s.baudRate);
+        return false;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    tio.c_cflag |= (CLOCAL | CREAD);
+    tio.c_cflag &= ~CSIZE;
+    switch (s.dataBits) {
+    case QSerialPort::Data5: tio.c_cflag |= CS5; break;
+    case QSerialPort::Data6: tio.c_cflag |= CS6; break;
+    case QSerialPort::Data7: tio.c_cflag |= CS7; break;
+    default:                 tio.c_cflag |= CS8; break;
+    }
+
+    tio.c_cflag &= ~(PARENB | PARODD);
+    if (s.parity == QSerialPort::EvenParity) {
+        tio.c_cflag |= PARENB;
+    } else if (s.parity == QSerialPort::OddParity) {
+        tio.c_cflag |= (PARENB | PARODD);
+    }
+
+    if (s.stopBits == QSerialPort::TwoStop) {
+        tio.c_cflag |= CSTOPB;
+    } else {
+        tio.c_cflag &= ~CSTOPB;
+    }
+
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (s.flowControl == QSerialPort::HardwareControl) {
+        tio.c_cflag |= CRTSCTS;
+    } else if (s.flowControl == QSerialPort::SoftwareControl) {
+        tio.c_iflag |= (IXON | IXOFF);
+    }
+
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd_, TCSANOW, &tio) != 0) {
+        setError("tcsetattr");
+        return false;
+    }
+    tcflush(fd_, TCIOFLUSH);
+    return true;
+}
+
+void NativeSerialBackend::close() {
+    if (reader_.joinable()) {
+        const quint64 one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) < 0) {
+            qCritical() << "NativeSerialBackend::close, failed to wake reader";
+        }
+        reader_.join();
+        if (realtime_) {
+            qCritical() << "NativeSerialBackend::close, reader wakeup latency:" << wakeup_latency_.toString();
+        }
+    }
+    // 读线程已退出，之后到达主线程的通知都属于上一次打开
+    session_++;
+    for (auto fd: {&epoll_fd_, &wake_fd_, &latency_fd_, &fd_}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    rx_head_ = 0;
+    rx_tail_ = 0;
+    rx_dropped_ = 0;
+}
+
+bool NativeSerialBackend::isOpen() const {
+    return (fd_ >= 0);
+}
+
+qint64 NativeSerialBackend::write(const QByteArray &data) {
+    if (fd_ < 0) {
+        return -1;
+    }
+
+    qint64 written = 0;
+    while (written < data.size()) {
+        const auto n = ::write(fd_, data.constData() + written, static_cast<size_t>(data.size() - written));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                // 帧很短，输出缓冲满时等待发送完成后继续
+                tcdrain(fd_);
+                continue;
+            }
+            setError("write");
+            return -1;
+        }
+        written += n;
+    }
+    return written;
+}
+
+// 从读线程已经收到的数据中取出，不再访问 tty；数据在环形缓冲区末尾折返时分两段复制
+qint64 NativeSerialBackend::read(char *buffer, qint64 max_size) {
+    if (fd_ < 0) {
+        return -1;
+    }
+
+    const auto dropped = rx_dropped_.exchange(0);
+    if (dropped > 0) {
+        qCritical() << "NativeSerialBackend::read, rx buffer full, dropped=" << dropped;
+    }
+
+    const auto tail = rx_tail_.load(std::memory_order_relaxed);
+    const auto head = rx_head_.load(std::memory_order_acquire);
+    const auto n = std::min<size_t>(head - tail, static_cast<size_t>(std::max<qint64>(0, max_size)));
+    const auto pos = tail & (RX_RING_SIZE - 1);
+    const auto first = std::min(n, RX_RING_SIZE - pos);
+    std::memcpy(buffer, rx_ring_.data() + pos, first);
+    std::memcpy(buffer + first, rx_ring_.data(), n - first);
+    rx_tail_.store(tail + n, std::memory_order_release);
+    return static_cast<qint64>(n);
+}
+
+qintptr NativeSerialBackend::handle() const {
+    return fd_;
+}
+
+QString NativeSerialBackend::errorString() const {
+    return error_;
+}
+
+// 读线程：只做 epoll_wait 和 read，收到的数据交给主线程处理
+void NativeSerialBackend::readerLoop(quint64 session) {
+    // 定时器按绝对时刻周期触发，实际醒来的时刻减去应触发的时刻即为本线程的调度延迟
+    qint64 latency_start_ns = 0;
+    quint64 expirations = 0;
+    if (realtime_) {
+        RealtimeIo::RaiseCurrentThread(RealtimeIo::DEFAULT_PRIORITY, realtime_cpu_);
+        latency_start_ns = monotonicNs() + LATENCY_PROBE_INTERVAL_NS;
+        itimerspec spec;
+        std::memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = latency_start_ns / 1000000000;
+        spec.it_value.tv_nsec = latency_start_ns % 1000000000;
+        spec.it_interval.tv_nsec = LATENCY_PROBE_INTERVAL_NS;
+        if (timerfd_settime(latency_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+            qCritical() << "NativeSerialBackend, failed to start latency timer";
+        }
+    }
+    for (;;) {
+        epoll_event events[3];
+        const auto count = epoll_wait(epoll_fd_, events, 3, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            postFatalError(session, QString("epoll_wait: %1").arg(QString::fromLocal8Bit(std::strerror(errno))));
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            const auto& ev = events[i];
+            if (ev.data.fd == wake_fd_) {
+                return;
+            }
+            if (ev.data.fd == latency_fd_) {
+                const auto now_ns = monotonicNs();
+                quint64 fired = 0;
+                if (::read(latency_fd_, &fired, sizeof(fired)) == sizeof(fired)) {
+                    expirations += fired;
+                    const auto due_ns = latency_start_ns + static_cast<qint64>(expirations - 1) * LATENCY_PROBE_INTERVAL_NS;
+                    wakeup_latency_.add((now_ns - due_ns) / 1000);
+                }
+                continue;
+            }
+
+            if (ev.events & EPOLLIN) {
+                for (;;) {
+                    // 读到环形缓冲区的连续空闲部分；已满时读出丢弃，否则 epoll 会一直就绪
+                    const auto head = rx_head_.load(std::memory_order_relaxed);
+                    const auto free = RX_RING_SIZE - (head - rx_tail_.load(std::memory_order_acquire));
+                    const auto pos = head & (RX_RING_SIZE - 1);
+                    char overflow[256];
+                    const auto n = (free > 0)
+                            ? ::read(fd_, rx_ring_.data() + pos, std::min(free, RX_RING_SIZE - pos))
+                            : ::read(fd_, overflow, sizeof(overflow));
+                    if (n > 0) {
+                        if (free > 0) {
+                            rx_head_.store(head + static_cast<size_t>(n), std::memory_order_release);
+                        } else {
+                            rx_dropped_ += static_cast<quint64>(n);
+                        }
+                        continue;
+                    }
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n < 0 && errno != EAGAIN) {
+                        postFatalError(session, QString("read: %1").arg(QString::fromLocal8Bit(std::strerror(errno))));
+                        return;
+                    }
+                    break;
+                }
+                postReadyRead(session);
+            }
+            if (ev.events & (EPOLLERR | EPOLLHUP)) {
+                // 拔出 USB 转串口时触发
+                postFatalError(session, "device disconnected");
+                return;
+            }
+        }
+    }
+}
+
+// 主线程还没处理上一次通知时不重复发送，一次 readData 会取走全部数据
+void NativeSerialBackend::postReadyRead(quint64 session) {
+    if (notify_pending_.exchange(true)) {
+        return;
+    }
+    QMetaObject::invokeMethod(this, [this, session]() {
+        notify_pending_ = false;
+        if (session == session_ && events_ != nullptr) {
+            events_->onReadyRead();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void NativeSerialBackend::postFatalError(quint64 session, const QString &error) {
+    QMetaObject::invokeMethod(this, [this, session, error]() {
+        if (session != session_ || events_ == nullptr) {
+            return;
+        }
+        error_ = error;
+        qCritical() << "NativeSerialBackend, reader stopped," << error_;
+        events_->onFatalError(-2);
+    }, Qt::QueuedConnection);
+}
+
+void NativeSerialBackend::setError(const char *what) {
+    error_ = QString("%1: %2").arg(what).arg(QString::fromLocal8Bit(std::strerror(errno)));
+    qCritical() << "NativeSerialBackend," << error_;
+}
+#endif
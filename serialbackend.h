@@ -0,0 +1,102 @@
+#ifndef SERIALBACKEND_H
+#define SERIALBACKEND_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <QObject>
+#include <QSerialPort>
+#include "settingsdialog.h"
+#include "realtimeio.h"
+
+struct ISerialEvents {
+    virtual void onReadyRead() = 0;
+    virtual void onFatalError(int err) = 0;
+};
+
+// 串口传输层，SerialComm 通过它收发数据
+class ISerialBackend {
+public:
+    virtual ~ISerialBackend() = default;
+    virtual bool open(const SettingsDialog::Settings& s) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    virtual qint64 write(const QByteArray& data) = 0;
+    // 读到调用者提供的缓冲区：返回读到的字节数，没有数据返回 0，出错返回 -1
+    virtual qint64 read(char* buffer, qint64 max_size) = 0;
+    virtual qintptr handle() const = 0;
+    virtual QString errorString() const = 0;
+
+    // 当前平台不支持 Native 时退回 QSerialPort
+    static std::unique_ptr<ISerialBackend> Create(SettingsDialog::Backend type, ISerialEvents* events);
+};
+
+class QtSerialBackend: public QObject, public ISerialBackend {
+public:
+    explicit QtSerialBackend(ISerialEvents* events);
+    ~QtSerialBackend() override;
+
+    bool open(const SettingsDialog::Settings& s) override;
+    void close() override;
+    bool isOpen() const override;
+    qint64 write(const QByteArray& data) override;
+    qint64 read(char* buffer, qint64 max_size) override;
+    qintptr handle() const override;
+    QString errorString() const override;
+
+private:
+    void handleError(QSerialPort::SerialPortError error);
+
+private:
+    QSerialPort *serial_ = nullptr;
+    ISerialEvents *events_ = nullptr;
+};
+
+#ifdef Q_OS_LINUX
+// 直接通过 termios 配置 tty，绕过 QSerialPort 的内部缓冲
+// 专用的读线程阻塞在 epoll_wait 上，数据一到立即从 tty 直接读入预先分配的环形缓冲区，再通知主线程取走
+// 环形缓冲区只有读线程写、主线程读，不加锁；主线程从中直接复制到调用者的缓冲区
+// 实时模式下只提升这个读线程的优先级，并用周期定时器统计它的唤醒延迟，关闭时输出
+class NativeSerialBackend: public QObject, public ISerialBackend {
+
+public:
+    explicit NativeSerialBackend(ISerialEvents* events);
+    ~NativeSerialBackend() override;
+
+    bool open(const SettingsDialog::Settings& s) override;
+    void close() override;
+    bool isOpen() const override;
+    qint64 write(const QByteArray& data) override;
+    qint64 read(char* buffer, qint64 max_size) override;
+    qintptr handle() const override;
+    QString errorString() const override;
+
+private:
+    bool configure(const SettingsDialog::Settings& s);
+    void setError(const char* what);
+    void readerLoop(quint64 session);
+    void postReadyRead(quint64 session);
+    void postFatalError(quint64 session, const QString& error);
+
+private:
+    int fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;              // 关闭时写入，唤醒读线程退出
+    int latency_fd_ = -1;           // 实时模式下的周期定时器，测量读线程的唤醒延迟
+    std::thread reader_;
+    std::vector<char> rx_ring_;     // 读线程收到、主线程尚未取走的数据
+    std::atomic<size_t> rx_head_{0};    // 读线程写入的总字节数
+    std::atomic<size_t> rx_tail_{0};    // 主线程取走的总字节数
+    std::atomic<quint64> rx_dropped_{0};    // 缓冲区满时丢弃的字节数
+    std::atomic<bool> notify_pending_{false};
+    quint64 session_ = 0;           // 每次打开加一，丢弃上一次打开时发出的通知
+    bool realtime_ = false;         // 读线程以 SCHED_FIFO 运行
+    int realtime_cpu_ = RealtimeIo::ANY_CPU;
+    LatencyStats wakeup_latency_;   // 只在读线程中更新，读线程退出后再读取
+    ISerialEvents *events_ = nullptr;
+    QString error_;
+};
+#endif
+
+#endif // SERIALBACKEND_H
@@ -0,0 +1,157 @@
+#include "serialbench.h"
+#include <chrono>
+#include <QEventLoop>
+#include <QTimer>
+#include <QStringList>
+#include <QDebug>
+#include "serialbackend.h"
+#include "deviceitem.h"
+
+constexpr int BENCH_TIMEOUT_MS = 500;
+constexpr int BENCH_CHUNK_SIZE = 256;
+constexpr quint8 READ_CMD = 0x38;
+constexpr quint8 CK3864S_CMD = 0xAA;
+constexpr quint8 CK3862S_CMD = 0x55;
+constexpr int READ_CMD_BYTE_COUNT = 5;
+
+class BenchReceiver: public ISerialEvents {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void reset() {
+        received.clear();
+        has_first_byte = false;
+        failed = false;
+        start = Clock::now();
+    }
+
+    bool isComplete() const {
+        if (received.isEmpty()) {
+            return false;
+        }
+        const auto cmd = static_cast<quint8>(received[0]);
+        int expected = READ_CMD_BYTE_COUNT;
+        if (cmd == CK3864S_CMD) {
+            expected = CK3864S_ITEM_COUNT + 3;
+        } else if (cmd == CK3862S_CMD) {
+            expected = CK3862S_ITEM_COUNT + 3;
+        }
+        return (received.size() >= expected);
+    }
+
+    void onReadyRead() override {
+        char chunk[BENCH_CHUNK_SIZE];
+        qint64 size = 0;
+        while ((size = backend->read(chunk, sizeof(chunk))) > 0) {
+            if (!has_first_byte) {
+                first_byte = Clock::now();
+                has_first_byte = true;
+            }
+            received.append(chunk, static_cast<int>(size));
+        }
+        if (isComplete()) {
+            frame = Clock::now();
+            loop->quit();
+        }
+    }
+
+    void onFatalError(int err) override {
+        qCritical() << "BenchReceiver::onFatalError, err=" << err;
+        failed = true;
+        loop->quit();
+    }
+
+    ISerialBackend *backend = nullptr;
+    QEventLoop *loop = nullptr;
+    QByteArray received;
+    bool has_first_byte = false;
+    bool failed = false;
+    Clock::time_point start;
+    Clock::time_point first_byte;
+    Clock::time_point frame;
+};
+
+static SerialBenchResult runBackend(const SettingsDialog::Settings &settings, int iterations) {
+    SerialBenchResult result;
+    result.backend = (settings.backend == SettingsDialog::NativeBackend) ? "native" : "qserialport";
+
+    QEventLoop loop;
+    BenchReceiver receiver;
+    auto backend = ISerialBackend::Create(settings.backend, &receiver);
+    receiver.backend = backend.get();
+    receiver.loop = &loop;
+    if (!backend->open(settings)) {
+        qCritical() << "SerialBench::Run, open failed, backend=" << result.backend
+                    << ", error=" << backend->errorString();
+        result.failures = iterations;
+        return result;
+    }
+
+    QByteArray cmd;
+    cmd.push_back(static_cast<char>(READ_CMD));
+    cmd.push_back(0x02);
+    cmd.push_back(static_cast<char>(0));
+    cmd.push_back(static_cast<char>(0));
+    cmd.push_back(0x02);
+
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    using namespace std::chrono;
+    for (int i = 0; i < iterations; i++) {
+        receiver.reset();
+        if (backend->write(cmd) != cmd.size()) {
+            result.failures++;
+            continue;
+        }
+
+        timeout.start(BENCH_TIMEOUT_MS);
+        loop.exec();
+        timeout.stop();
+        if (receiver.failed) {
+            result.failures += iterations - i;
+            break;
+        }
+        if (!receiver.isComplete()) {
+            result.failures++;
+            continue;
+        }
+
+        result.first_byte.add(duration_cast<microseconds>(receiver.first_byte - receiver.start).count());
+        result.frame.add(duration_cast<microseconds>(receiver.frame - receiver.start).count());
+    }
+
+    backend->close();
+    return result;
+}
+
+std::vector<SerialBenchResult> SerialBench::Run(const SettingsDialog::Settings &settings, int iterations) {
+    std::vector<SerialBenchResult> results;
+
+    auto qt_settings = settings;
+    qt_settings.backend = SettingsDialog::QtBackend;
+    results.push_back(runBackend(qt_settings, iterations));
+
+#ifdef Q_OS_LINUX
+    auto native_settings = settings;
+    native_settings.backend = SettingsDialog::NativeBackend;
+    results.push_back(runBackend(native_settings, iterations));
+#endif
+
+    qCritical() << "SerialBench::Run, port=" << settings.name << ", baud=" << settings.baudRate
+                << "," << Summary(results);
+    return results;
+}
+
+QString SerialBench::Summary(const std::vector<SerialBenchResult> &results) {
+    QStringList parts;
+    for (const auto& r: results) {
+        parts << QString("%1: first byte [%2], frame [%3], failures=%4")
+                 .arg(r.backend)
+                 .arg(r.first_byte.toString())
+                 .arg(r.frame.toString())
+                 .arg(r.failures);
+    }
+    return parts.join("; ");
+}
@@ -0,0 +1,24 @@
+#ifndef SERIALBENCH_H
+#define SERIALBENCH_H
+
+#include <vector>
+#include <QString>
+#include "settingsdialog.h"
+#include "realtimeio.h"
+
+struct SerialBenchResult {
+    QString backend;
+    LatencyStats first_byte;    // 发出读取命令到收到第一个字节
+    LatencyStats frame;         // 发出读取命令到收到完整应答
+    int failures = 0;
+};
+
+// 在同一端口上依次用各传输方式发送读取命令，统计往返延迟
+// 接回环线时以命令回显作为应答
+class SerialBench {
+public:
+    static std::vector<SerialBenchResult> Run(const SettingsDialog::Settings& settings, int iterations);
+    static QString Summary(const std::vector<SerialBenchResult>& results);
+};
+
+#endif // SERIALBENCH_H
@@ -1,19 +1,27 @@
 ﻿#include "serialcomm.h"
+#include <algorithm>
 #include <QMessageBox>
 #include "settingsdialog.h"
+#include "realtimeio.h"
+#include "baudprobe.h"
+#include "linktimeout.h"
+#include "deviceitem.h"
+#include "portwatcher.h"
 
-SerialComm::SerialComm():
-    m_serial_(new QSerialPort(this)),
-    m_settings_(new SettingsDialog) {
-
-    connect(m_serial_, &QSerialPort::errorOccurred, this, &SerialComm::handleError);
+constexpr int READ_BUFFER_SIZE = 4096;
+constexpr int LINK_ERROR_LIMIT = 3;
+constexpr int MAX_FRAME_BYTES = CK3864S_ITEM_COUNT + 3;   // 最长的帧为 CK3864S 参数帧
+constexpr qint64 TX_TIMER_SLACK_US = 2000;                 // 毫秒定时取整 + 调度延迟
 
-    connect(m_serial_, &QSerialPort::readyRead, this, &SerialComm::readData);
+SerialComm::SerialComm():
+    backend_(ISerialBackend::Create(SettingsDialog::QtBackend, this)),
+    read_buffer_(READ_BUFFER_SIZE, 0) {
+    connect(PortWatcher::Instance(), &PortWatcher::portRemoved,
+            this, [this](const QString& name) { onPortRemoved(name); });
 }
 
 SerialComm::~SerialComm() {
-    delete m_serial_;
-    m_serial_ = nullptr;
+    backend_.reset();
 
     delete m_settings_;
     m_settings_ = nullptr;
@@ -25,28 +33,133 @@ SerialComm* SerialComm::Instance() {
 }
 
 bool SerialComm::is_ready() {
-    if (m_serial_) {
-        return m_serial_->isOpen();
+    if (backend_) {
+        return backend_->isOpen();
     }
     return false;
 }
 
-bool SerialComm::writeData(const QByteArray &data) {
-    const auto byte_written = m_serial_->write(data);
-    qCritical() << "SerialComm::writeData, byte_written=" << byte_written;
-    assert(byte_written == data.size());
-    return (byte_written == data.size());
+// 帧先进入对应优先级的队列，线路空闲时立即发出
+bool SerialComm::writeData(const QByteArray &data, Priority priority) {
+    if (!backend_->isOpen()) {
+        qCritical() << "SerialComm::writeData, port not open";
+        return false;
+    }
+
+    tx_queue_[priority].push_back({data, std::chrono::steady_clock::now()});
+    if (tx_timer_id_ == 0) {
+        PumpTx();
+    }
+    return true;
+}
+
+const LatencyStats &SerialComm::GetTxLatency(Priority priority) const {
+    return tx_latency_[priority];
+}
+
+qint64 SerialComm::UrgentLatencyBoundUs() const {
+    return (FrameTimeUs(MAX_FRAME_BYTES) + 999) / 1000 * 1000 + TX_TIMER_SLACK_US;
+}
+
+qint64 SerialComm::FrameTimeUs(int byte_count) const {
+    const auto p = settings();
+    if (p.baudRate <= 0) {
+        return 0;
+    }
+    return static_cast<qint64>(byte_count) * TimeoutModel::BitsPerByte(p) * 1000000 / p.baudRate;
+}
+
+// 只把一帧交给驱动，按帧长估算发送完成的时刻，到时再取下一帧
+// 这样紧急帧最多等待正在线路上的一帧，而不是排在驱动缓冲区里所有帧之后
+// 写失败或只写入一部分的帧直接丢弃并通知上层，同一队列后面的帧继续发送，不会滞留
+void SerialComm::PumpTx() {
+    for (int priority = 0; priority < PRIORITY_COUNT;) {
+        auto& queue = tx_queue_[priority];
+        if (queue.empty()) {
+            priority++;
+            continue;
+        }
+
+        const auto frame = std::move(queue.front());
+        queue.pop_front();
+
+        using namespace std::chrono;
+        const auto wait_us = duration_cast<microseconds>(steady_clock::now() - frame.queued).count();
+        tx_latency_[priority].add(wait_us);
+        if (priority == PRIORITY_URGENT && wait_us > UrgentLatencyBoundUs()) {
+            qCritical() << "SerialComm::PumpTx, urgent frame late, wait=" << wait_us
+                        << "us, bound=" << UrgentLatencyBoundUs() << "us";
+        }
+
+        const auto byte_written = backend_->write(frame.data);
+        qCritical() << "SerialComm::writeData, priority=" << priority << ", byte_written=" << byte_written;
+        if (byte_written != frame.data.size()) {
+            // 丢弃该帧；端口已关闭时其余帧也无法发送，由 onClose 结束上层的收发
+            if (!backend_->isOpen()) {
+                return;
+            }
+            NotifyWriteFailed(frame.data);
+            // 一个字节也没写入时线路空闲，立即取同一队列的下一帧
+            if (byte_written <= 0) {
+                continue;
+            }
+        }
+
+        // 已写入的字节发送完毕后再取下一帧
+        const auto busy_ms = (FrameTimeUs(static_cast<int>(byte_written)) + 999) / 1000;
+        tx_timer_id_ = startTimer(static_cast<int>(std::max<qint64>(1, busy_ms)), Qt::PreciseTimer);
+        assert(tx_timer_id_ != 0);
+        return;
+    }
 }
 
+void SerialComm::ClearTx() {
+    if (tx_timer_id_ != 0) {
+        killTimer(tx_timer_id_);
+        tx_timer_id_ = 0;
+    }
+    for (auto& queue: tx_queue_) {
+        queue.clear();
+    }
+}
+
+void SerialComm::timerEvent(QTimerEvent *event) {
+    if (event->timerId() != tx_timer_id_) {
+        return;
+    }
+
+    killTimer(tx_timer_id_);
+    tx_timer_id_ = 0;
+    if (backend_->isOpen()) {
+        PumpTx();
+    }
+}
+
+// 读到复用的缓冲区，回调拿到的数据只在回调期间有效
 void SerialComm::readData() {
-    QByteArray data = m_serial_->readAll();
+    while (backend_->isOpen()) {
+        const auto size = backend_->read(read_buffer_.data(), read_buffer_.size());
+        if (size <= 0) {
+            break;
+        }
 
-    qCritical() << "SerialComm::readData, data_size=" << data.size();
-    if (data_read_) {
-        data_read_->onRead(std::move(data));
+        qCritical() << "SerialComm::readData, data_size=" << size;
+        if (data_read_) {
+            data_read_->onRead(QByteArray::fromRawData(read_buffer_.constData(), static_cast<int>(size)));
+        }
     }
 }
 
+void SerialComm::onReadyRead() {
+    readData();
+}
+
+void SerialComm::onFatalError(int err) {
+    qCritical() << "SerialComm::onFatalError, err=" << err
+                << ", error_msg=" << backend_->errorString();
+    closeSerialPort(err);
+}
+
 void SerialComm::SetDataReadCallback(IDataRead *cb) {
     data_read_ = cb;
 }
@@ -55,35 +168,46 @@ void SerialComm::SetShowStatusCallback(IShowStatus *cb) {
     show_status_ = cb;
 }
 
-void SerialComm::handleError(QSerialPort::SerialPortError error) {
-    qCritical() << "SerialComm::handleError, error_code=" << error
-                << ", error_msg=" << m_serial_->errorString();
-    if (error == QSerialPort::ResourceError) {
-        closeSerialPort(-2);
-    }
-}
-
 void SerialComm::showSetting() {
-    m_settings_->show();
+    dialog()->show();
 }
 
 bool SerialComm::openSerialPort() {
-    const SettingsDialog::Settings p = m_settings_->settings();
-    m_serial_->setPortName(p.name);
-    m_serial_->setBaudRate(p.baudRate);
-    m_serial_->setDataBits(p.dataBits);
-    m_serial_->setParity(p.parity);
-    m_serial_->setStopBits(p.stopBits);
-    m_serial_->setFlowControl(p.flowControl);
-    const auto is_ok = m_serial_->open(QIODevice::ReadWrite);
+    SettingsDialog::Settings p = dialog()->settings();
+    // 只在端口关闭时替换传输方式，避免在传输层自身的回调中被销毁
+    if (p.backend != backend_type_ && !backend_->isOpen()) {
+        backend_ = ISerialBackend::Create(p.backend, this);
+        backend_type_ = p.backend;
+    }
+    // 在界面线程上只按记录的波特率验证一次；无应答时清除记录，下次连接重新协商
+    if (p.autoBaud && !backend_->isOpen() && BaudProbe::IsRemembered(p.name)) {
+        p.baudRate = BaudProbe::RememberedRate(p.name);
+        if (!BaudProbe::Verify(p)) {
+            qCritical() << "SerialComm::openSerialPort, no response at remembered rate" << p.baudRate;
+            BaudProbe::Forget(p.name);
+        }
+    }
+    const auto is_ok = backend_->open(p);
+    current_ = p;
+    link_errors_ = 0;
+    ClearTx();
+    for (auto& latency: tx_latency_) {
+        latency.clear();
+    }
+
+    if (is_ok && p.realtime) {
+        RealtimeIo::Enable(backend_->handle());
+    }
 
     if (is_ok) {
+        serial_number_ = PortWatcher::Instance()->serialNumber(p.name);
+        lost_serial_.clear();
         const auto msg = QString("Connected to %1").arg(p.name);
         qCritical() << tr("SerialComm::openSerialPort, Connected to %1").arg(p.name);
-        ShowStatus(QString::fromWCharArray(L"已连接 %1").arg(p.name));
+        ShowStatus(QString::fromWCharArray(L"已连接 %1, %2bps").arg(p.name).arg(p.baudRate));
     } else {
         qCritical() << "SerialComm::openSerialPort, Failed to open port:"
-                    << p.name << ", error=" << m_serial_->errorString();
+                    << p.name << ", error=" << backend_->errorString();
         ShowStatus(QString::fromWCharArray(L"无法连接%1").arg(p.name));
         data_read_->onClose(-1);
     }
@@ -91,9 +215,110 @@ bool SerialComm::openSerialPort() {
     return is_ok;
 }
 
+// 设置对话框会枚举串口，推迟到第一次用到时再创建，不占用启动时间
+SettingsDialog *SerialComm::dialog() const {
+    if (m_settings_ == nullptr) {
+        m_settings_ = new SettingsDialog;
+    }
+    return m_settings_;
+}
+
+bool SerialComm::selectPort(const QString &name) {
+    return dialog()->selectPort(name);
+}
+
+QString SerialComm::lostSerialNumber() const {
+    return lost_serial_;
+}
+
+// 适配器拔出时立即关闭，不等 QSerialPort 报 ResourceError；记下序列号以便插回时重连
+void SerialComm::onPortRemoved(const QString &name) {
+    if (!backend_->isOpen() || name != current_.name) {
+        return;
+    }
+
+    qCritical() << "SerialComm::onPortRemoved, port=" << name << ", serial=" << serial_number_;
+    lost_serial_ = serial_number_;
+    closeSerialPort(-2);
+}
+
+// 端口打开时返回实际使用的参数（含协商后的波特率）
+SettingsDialog::Settings SerialComm::settings() const {
+    if (backend_->isOpen()) {
+        return current_;
+    }
+    return dialog()->settings();
+}
+
+void SerialComm::ReportTransaction(bool ok) {
+    if (ok) {
+        link_errors_ = 0;
+        return;
+    }
+
+    link_errors_++;
+    if (link_errors_ >= LINK_ERROR_LIMIT) {
+        link_errors_ = 0;
+        StepDownBaudRate();
+    }
+}
+
+// 不经过 closeSerialPort，上层的传输状态保持不变
+// 控制器在低一档的波特率上能应答才切换并记住；否则（例如控制器断电）按原波特率重新打开
+bool SerialComm::StepDownBaudRate() {
+    const auto rate = BaudProbe::LowerRate(current_.baudRate);
+    if (rate == 0 || !backend_->isOpen()) {
+        return false;
+    }
+
+    const auto realtime = RealtimeIo::IsEnabled();
+    if (realtime) {
+        RealtimeIo::Disable(backend_->handle());
+    }
+    ClearTx();
+    backend_->close();
+
+    auto p = current_;
+    p.baudRate = rate;
+    const auto is_verified = BaudProbe::Verify(p);
+    if (!is_verified) {
+        p.baudRate = current_.baudRate;
+    }
+    if (!backend_->open(p)) {
+        qCritical() << "SerialComm::StepDownBaudRate, failed to reopen, rate=" << p.baudRate
+                    << ", error=" << backend_->errorString();
+        closeSerialPort(-1);
+        return false;
+    }
+    if (realtime) {
+        RealtimeIo::Enable(backend_->handle());
+    }
+
+    if (!is_verified) {
+        qCritical() << "SerialComm::StepDownBaudRate, no response at" << rate << ", keep" << current_.baudRate;
+        return false;
+    }
+
+    qCritical() << "SerialComm::StepDownBaudRate, " << current_.baudRate << "->" << rate;
+    current_ = p;
+    BaudProbe::Remember(p.name, rate);
+    ShowStatus(QString::fromWCharArray(L"已连接 %1, %2bps").arg(p.name).arg(p.baudRate));
+    return true;
+}
+
 void SerialComm::closeSerialPort(int err) {
-    if (m_serial_->isOpen())
-        m_serial_->close();
+    ClearTx();
+    qCritical() << "SerialComm::closeSerialPort, tx latency urgent:" << tx_latency_[PRIORITY_URGENT].toString()
+                << ", control:" << tx_latency_[PRIORITY_CONTROL].toString()
+                << ", bulk:" << tx_latency_[PRIORITY_BULK].toString();
+    if (RealtimeIo::IsEnabled()) {
+        RealtimeIo::Disable(backend_->isOpen() ? backend_->handle() : -1);
+    }
+    if (backend_->isOpen())
+        backend_->close();
+    if (err == 0) {
+        lost_serial_.clear();
+    }
     ShowStatus(QString::fromWCharArray(DISCONNECTED));
     qCritical() << "SerialComm::closeSerialPort, err=" << err;
 
@@ -102,6 +327,15 @@ void SerialComm::closeSerialPort(int err) {
     }
 }
 
+// 排队通知，上层在回调中可能再次写入，不能在 PumpTx 中直接回调
+void SerialComm::NotifyWriteFailed(const QByteArray &data) {
+    QMetaObject::invokeMethod(this, [this, data]() {
+        if (data_read_) {
+            data_read_->onWriteFailed(data);
+        }
+    }, Qt::QueuedConnection);
+}
+
 void SerialComm::ShowStatus(const QString &s) {
     if (show_status_) {
         show_status_->setStatus(s);
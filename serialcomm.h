@@ -1,36 +1,87 @@
 #ifndef SERIALCOMM_H
 #define SERIALCOMM_H
 
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <QObject>
+#include <QTimerEvent>
 #include <QSerialPort>
 #include "settingsdialog.h"
+#include "serialbackend.h"
+#include "realtimeio.h"
 #include "basic_def.h"
 
-class SerialComm: public QObject {
+class SerialComm: public QObject, public ISerialEvents {
 public:
+    // 发送优先级：线路上同时只有一帧在发送，每个帧边界取优先级最高的帧
+    enum Priority {
+        PRIORITY_URGENT = 0,    // VSP 归零、刹车（仅协议 2 的调试帧）
+        PRIORITY_CONTROL = 1,   // 周期发送的调试设定值
+        PRIORITY_BULK = 2,      // 参数读写
+        PRIORITY_COUNT = 3
+    };
+
     static SerialComm* Instance();
     bool is_ready();
-    bool writeData(const QByteArray &data);
+    bool writeData(const QByteArray &data, Priority priority = PRIORITY_BULK);
+    const LatencyStats& GetTxLatency(Priority priority) const;
+    // 紧急帧从提交到开始发送的最坏延迟：线路上正在发送的最长帧 + 定时误差
+    qint64 UrgentLatencyBoundUs() const;
     void readData();
     void SetDataReadCallback(IDataRead* cb);
     void SetShowStatusCallback(IShowStatus* cb);
+    // 自动协商时只按记录的波特率验证一次，没有记录的端口应先在工作线程中 BaudProbe::Probe 并 Remember
     bool openSerialPort();
     void closeSerialPort(int err);
+    SettingsDialog::Settings settings() const;
+    bool selectPort(const QString& name);
+    // 拔出后等待重连的适配器序列号，手动断开时为空
+    QString lostSerialNumber() const;
+    // 传输层上报每次收发的结果，连续失败时降低波特率
+    void ReportTransaction(bool ok);
 
 public slots:
     void showSetting();
 
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
 private:
     SerialComm();
     ~SerialComm();
 
+    // ISerialEvents interface
+    virtual void onReadyRead() override;
+    virtual void onFatalError(int err) override;
+
 private:
     void ShowStatus(const QString& s);
-    void handleError(QSerialPort::SerialPortError error);
+    void NotifyWriteFailed(const QByteArray& data);
+    SettingsDialog* dialog() const;
+    bool StepDownBaudRate();
+    void onPortRemoved(const QString& name);
+    void PumpTx();
+    void ClearTx();
+    qint64 FrameTimeUs(int byte_count) const;
 
 private:
-    QSerialPort *m_serial_ = nullptr;
-    SettingsDialog *m_settings_ = nullptr;
+    std::unique_ptr<ISerialBackend> backend_;
+    SettingsDialog::Backend backend_type_ = SettingsDialog::QtBackend;
+    QByteArray read_buffer_;
+    mutable SettingsDialog *m_settings_ = nullptr;
+    SettingsDialog::Settings current_;
+    int link_errors_ = 0;
+    QString serial_number_;
+    QString lost_serial_;
+
+    struct TxFrame {
+        QByteArray data;
+        std::chrono::steady_clock::time_point queued;
+    };
+    std::deque<TxFrame> tx_queue_[PRIORITY_COUNT];
+    int tx_timer_id_ = 0;           // 非 0 表示线路上有帧正在发送
+    LatencyStats tx_latency_[PRIORITY_COUNT];
     IDataRead *data_read_= nullptr;
     IShowStatus *show_status_ = nullptr;
 };
@@ -4,6 +4,8 @@
 #include <QIntValidator>
 #include <QLineEdit>
 #include <QSerialPortInfo>
+#include "baudprobe.h"
+#include "portwatcher.h"
 
 static const char blankString[] = QT_TRANSLATE_NOOP("SettingsDialog", "N/A");
 
@@ -18,7 +20,14 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
     connect(m_ui->serialPortInfoListBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &SettingsDialog::showPortInfo);
 
+    m_ui->backendBox->addItem(QStringLiteral("QSerialPort"), QtBackend);
+#ifdef Q_OS_LINUX
+    m_ui->backendBox->addItem(QStringLiteral("Native (epoll/termios)"), NativeBackend);
+#endif
+
     fillPortsInfo();
+    connect(PortWatcher::Instance(), &PortWatcher::portsChanged,
+            this, &SettingsDialog::refreshPorts);
 
     updateSettings();
 }
@@ -31,6 +40,17 @@ SettingsDialog::Settings SettingsDialog::settings() const {
     return m_currentSettings;
 }
 
+bool SettingsDialog::selectPort(const QString &name) {
+    const auto idx = m_ui->serialPortInfoListBox->findText(name);
+    if (idx == -1) {
+        return false;
+    }
+
+    m_ui->serialPortInfoListBox->setCurrentIndex(idx);
+    updateSettings();
+    return true;
+}
+
 void SettingsDialog::showPortInfo(int idx) {
     if (idx == -1)
         return;
@@ -39,6 +59,7 @@ void SettingsDialog::showPortInfo(int idx) {
     m_ui->descriptionLabel->setText(tr("描述: %1").arg(list.count() > 1 ? list.at(1) : tr(blankString)));
     m_ui->manufacturerLabel->setText(tr("厂商: %1").arg(list.count() > 2 ? list.at(2) : tr(blankString)));
     m_ui->serialNumberLabel->setText(tr("序列号：%1").arg(list.count() > 3 ? list.at(3) : tr(blankString)));
+    m_ui->baudRateLabel->setText(tr("波特率: %1").arg(BaudProbe::RememberedRate(m_ui->serialPortInfoListBox->itemText(idx))));
     m_ui->locationLabel->setText(tr("位置: %1").arg(list.count() > 4 ? list.at(4) : tr(blankString)));
     m_ui->vidLabel->setText(tr("提供者ID: %1").arg(list.count() > 5 ? list.at(5) : tr(blankString)));
     m_ui->pidLabel->setText(tr("产品ID: %1").arg(list.count() > 6 ? list.at(6) : tr(blankString)));
@@ -49,12 +70,22 @@ void SettingsDialog::apply() {
     hide();
 }
 
+// 热插拔后刷新列表，保持当前选中的端口；已应用的设置不变
+void SettingsDialog::refreshPorts() {
+    const auto current = m_ui->serialPortInfoListBox->currentText();
+    fillPortsInfo();
+    const auto idx = m_ui->serialPortInfoListBox->findText(current);
+    if (idx != -1) {
+        m_ui->serialPortInfoListBox->setCurrentIndex(idx);
+    }
+}
+
 void SettingsDialog::fillPortsInfo() {
     m_ui->serialPortInfoListBox->clear();
     QString description;
     QString manufacturer;
     QString serialNumber;
-    const auto infos = QSerialPortInfo::availablePorts();
+    const auto infos = PortWatcher::Instance()->ports();
     for (const QSerialPortInfo &info : infos) {
         QStringList list;
         description = info.description();
@@ -74,9 +105,13 @@ void SettingsDialog::fillPortsInfo() {
 
 void SettingsDialog::updateSettings() {
     m_currentSettings.name = m_ui->serialPortInfoListBox->currentText();
-    m_currentSettings.baudRate = QSerialPort::Baud9600;
+    // 使用该端口上次协商出的波特率，没有记录时为 9600
+    m_currentSettings.baudRate = BaudProbe::RememberedRate(m_currentSettings.name);
     m_currentSettings.dataBits = QSerialPort::Data8;
     m_currentSettings.parity = QSerialPort::NoParity;
     m_currentSettings.stopBits = QSerialPort::OneStop;
     m_currentSettings.flowControl = QSerialPort::NoFlowControl;
+    m_currentSettings.realtime = m_ui->realtimeCheckBox->isChecked();
+    m_currentSettings.autoBaud = m_ui->autoBaudCheckBox->isChecked();
+    m_currentSettings.backend = static_cast<Backend>(m_ui->backendBox->currentData().toInt());
 }
@@ -19,6 +19,11 @@ class SettingsDialog : public QDialog
     Q_OBJECT
 
 public:
+    enum Backend {
+        QtBackend = 0,
+        NativeBackend = 1
+    };
+
     struct Settings {
         QString name;
         qint32 baudRate;
@@ -26,16 +31,21 @@ public:
         QSerialPort::Parity parity;
         QSerialPort::StopBits stopBits;
         QSerialPort::FlowControl flowControl;
+        bool realtime;
+        bool autoBaud;
+        Backend backend;
     };
 
     explicit SettingsDialog(QWidget *parent = nullptr);
     ~SettingsDialog();
 
     Settings settings() const;
+    bool selectPort(const QString& name);
 
 private slots:
     void showPortInfo(int idx);
     void apply();
+    void refreshPorts();
 
 private:
     void fillPortsInfo();
@@ -0,0 +1,57 @@
+#include "startupbench.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+#include <QWidget>
+#include <QEvent>
+#include <QDebug>
+
+StartupBench& StartupBench::Instance() {
+    static StartupBench inst;
+    return inst;
+}
+
+void StartupBench::Start() {
+    marks_.clear();
+    timer_.start();
+}
+
+void StartupBench::Mark(const char *stage) {
+    if (timer_.isValid()) {
+        marks_.emplace_back(stage, timer_.nsecsElapsed() / 1000);
+    }
+}
+
+void StartupBench::WatchFirstFrame(QWidget *window, bool quit_after) {
+    window_ = window;
+    quit_after_ = quit_after;
+    window_->installEventFilter(this);
+}
+
+QString StartupBench::Report() const {
+    QStringList parts;
+    for (const auto& mark: marks_) {
+        parts << QString("%1=%2ms").arg(mark.first).arg(mark.second / 1000.0, 0, 'f', 1);
+    }
+    return parts.join(", ");
+}
+
+bool StartupBench::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == window_ && event->type() == QEvent::Paint) {
+        window_->removeEventFilter(this);
+        // 等本次绘制结束后再记录
+        QTimer::singleShot(0, this, [this]() { OnFirstFrame(); });
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void StartupBench::OnFirstFrame() {
+    Mark("first frame");
+    qCritical() << "StartupBench," << Report();
+
+    if (quit_after_) {
+        QTextStream(stdout) << Report() << Qt::endl;
+        QCoreApplication::quit();
+    }
+}
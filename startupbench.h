@@ -0,0 +1,35 @@
+#ifndef STARTUPBENCH_H
+#define STARTUPBENCH_H
+
+#include <vector>
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+
+class QWidget;
+
+// 启动耗时统计：各阶段相对进程启动的时间，以及主窗口第一次绘制完成的时间
+// 带 --startup-benchmark 参数启动时，第一帧绘制完成后输出结果并退出
+class StartupBench: public QObject {
+public:
+    static StartupBench& Instance();
+    void Start();
+    void Mark(const char* stage);
+    void WatchFirstFrame(QWidget* window, bool quit_after);
+    QString Report() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    StartupBench() = default;
+    void OnFirstFrame();
+
+private:
+    QElapsedTimer timer_;
+    std::vector<std::pair<const char*, qint64>> marks_;    // 阶段名, 微秒
+    QWidget *window_ = nullptr;
+    bool quit_after_ = false;
+};
+
+#endif // STARTUPBENCH_H
@@ -0,0 +1,344 @@
+#include "startupsim.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <QDebug>
+#include "deviceitem.h"
+
+constexpr int SIM_CHUNK_SIZE = 256;
+constexpr float SIM_DT = 50e-6f;                // 仿真步长与 ZC-Limit 单位一致，50 us
+constexpr float STARTP_SCALE = 1.0f / 220.0f;   // (1/220) 启动力度
+constexpr float START_LIMIT_UNIT = 0.25f;       // (250 MS) 启动时间限定
+constexpr float ZC_LIMIT_UNIT = 50e-6f;         // (50 US) ZC滤波深度
+constexpr float SECTOR = 3.14159265f / 3.0f;    // 六步换相，每次 60 度电角度
+constexpr float SYNC_TORQUE_FACTOR = 0.95f;     // 同步后六步换相的平均转矩系数
+constexpr float LOST_TORQUE_FACTOR = 0.5f;      // 过零无效时换相滞后，转矩下降
+constexpr long SIM_COMPACT_STEPS = 20;          // 每 1 ms 移出一次已结束的组合
+constexpr int GRID_P_STEP = 5;                  // StartP 取 24 个值，间隔 5
+constexpr int GRID_P_COUNT = 24;
+constexpr int GRID_T_STEP = 5;                  // StartT 取 20 个值，间隔 5 ms
+constexpr int GRID_T_COUNT = 20;
+constexpr int GRID_STEP_STEP = 1;               // Start-Step 取 10 个值
+constexpr int GRID_STEP_COUNT = 10;
+constexpr float PI = 3.14159265f;
+constexpr float TWO_PI = 2.0f * PI;
+constexpr float INV_TWO_PI = 1.0f / TWO_PI;
+
+// 无分支的正弦：先归约到 [-π, π]，取绝对值后折到 [0, π/2] 用 11 阶泰勒多项式，误差小于 1e-7
+static inline float FastSin(float x) {
+    const float n = x * INV_TWO_PI;
+    const float k = static_cast<float>(static_cast<int>(n + std::copysign(0.5f, n)));
+    const float r = x - k * TWO_PI;
+    const float a = std::fabs(r);
+    const float s = std::min(a, PI - a);
+    const float s2 = s * s;
+    const float y = s * (1.0f + s2 * (-1.0f / 6 + s2 * (1.0f / 120 + s2 * (-1.0f / 5040
+                  + s2 * (1.0f / 362880 + s2 * (-1.0f / 39916800))))));
+    return std::copysign(y, r);
+}
+
+bool MotorModel::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const auto json = QJsonDocument::fromJson(file.readAll()).object();
+    if (json.isEmpty()) {
+        qCritical() << "MotorModel::load, invalid file, path=" << path;
+        return false;
+    }
+
+    resistance = static_cast<float>(json["resistance"].toDouble(resistance));
+    ke = static_cast<float>(json["ke"].toDouble(ke));
+    inertia = static_cast<float>(json["inertia"].toDouble(inertia));
+    load_torque = static_cast<float>(json["load_torque"].toDouble(load_torque));
+    friction = static_cast<float>(json["friction"].toDouble(friction));
+    vbus = static_cast<float>(json["vbus"].toDouble(vbus));
+    zc_min_bemf = static_cast<float>(json["zc_min_bemf"].toDouble(zc_min_bemf));
+    pole_pairs = json["pole_pairs"].toInt(pole_pairs);
+    return true;
+}
+
+StartupParams StartupParams::FromDeviceManager() {
+    const auto& devMgr = DeviceManager::Instance();
+    StartupParams params;
+    const auto value = [&devMgr](const char* name, quint8 fallback) -> quint8 {
+        ValueType v = 0;
+        return devMgr.findValue(name, &v) ? v : fallback;
+    };
+
+    params.start_p = value("StartP:", params.start_p);
+    params.start_t = value("StartT:", params.start_t);
+    params.start_step = value("Start-Step:", params.start_step);
+    params.evol_count = value("Evol-Count:", params.evol_count);
+    params.zc_limit = value("ZC-Limit:", params.zc_limit);
+    params.stall = value("Stall:", params.stall);
+    params.start_limit = value("Start-Limit:", params.start_limit);
+    return params;
+}
+
+StartupSimulator::StartupSimulator(const MotorModel &motor):
+    motor_(motor) {
+}
+
+std::vector<StartupResult> StartupSimulator::Evaluate(const std::vector<StartupParams> &candidates) const {
+    std::vector<StartupResult> results(candidates.size());
+
+    QVector<int> chunks;
+    for (int begin = 0; begin < static_cast<int>(candidates.size()); begin += SIM_CHUNK_SIZE) {
+        chunks.push_back(begin);
+    }
+
+    const auto total = static_cast<int>(candidates.size());
+    QtConcurrent::blockingMap(chunks, [this, &candidates, &results, total](int begin) {
+        const auto count = std::min(SIM_CHUNK_SIZE, total - begin);
+        EvaluateChunk(candidates.data() + begin, results.data() + begin, count);
+    });
+
+    qCritical() << "StartupSimulator::Evaluate, candidate count=" << total
+                << ", chunk count=" << chunks.size();
+    return results;
+}
+
+// 结构数组：每个状态量一个数组，内层循环按组合批量推进同一时间步
+// 内层循环没有分支和跨组合的归约，已结束的组合用 alive 掩码冻结状态，便于编译器向量化；
+// 每隔一段时间把已结束的组合移出，内层循环只推进仍在仿真的组合
+void StartupSimulator::EvaluateChunk(const StartupParams *params, StartupResult *results, int count) const {
+    float duty_v[SIM_CHUNK_SIZE];
+    float step_period[SIM_CHUNK_SIZE];
+    float zc_filter[SIM_CHUNK_SIZE];
+    float stall_time[SIM_CHUNK_SIZE];
+    float time_limit[SIM_CHUNK_SIZE];
+    float evol_count[SIM_CHUNK_SIZE];
+
+    float omega[SIM_CHUNK_SIZE];
+    float theta_e[SIM_CHUNK_SIZE];
+    float theta_s[SIM_CHUNK_SIZE];
+    float phase_time[SIM_CHUNK_SIZE];
+    float sector_angle[SIM_CHUNK_SIZE];
+    float zc_wait[SIM_CHUNK_SIZE];
+    float forced_left[SIM_CHUNK_SIZE];
+    float forced[SIM_CHUNK_SIZE];       // 1 强拖阶段，0 同步阶段
+    float zc_ok[SIM_CHUNK_SIZE];
+    float alive[SIM_CHUNK_SIZE];        // 1 仍在仿真，0 已结束
+    float success[SIM_CHUNK_SIZE];
+    float done_time[SIM_CHUNK_SIZE];
+
+    float max_time = 0.0f;
+    for (int i = 0; i < count; i++) {
+        const auto& p = params[i];
+        duty_v[i] = p.start_p * STARTP_SCALE * motor_.vbus;
+        step_period[i] = p.start_t * 1e-3f;
+        zc_filter[i] = p.zc_limit * ZC_LIMIT_UNIT;
+        stall_time[i] = p.stall * 1e-3f;
+        time_limit[i] = p.start_limit * START_LIMIT_UNIT;
+        evol_count[i] = static_cast<float>(std::max(1, static_cast<int>(p.evol_count)));
+
+        omega[i] = 0.0f;
+        theta_e[i] = 0.0f;
+        theta_s[i] = SECTOR * 1.5f;   // 首次强拖磁场超前转子 90 度
+        phase_time[i] = 0.0f;
+        sector_angle[i] = 0.0f;
+        zc_wait[i] = 0.0f;
+        forced_left[i] = static_cast<float>(std::max(1, static_cast<int>(p.start_step)));
+        forced[i] = 1.0f;
+        zc_ok[i] = 0.0f;
+        alive[i] = 1.0f;
+        success[i] = 0.0f;
+        done_time[i] = 0.0f;
+        max_time = std::max(max_time, time_limit[i]);
+    }
+
+    const float ke = motor_.ke;
+    const float inv_r = 1.0f / motor_.resistance;
+    const float inv_j = 1.0f / motor_.inertia;
+    const float load = motor_.load_torque;
+    const float friction = motor_.friction;
+    const float poles = static_cast<float>(motor_.pole_pairs);
+    const float zc_min = motor_.zc_min_bemf;
+
+    float* const lanes[] = {duty_v, step_period, zc_filter, stall_time, time_limit, evol_count,
+                            omega, theta_e, theta_s, phase_time, sector_angle, zc_wait,
+                            forced_left, forced, zc_ok, alive, success, done_time};
+    int index[SIM_CHUNK_SIZE];          // 组合在 results 中的序号
+    for (int i = 0; i < count; i++) {
+        index[i] = i;
+    }
+
+    int active = count;
+    float t = 0.0f;
+    for (long step = 0; active > 0 && t < max_time; step++) {
+        t = step * SIM_DT;
+        for (int i = 0; i < active; i++) {
+            // 先全部读到局部变量，用 0/1 掩码代替分支，最后无条件写回
+            // 条件读写或在条件分支里计算都会妨碍编译器把循环转成掩码运算
+            const float run = alive[i];
+            float w = omega[i];
+            float rotor = theta_e[i];
+            float field = theta_s[i];
+            float phase = phase_time[i];
+            float sector = sector_angle[i];
+            float wait = zc_wait[i];
+            float left = forced_left[i];
+            const float drive = forced[i];
+            float zc = zc_ok[i];
+            const float period = step_period[i];
+            const float filter = zc_filter[i];
+            const float stall = stall_time[i];
+            const float limit = time_limit[i];
+            const float evol = evol_count[i];
+
+            const float bemf = ke * w;
+            const float current = std::max(0.0f, (duty_v[i] - bemf) * inv_r);
+            const float forced_factor = FastSin(field - rotor);
+            const float sync_factor = (zc > 0.0f) ? SYNC_TORQUE_FACTOR : LOST_TORQUE_FACTOR;
+            const float torque = ke * current * (drive * forced_factor + (1.0f - drive) * sync_factor);
+
+            // 静止时负载转矩最多抵消电磁转矩
+            const bool held = (w <= 0.0f) & (torque < load);
+            const float held_load = std::max(torque, -load);
+            const float load_now = held ? held_load : load;
+            w += run * (torque - load_now - friction * w) * inv_j * SIM_DT;
+            const float delta = run * poles * w * SIM_DT;
+            rotor += delta;
+            phase += run * SIM_DT;
+
+            // 强拖：到时换相
+            const float commute = drive * static_cast<float>(phase >= period);
+            field += commute * SECTOR;
+            left -= commute;
+
+            // 同步：每转过一个扇区检测一次过零
+            const float closed = (1.0f - drive) * run;
+            sector += closed * delta;
+            wait += closed * SIM_DT;
+            const float crossed = static_cast<float>((closed > 0.0f) & (sector >= SECTOR));
+            const float valid = static_cast<float>((bemf >= zc_min) & (phase >= filter));
+            zc = (zc + crossed) * (1.0f - crossed + crossed * valid);
+            wait *= 1.0f - crossed * valid;
+            sector -= crossed * SECTOR;
+            phase *= (1.0f - commute) * (1.0f - crossed);
+
+            const float succeeded = static_cast<float>((closed > 0.0f) & (zc >= evol));
+            const float failed = static_cast<float>(((closed > 0.0f) & (wait >= stall)) | (t >= limit));
+            const float finished = run * std::max(succeeded, failed);
+
+            omega[i] = w;
+            theta_e[i] = rotor;
+            theta_s[i] = field;
+            phase_time[i] = phase;
+            sector_angle[i] = sector;
+            zc_wait[i] = wait;
+            forced_left[i] = left;
+            forced[i] = static_cast<float>(left > 0.0f);
+            zc_ok[i] = zc;
+            success[i] += finished * succeeded;
+            done_time[i] += finished * t;
+            alive[i] = run - finished;
+        }
+
+        if (step % SIM_COMPACT_STEPS == 0) {
+            int kept = 0;
+            for (int i = 0; i < active; i++) {
+                if (alive[i] > 0.0f) {
+                    for (auto lane: lanes) {
+                        lane[kept] = lane[i];
+                    }
+                    index[kept] = index[i];
+                    kept++;
+                } else {
+                    results[index[i]].success = (success[i] > 0.0f);
+                    results[index[i]].time_ms = done_time[i] * 1e3f;
+                }
+            }
+            active = kept;
+        }
+    }
+
+    for (int i = 0; i < active; i++) {
+        results[index[i]].success = (success[i] > 0.0f);
+        results[index[i]].time_ms = ((alive[i] > 0.0f) ? t : done_time[i]) * 1e3f;
+    }
+}
+
+// 以 center 为中心取 count 个等间隔的值；超出参数范围时整个窗口平移到范围内
+static std::vector<int> Sweep(const char* name, int center, int step, int count) {
+    const auto& schema = DeviceManager::getSchema(DeviceManager::DeviceType::CK3864S);
+    const auto index = schema.indexOf(name);
+    assert(index >= 0);
+    const int lo = (index >= 0) ? schema.min(static_cast<size_t>(index)) : 0;
+    const int hi = (index >= 0) ? schema.max(static_cast<size_t>(index)) : 255;
+
+    int first = center - step * (count / 2);
+    first = std::max(lo, std::min(first, hi - step * (count - 1)));
+    std::vector<int> values;
+    for (int value = first; value <= hi && static_cast<int>(values.size()) < count; value += step) {
+        values.push_back(value);
+    }
+    return values;
+}
+
+std::vector<StartupParams> StartupSimulator::MakeGrid(const StartupParams &base) {
+    const auto start_ps = Sweep("StartP:", base.start_p, GRID_P_STEP, GRID_P_COUNT);
+    const auto start_ts = Sweep("StartT:", base.start_t, GRID_T_STEP, GRID_T_COUNT);
+    const auto start_steps = Sweep("Start-Step:", base.start_step, GRID_STEP_STEP, GRID_STEP_COUNT);
+
+    std::vector<StartupParams> grid;
+    grid.reserve(start_ps.size() * start_ts.size() * start_steps.size());
+    for (auto start_p: start_ps) {
+        for (auto start_t: start_ts) {
+            for (auto start_step: start_steps) {
+                StartupParams p = base;
+                p.start_p = static_cast<quint8>(start_p);
+                p.start_t = static_cast<quint8>(start_t);
+                p.start_step = static_cast<quint8>(start_step);
+                grid.push_back(p);
+            }
+        }
+    }
+    return grid;
+}
+
+bool StartupSimulator::WriteReport(const QString &path,
+                                   const std::vector<StartupParams> &candidates,
+                                   const std::vector<StartupResult> &results) {
+    if (candidates.size() != results.size()) {
+        assert(false);
+        return false;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "StartupSimulator::WriteReport, failed, error=" << file.errorString();
+        return false;
+    }
+
+    // 成功的排在前面，按启动时间升序
+    std::vector<size_t> order(results.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&results](size_t a, size_t b) {
+        if (results[a].success != results[b].success) {
+            return results[a].success;
+        }
+        return results[a].time_ms < results[b].time_ms;
+    });
+
+    QTextStream ts(&file);
+    ts << "StartP,StartT,Start-Step,Evol-Count,ZC-Limit,Stall,Start-Limit,success,time_ms\n";
+    for (auto index: order) {
+        const auto& p = candidates[index];
+        const auto& r = results[index];
+        ts << static_cast<int>(p.start_p) << "," << static_cast<int>(p.start_t) << ","
+           << static_cast<int>(p.start_step) << "," << static_cast<int>(p.evol_count) << ","
+           << static_cast<int>(p.zc_limit) << "," << static_cast<int>(p.stall) << ","
+           << static_cast<int>(p.start_limit) << "," << r.success << ","
+           << QString::number(static_cast<double>(r.time_ms), 'f', 2) << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef STARTUPSIM_H
+#define STARTUPSIM_H
+
+#include <vector>
+#include <QString>
+
+// 离线无感启动仿真：用简化的电机模型评估 CK3864S 启动参数组合
+// 强拖阶段按 StartT 周期换相 Start-Step 次，占空比 StartP/220；
+// 之后按过零检测同步，连续 Evol-Count 次有效过零即认为启动成功。
+// 过零滤波 ZC-Limit 要求换相间隔大于滤波深度，反电动势过小也无法检测；
+// 超过 Stall 毫秒没有有效过零或超过 Start-Limit 时间判为失败
+struct MotorModel {
+    float resistance = 0.8f;        // 相电阻 Ω
+    float ke = 0.012f;              // 反电动势常数 V/(rad/s)，转矩常数取相同值
+    float inertia = 1.5e-5f;        // 转动惯量 kg·m²
+    float load_torque = 0.002f;     // 负载转矩 N·m
+    float friction = 2e-6f;         // 粘滞摩擦 N·m/(rad/s)
+    float vbus = 12.0f;             // 母线电压 V
+    float zc_min_bemf = 0.25f;      // 过零比较器可检测的最小反电动势 V
+    int pole_pairs = 2;
+
+    bool load(const QString& path);
+};
+
+struct StartupParams {
+    quint8 start_p = 15;
+    quint8 start_t = 25;
+    quint8 start_step = 2;
+    quint8 evol_count = 5;
+    quint8 zc_limit = 10;
+    quint8 stall = 25;
+    quint8 start_limit = 4;
+
+    static StartupParams FromDeviceManager();
+};
+
+struct StartupResult {
+    bool success = false;
+    float time_ms = 0.0f;
+};
+
+class StartupSimulator {
+public:
+    explicit StartupSimulator(const MotorModel& motor);
+
+    // 所有参数组合按块分配到全局线程池，块内按结构数组批量推进
+    std::vector<StartupResult> Evaluate(const std::vector<StartupParams>& candidates) const;
+
+    // 以 base 的 StartP/StartT/Start-Step 为中心各取一段等间隔的值，其余参数与 base 相同
+    static std::vector<StartupParams> MakeGrid(const StartupParams& base);
+    static bool WriteReport(const QString& path,
+                            const std::vector<StartupParams>& candidates,
+                            const std::vector<StartupResult>& results);
+
+private:
+    void EvaluateChunk(const StartupParams* params, StartupResult* results, int count) const;
+
+private:
+    MotorModel motor_;
+};
+
+#endif // STARTUPSIM_H
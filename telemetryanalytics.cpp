@@ -0,0 +1,227 @@
+#include "telemetryanalytics.h"
+#include <cmath>
+#include <QFile>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <QDebug>
+#include "deviceitem.h"
+
+constexpr int HIST_SIZE = 256;
+constexpr qint64 LOCKED_ROTOR_TIME_UNIT_MS = 100;
+
+// 8 位数据用 256 档直方图即可精确得到 min/max/mean/百分位
+// 四组子直方图交替累加，避免连续相同值造成的写后读依赖
+static void accumulateHistogram(const uchar* data, int len, quint64 hist[HIST_SIZE]) {
+    quint32 sub[4][HIST_SIZE] = {};
+    int i = 0;
+    for (; i + 4 <= len; i += 4) {
+        sub[0][data[i]]++;
+        sub[1][data[i + 1]]++;
+        sub[2][data[i + 2]]++;
+        sub[3][data[i + 3]]++;
+    }
+    for (; i < len; i++) {
+        sub[0][data[i]]++;
+    }
+    for (int v = 0; v < HIST_SIZE; v++) {
+        hist[v] += sub[0][v] + sub[1][v] + sub[2][v] + sub[3][v];
+    }
+}
+
+static quint8 percentile(const quint64 hist[HIST_SIZE], quint64 count, double p) {
+    const auto rank = static_cast<quint64>(std::ceil(p * static_cast<double>(count)));
+    quint64 seen = 0;
+    for (int v = 0; v < HIST_SIZE; v++) {
+        seen += hist[v];
+        if (seen >= rank && seen > 0) {
+            return static_cast<quint8>(v);
+        }
+    }
+    return static_cast<quint8>(HIST_SIZE - 1);
+}
+
+static FieldStats statsFromHistogram(const quint64 hist[HIST_SIZE]) {
+    FieldStats stats;
+    quint64 sum = 0;
+    int min = -1;
+    int max = -1;
+    for (int v = 0; v < HIST_SIZE; v++) {
+        if (hist[v] == 0) {
+            continue;
+        }
+        if (min < 0) {
+            min = v;
+        }
+        max = v;
+        stats.count += hist[v];
+        sum += hist[v] * static_cast<quint64>(v);
+    }
+
+    if (stats.count == 0) {
+        return stats;
+    }
+
+    stats.min = static_cast<quint8>(min);
+    stats.max = static_cast<quint8>(max);
+    stats.mean = static_cast<double>(sum) / static_cast<double>(stats.count);
+    stats.p50 = percentile(hist, stats.count, 0.50);
+    stats.p90 = percentile(hist, stats.count, 0.90);
+    stats.p99 = percentile(hist, stats.count, 0.99);
+    return stats;
+}
+
+static quint64 countAbove(const quint64 hist[HIST_SIZE], quint8 threshold) {
+    quint64 count = 0;
+    for (int v = threshold + 1; v < HIST_SIZE; v++) {
+        count += hist[v];
+    }
+    return count;
+}
+
+LimitSettings LimitSettings::FromDeviceManager() {
+    const auto& devMgr = DeviceManager::Instance();
+    LimitSettings limits;
+    ValueType value = 0;
+    if (devMgr.findValue("A-Limit:", &value)) {
+        limits.a_limit = value;
+    }
+    if (devMgr.findValue("A-OverLoad:", &value)) {
+        limits.a_overload = value;
+    }
+    if (devMgr.findValue("Locked Rotor-Time:", &value)) {
+        limits.locked_rotor_ms = value * LOCKED_ROTOR_TIME_UNIT_MS;
+    }
+    return limits;
+}
+
+bool RecordingStats::IsWithinLimits() const {
+    return (is_ok && overload_rows == 0 && stall_count == 0);
+}
+
+RecordingStats TelemetryAnalytics::Analyze(const QString &path, const LimitSettings &limits) {
+    RecordingStats stats;
+    stats.path = path;
+
+    TelemetryReader reader;
+    if (!reader.Open(path)) {
+        return stats;
+    }
+
+    quint64 hist[TF_COUNT][HIST_SIZE] = {};
+    qint64 vsp_on_time = -1;
+    qint64 stall_start = -1;
+    bool stall_counted = false;
+
+    QByteArray columns[TF_COUNT];
+    std::vector<qint64> timestamps;
+    for (int index = 0; index < reader.BlockCount(); index++) {
+        const auto& info = reader.Block(index);
+        bool is_ok = true;
+        for (int field = 0; field < TF_COUNT && is_ok; field++) {
+            is_ok = reader.ReadColumn(index, static_cast<TelemetryField>(field), columns[field]);
+            if (is_ok) {
+                accumulateHistogram(reinterpret_cast<const uchar*>(columns[field].constData()),
+                                    columns[field].size(), hist[field]);
+            }
+        }
+        if (!is_ok) {
+            qCritical() << "TelemetryAnalytics::Analyze, bad block, path=" << path << ", block=" << index;
+            return stats;
+        }
+
+        stats.rows += info.row_count;
+        if (info.max[TF_CURRENT] > limits.a_overload) {
+            stats.overload_blocks++;
+        }
+
+        // 已完成启动且整块都在运转或 VSP 为零时，不会有堵转，无需解码时间戳
+        const bool has_started = (stats.startup_ms >= 0);
+        if (has_started && (info.min[TF_SPEED] > 0 || info.max[TF_VSP] == 0)) {
+            stall_start = -1;
+            stall_counted = false;
+            continue;
+        }
+
+        if (!reader.ReadTimestamps(index, timestamps)) {
+            return stats;
+        }
+
+        const auto* vsp = reinterpret_cast<const uchar*>(columns[TF_VSP].constData());
+        const auto* speed = reinterpret_cast<const uchar*>(columns[TF_SPEED].constData());
+        for (quint32 row = 0; row < info.row_count; row++) {
+            const auto ts = timestamps[row];
+            if (vsp_on_time < 0 && vsp[row] > 0) {
+                vsp_on_time = ts;
+            }
+            if (stats.startup_ms < 0 && vsp_on_time >= 0 && speed[row] > 0) {
+                stats.startup_ms = ts - vsp_on_time;
+            }
+
+            if (vsp[row] > 0 && speed[row] == 0) {
+                if (stall_start < 0) {
+                    stall_start = ts;
+                }
+                if (!stall_counted && ts - stall_start >= limits.locked_rotor_ms) {
+                    stats.stall_count++;
+                    stall_counted = true;
+                }
+            } else {
+                stall_start = -1;
+                stall_counted = false;
+            }
+        }
+    }
+
+    for (int field = 0; field < TF_COUNT; field++) {
+        stats.fields[field] = statsFromHistogram(hist[field]);
+    }
+    stats.over_limit_rows = countAbove(hist[TF_CURRENT], limits.a_limit);
+    stats.overload_rows = countAbove(hist[TF_CURRENT], limits.a_overload);
+    stats.is_ok = true;
+    return stats;
+}
+
+QVector<RecordingStats> TelemetryAnalytics::AnalyzeAll(const QStringList &paths, const LimitSettings &limits) {
+    QVector<RecordingStats> results(paths.size());
+    for (int i = 0; i < paths.size(); i++) {
+        results[i].path = paths[i];
+    }
+
+    QtConcurrent::blockingMap(results, [limits](RecordingStats& stats) {
+        stats = Analyze(stats.path, limits);
+    });
+
+    qCritical() << "TelemetryAnalytics::AnalyzeAll, recording count=" << results.size()
+                << ", thread count=" << QThreadPool::globalInstance()->maxThreadCount();
+    return results;
+}
+
+bool TelemetryAnalytics::WriteReport(const QString &path, const QVector<RecordingStats> &stats) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "TelemetryAnalytics::WriteReport, failed, error=" << file.errorString();
+        return false;
+    }
+
+    static const char* FIELD_NAMES[TF_COUNT] = {"vsp", "current", "speed"};
+    QTextStream ts(&file);
+    ts << "file,ok,rows";
+    for (auto name: FIELD_NAMES) {
+        ts << "," << name << "_min," << name << "_max," << name << "_mean,"
+           << name << "_p50," << name << "_p90," << name << "_p99";
+    }
+    ts << ",startup_ms,stall_count,over_limit_rows,overload_rows,overload_blocks,within_limits\n";
+
+    for (const auto& s: stats) {
+        ts << s.path << "," << s.is_ok << "," << s.rows;
+        for (const auto& f: s.fields) {
+            ts << "," << static_cast<int>(f.min) << "," << static_cast<int>(f.max)
+               << "," << QString::number(f.mean, 'f', 2)
+               << "," << static_cast<int>(f.p50) << "," << static_cast<int>(f.p90)
+               << "," << static_cast<int>(f.p99);
+        }
+        ts << "," << s.startup_ms << "," << s.stall_count << "," << s.over_limit_rows
+           << "," << s.overload_rows << "," << s.overload_blocks << "," << s.IsWithinLimits() << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef TELEMETRYANALYTICS_H
+#define TELEMETRYANALYTICS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "telemetrystore.h"
+
+struct FieldStats {
+    quint64 count = 0;
+    quint8 min = 0;
+    quint8 max = 0;
+    double mean = 0.0;
+    quint8 p50 = 0;
+    quint8 p90 = 0;
+    quint8 p99 = 0;
+};
+
+// 取自当前设备参数，用于判断录制数据是否超限
+struct LimitSettings {
+    quint8 a_limit = 0;
+    quint8 a_overload = 0;
+    qint64 locked_rotor_ms = 0;
+
+    static LimitSettings FromDeviceManager();
+};
+
+struct RecordingStats {
+    QString path;
+    bool is_ok = false;
+    quint64 rows = 0;
+    FieldStats fields[TF_COUNT];
+    qint64 startup_ms = -1;         // VSP 首次非零到转速首次非零，-1 表示未启动
+    quint32 stall_count = 0;        // VSP 非零而转速为零且持续超过堵转保护时间的次数
+    quint64 over_limit_rows = 0;    // 电流超过限流值的采样数
+    quint64 overload_rows = 0;      // 电流超过过流值的采样数
+    quint32 overload_blocks = 0;
+
+    bool IsWithinLimits() const;
+};
+
+class TelemetryAnalytics {
+public:
+    static RecordingStats Analyze(const QString& path, const LimitSettings& limits);
+    // 使用全局线程池并行分析，结果顺序与 paths 一致
+    static QVector<RecordingStats> AnalyzeAll(const QStringList& paths, const LimitSettings& limits);
+    static bool WriteReport(const QString& path, const QVector<RecordingStats>& stats);
+};
+
+#endif // TELEMETRYANALYTICS_H
@@ -0,0 +1,410 @@
+#include "telemetrystore.h"
+#include <cstring>
+#include <QDir>
+#include <QDate>
+#include <QTime>
+#include <QtEndian>
+#include <QDebug>
+
+static const char* RECORD_FOLDER = "records";
+
+constexpr quint32 TM_MAGIC       = 0x4D544B43;  // "CKTM"
+constexpr quint32 TM_BLOCK_MAGIC = 0x42544B43;  // "CKTB"
+constexpr quint32 TM_END_MAGIC   = 0x45544B43;  // "CKTE"
+constexpr quint16 TM_VERSION = 1;
+constexpr quint32 TM_BLOCK_ROWS = 1024;
+
+// 文件头: magic(4) version(2) field count(2) block rows(4)
+constexpr qint64 TM_HEADER_SIZE = 12;
+// 块头: magic(4) rows(4) t_min(8) t_max(8) 各列大小(4 * (TF_COUNT + 1)) min(TF_COUNT) max(TF_COUNT)
+constexpr qint64 TM_BLOCK_HEADER_SIZE = 24 + 4 * (TF_COUNT + 1) + 2 * TF_COUNT;
+// 文件尾: footer offset(8) magic(4)
+constexpr qint64 TM_TRAILER_SIZE = 12;
+
+template <typename T>
+static void appendLE(QByteArray& out, T value) {
+    uchar buf[sizeof(T)];
+    qToLittleEndian<T>(value, buf);
+    out.append(reinterpret_cast<const char*>(buf), sizeof(T));
+}
+
+template <typename T>
+static T readLE(const uchar* p) {
+    return qFromLittleEndian<T>(p);
+}
+
+static void appendBlockHeader(QByteArray& out, const TelemetryBlockInfo& info) {
+    appendLE<quint32>(out, TM_BLOCK_MAGIC);
+    appendLE<quint32>(out, info.row_count);
+    appendLE<qint64>(out, info.t_min);
+    appendLE<qint64>(out, info.t_max);
+    for (auto size: info.column_size) {
+        appendLE<quint32>(out, size);
+    }
+    out.append(reinterpret_cast<const char*>(info.min), TF_COUNT);
+    out.append(reinterpret_cast<const char*>(info.max), TF_COUNT);
+}
+
+static bool parseBlockHeader(const uchar* p, TelemetryBlockInfo& info) {
+    if (readLE<quint32>(p) != TM_BLOCK_MAGIC) {
+        return false;
+    }
+    info.row_count = readLE<quint32>(p + 4);
+    info.t_min = readLE<qint64>(p + 8);
+    info.t_max = readLE<qint64>(p + 16);
+    p += 24;
+    for (auto& size: info.column_size) {
+        size = readLE<quint32>(p);
+        p += 4;
+    }
+    std::memcpy(info.min, p, TF_COUNT);
+    std::memcpy(info.max, p + TF_COUNT, TF_COUNT);
+    return true;
+}
+
+static qint64 blockDataSize(const TelemetryBlockInfo& info) {
+    qint64 size = 0;
+    for (auto column_size: info.column_size) {
+        size += column_size;
+    }
+    return size;
+}
+
+////////////////////////////////////////////////////////
+TelemetryRecorder::~TelemetryRecorder() {
+    Close();
+}
+
+QString TelemetryRecorder::DefaultFileName() {
+    if (!QDir(RECORD_FOLDER).exists()) {
+        QDir().mkdir(RECORD_FOLDER);
+    }
+
+    return QString("%1/Rec_%2__%3.ckt")
+            .arg(RECORD_FOLDER)
+            .arg(QDate::currentDate().toString("yyyy_MM_dd"))
+            .arg(QTime::currentTime().toString("hh_mm_ss_zzz"));
+}
+
+bool TelemetryRecorder::Open(const QString &path) {
+    qCritical() << "TelemetryRecorder::Open, path=" << path;
+    if (IsOpen()) {
+        Close();
+    }
+
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "TelemetryRecorder::Open, failed, error=" << file_.errorString();
+        return false;
+    }
+
+    QByteArray header;
+    appendLE<quint32>(header, TM_MAGIC);
+    appendLE<quint16>(header, TM_VERSION);
+    appendLE<quint16>(header, TF_COUNT);
+    appendLE<quint32>(header, TM_BLOCK_ROWS);
+    if (file_.write(header) != header.size()) {
+        file_.close();
+        return false;
+    }
+
+    blocks_.clear();
+    ResetBlock();
+    return true;
+}
+
+void TelemetryRecorder::Close() {
+    if (!IsOpen()) {
+        return;
+    }
+
+    FlushBlock();
+    const auto is_ok = WriteFooter();
+    qCritical() << "TelemetryRecorder::Close, block count=" << blocks_.size()
+                << ", footer written=" << is_ok;
+    file_.close();
+    blocks_.clear();
+}
+
+bool TelemetryRecorder::IsOpen() const {
+    return file_.isOpen();
+}
+
+bool TelemetryRecorder::Append(const TelemetrySample &sample) {
+    if (!IsOpen()) {
+        return false;
+    }
+
+    if (timestamps_.empty()) {
+        current_.t_min = sample.timestamp_ms;
+        std::memcpy(current_.min, sample.values, TF_COUNT);
+        std::memcpy(current_.max, sample.values, TF_COUNT);
+    }
+    current_.t_max = sample.timestamp_ms;
+
+    timestamps_.push_back(sample.timestamp_ms);
+    for (int field = 0; field < TF_COUNT; field++) {
+        const auto value = sample.values[field];
+        columns_[field].push_back(value);
+        if (value < current_.min[field]) {
+            current_.min[field] = value;
+        }
+        if (value > current_.max[field]) {
+            current_.max[field] = value;
+        }
+    }
+
+    if (timestamps_.size() >= TM_BLOCK_ROWS) {
+        return FlushBlock();
+    }
+    return true;
+}
+
+// 时间戳列保存为相对块起始时间的 32 位增量，压缩效果更好
+bool TelemetryRecorder::FlushBlock() {
+    if (timestamps_.empty()) {
+        return true;
+    }
+
+    QByteArray ts_raw;
+    ts_raw.reserve(static_cast<int>(timestamps_.size() * sizeof(quint32)));
+    for (auto ts: timestamps_) {
+        appendLE<quint32>(ts_raw, static_cast<quint32>(ts - current_.t_min));
+    }
+
+    QByteArray compressed[TF_COUNT + 1];
+    compressed[0] = qCompress(ts_raw);
+    for (int field = 0; field < TF_COUNT; field++) {
+        const auto& column = columns_[field];
+        compressed[field + 1] = qCompress(column.data(), static_cast<int>(column.size()));
+    }
+
+    current_.offset = static_cast<quint64>(file_.pos());
+    current_.row_count = static_cast<quint32>(timestamps_.size());
+    for (int i = 0; i <= TF_COUNT; i++) {
+        current_.column_size[i] = static_cast<quint32>(compressed[i].size());
+    }
+
+    QByteArray block;
+    appendBlockHeader(block, current_);
+    for (const auto& column: compressed) {
+        block.append(column);
+    }
+
+    const auto is_ok = (file_.write(block) == block.size());
+    assert(is_ok);
+    if (is_ok) {
+        blocks_.push_back(current_);
+    }
+    ResetBlock();
+    return is_ok;
+}
+
+bool TelemetryRecorder::WriteFooter() {
+    const auto footer_offset = static_cast<quint64>(file_.pos());
+
+    QByteArray footer;
+    appendLE<quint32>(footer, static_cast<quint32>(blocks_.size()));
+    for (const auto& info: blocks_) {
+        appendLE<quint64>(footer, info.offset);
+        appendBlockHeader(footer, info);
+    }
+    appendLE<quint64>(footer, footer_offset);
+    appendLE<quint32>(footer, TM_END_MAGIC);
+
+    return (file_.write(footer) == footer.size());
+}
+
+void TelemetryRecorder::ResetBlock() {
+    timestamps_.clear();
+    timestamps_.reserve(TM_BLOCK_ROWS);
+    for (auto& column: columns_) {
+        column.clear();
+        column.reserve(TM_BLOCK_ROWS);
+    }
+    current_ = TelemetryBlockInfo();
+}
+
+////////////////////////////////////////////////////////
+TelemetryReader::~TelemetryReader() {
+    Close();
+}
+
+bool TelemetryReader::Open(const QString &path) {
+    Close();
+
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        qCritical() << "TelemetryReader::Open, failed, error=" << file_.errorString();
+        return false;
+    }
+
+    size_ = file_.size();
+    if (size_ < TM_HEADER_SIZE) {
+        Close();
+        return false;
+    }
+
+    data_ = file_.map(0, size_);
+    if (data_ == nullptr) {
+        qCritical() << "TelemetryReader::Open, map failed, error=" << file_.errorString();
+        Close();
+        return false;
+    }
+
+    if (readLE<quint32>(data_) != TM_MAGIC ||
+        readLE<quint16>(data_ + 4) != TM_VERSION ||
+        readLE<quint16>(data_ + 6) != TF_COUNT) {
+        qCritical() << "TelemetryReader::Open, unsupported file, path=" << path;
+        Close();
+        return false;
+    }
+
+    // 录制中途异常退出时没有 footer，顺序扫描块头重建索引
+    bool is_ok = ReadFooter();
+    if (!is_ok) {
+        qCritical() << "TelemetryReader::Open, footer missing, scanning blocks";
+        is_ok = ScanBlocks();
+    }
+
+    qCritical() << "TelemetryReader::Open, path=" << path
+                << ", block count=" << blocks_.size();
+    return is_ok;
+}
+
+void TelemetryReader::Close() {
+    if (data_ != nullptr) {
+        file_.unmap(const_cast<uchar*>(data_));
+        data_ = nullptr;
+    }
+    if (file_.isOpen()) {
+        file_.close();
+    }
+    size_ = 0;
+    blocks_.clear();
+}
+
+bool TelemetryReader::IsOpen() const {
+    return (data_ != nullptr);
+}
+
+int TelemetryReader::BlockCount() const {
+    return static_cast<int>(blocks_.size());
+}
+
+const TelemetryBlockInfo &TelemetryReader::Block(int index) const {
+    return blocks_.at(static_cast<size_t>(index));
+}
+
+quint64 TelemetryReader::RowCount() const {
+    quint64 rows = 0;
+    for (const auto& info: blocks_) {
+        rows += info.row_count;
+    }
+    return rows;
+}
+
+std::vector<int> TelemetryReader::FindBlocksAbove(TelemetryField field, quint8 threshold) const {
+    std::vector<int> result;
+    for (int i = 0; i < BlockCount(); i++) {
+        if (blocks_[static_cast<size_t>(i)].max[field] > threshold) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+bool TelemetryReader::ReadTimestamps(int index, std::vector<qint64> &out) const {
+    if (!IsOpen() || index < 0 || index >= BlockCount()) {
+        return false;
+    }
+
+    const auto& info = Block(index);
+    const auto* p = data_ + info.offset + TM_BLOCK_HEADER_SIZE;
+    const auto raw = qUncompress(p, static_cast<int>(info.column_size[0]));
+    if (raw.size() != static_cast<int>(info.row_count * sizeof(quint32))) {
+        return false;
+    }
+
+    out.resize(info.row_count);
+    const auto* deltas = reinterpret_cast<const uchar*>(raw.constData());
+    for (quint32 row = 0; row < info.row_count; row++) {
+        out[row] = info.t_min + readLE<quint32>(deltas + row * sizeof(quint32));
+    }
+    return true;
+}
+
+bool TelemetryReader::ReadColumn(int index, TelemetryField field, QByteArray &out) const {
+    if (!IsOpen() || index < 0 || index >= BlockCount() || field >= TF_COUNT) {
+        return false;
+    }
+
+    const auto& info = Block(index);
+    qint64 pos = static_cast<qint64>(info.offset) + TM_BLOCK_HEADER_SIZE;
+    for (int i = 0; i <= field; i++) {
+        pos += info.column_size[i];
+    }
+
+    out = qUncompress(data_ + pos, static_cast<int>(info.column_size[field + 1]));
+    return (out.size() == static_cast<int>(info.row_count));
+}
+
+bool TelemetryReader::ReadFooter() {
+    if (size_ < TM_HEADER_SIZE + TM_TRAILER_SIZE) {
+        return false;
+    }
+
+    const auto* trailer = data_ + size_ - TM_TRAILER_SIZE;
+    if (readLE<quint32>(trailer + 8) != TM_END_MAGIC) {
+        return false;
+    }
+
+    const auto footer_offset = static_cast<qint64>(readLE<quint64>(trailer));
+    if (footer_offset < TM_HEADER_SIZE || footer_offset + 4 > size_ - TM_TRAILER_SIZE) {
+        return false;
+    }
+
+    const auto* p = data_ + footer_offset;
+    const auto block_count = readLE<quint32>(p);
+    p += 4;
+    const qint64 entry_size = 8 + TM_BLOCK_HEADER_SIZE;
+    if (footer_offset + 4 + block_count * entry_size > size_ - TM_TRAILER_SIZE) {
+        return false;
+    }
+
+    blocks_.clear();
+    blocks_.reserve(block_count);
+    for (quint32 i = 0; i < block_count; i++, p += entry_size) {
+        TelemetryBlockInfo info;
+        if (!parseBlockHeader(p + 8, info)) {
+            blocks_.clear();
+            return false;
+        }
+        info.offset = readLE<quint64>(p);
+        if (static_cast<qint64>(info.offset) + TM_BLOCK_HEADER_SIZE + blockDataSize(info) > footer_offset) {
+            blocks_.clear();
+            return false;
+        }
+        blocks_.push_back(info);
+    }
+    return true;
+}
+
+bool TelemetryReader::ScanBlocks() {
+    blocks_.clear();
+    qint64 pos = TM_HEADER_SIZE;
+    while (pos + TM_BLOCK_HEADER_SIZE <= size_) {
+        TelemetryBlockInfo info;
+        if (!parseBlockHeader(data_ + pos, info)) {
+            break;
+        }
+        info.offset = static_cast<quint64>(pos);
+        const auto next = pos + TM_BLOCK_HEADER_SIZE + blockDataSize(info);
+        if (next > size_) {
+            break;  // 最后一个块没有写完整
+        }
+        blocks_.push_back(info);
+        pos = next;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef TELEMETRYSTORE_H
+#define TELEMETRYSTORE_H
+
+#include <vector>
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+// 调试遥测按列存储：每个字段一列，外加时间戳列
+// 文件布局：文件头 | 数据块 ... | 块索引(footer) | 文件尾
+// 每个数据块的各列分别用 qCompress 压缩，块头和块索引中记录每列的 min/max，
+// 查询时只需读取索引即可跳过不相关的块
+enum TelemetryField {
+    TF_VSP = 0,         // 实际发出的 VSP，协议 1 的调试帧不含 VSP，记为 0
+    TF_CURRENT = 1,
+    TF_SPEED = 2,
+    TF_COUNT = 3
+};
+
+struct TelemetrySample {
+    qint64 timestamp_ms = 0;
+    quint8 values[TF_COUNT] = {};
+};
+
+struct TelemetryBlockInfo {
+    quint64 offset = 0;
+    quint32 row_count = 0;
+    qint64 t_min = 0;
+    qint64 t_max = 0;
+    quint32 column_size[TF_COUNT + 1] = {};  // 压缩后大小，[0] 为时间戳列
+    quint8 min[TF_COUNT] = {};
+    quint8 max[TF_COUNT] = {};
+};
+
+class TelemetryRecorder {
+public:
+    TelemetryRecorder() = default;
+    ~TelemetryRecorder();
+    TelemetryRecorder(const TelemetryRecorder&) = delete;
+    TelemetryRecorder& operator=(const TelemetryRecorder&) = delete;
+
+    static QString DefaultFileName();
+
+    bool Open(const QString& path);
+    void Close();
+    bool IsOpen() const;
+    bool Append(const TelemetrySample& sample);
+
+private:
+    bool FlushBlock();
+    bool WriteFooter();
+    void ResetBlock();
+
+private:
+    QFile file_;
+    std::vector<TelemetryBlockInfo> blocks_;
+    std::vector<qint64> timestamps_;
+    std::vector<quint8> columns_[TF_COUNT];
+    TelemetryBlockInfo current_;
+};
+
+class TelemetryReader {
+public:
+    TelemetryReader() = default;
+    ~TelemetryReader();
+    TelemetryReader(const TelemetryReader&) = delete;
+    TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+    bool Open(const QString& path);
+    void Close();
+    bool IsOpen() const;
+
+    int BlockCount() const;
+    const TelemetryBlockInfo& Block(int index) const;
+    quint64 RowCount() const;
+
+    // 返回 field 列最大值超过 threshold 的块，仅使用索引，不解压数据
+    std::vector<int> FindBlocksAbove(TelemetryField field, quint8 threshold) const;
+    bool ReadTimestamps(int index, std::vector<qint64>& out) const;
+    bool ReadColumn(int index, TelemetryField field, QByteArray& out) const;
+
+private:
+    bool ReadFooter();
+    bool ScanBlocks();
+
+private:
+    QFile file_;
+    const uchar* data_ = nullptr;
+    qint64 size_ = 0;
+    std::vector<TelemetryBlockInfo> blocks_;
+};
+
+#endif // TELEMETRYSTORE_H
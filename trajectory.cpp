@@ -0,0 +1,139 @@
+#include "trajectory.h"
+#include <algorithm>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QRegularExpression>
+#include <QDebug>
+
+constexpr int VSP_LIMIT = 255;
+
+bool Trajectory::load(const QString &path) {
+    clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "Trajectory::load, failed, error=" << file.errorString();
+        return false;
+    }
+
+    QTextStream ts(&file);
+    int line_no = 0;
+    while (!ts.atEnd()) {
+        const auto line = ts.readLine().trimmed();
+        line_no++;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        const auto fields = line.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+        bool is_ok = (fields.size() == 4 || fields.size() == 5);
+        TrajectoryPoint point;
+        int vsp = 0;
+        if (is_ok) {
+            bool time_ok = false;
+            bool vsp_ok = false;
+            point.time_ms = fields[0].toLongLong(&time_ok);
+            vsp = fields[1].toInt(&vsp_ok);
+            point.setpoint.fr = (fields[2].toInt() != 0);
+            point.setpoint.bk = (fields[3].toInt() != 0);
+            point.ramp = (fields.size() == 5 && fields[4] == "ramp");
+            is_ok = time_ok && vsp_ok && vsp >= 0 && vsp <= VSP_LIMIT &&
+                    (fields.size() == 4 || point.ramp);
+        }
+        if (is_ok && !points_.empty()) {
+            is_ok = (point.time_ms >= points_.back().time_ms);
+        }
+        if (!is_ok) {
+            qCritical() << "Trajectory::load, bad line" << line_no << ":" << line;
+            clear();
+            return false;
+        }
+
+        point.setpoint.vsp = static_cast<quint8>(vsp);
+        points_.push_back(point);
+    }
+
+    qCritical() << "Trajectory::load, path=" << path << ", point count=" << points_.size()
+                << ", duration=" << duration();
+    return !points_.empty();
+}
+
+void Trajectory::clear() {
+    points_.clear();
+}
+
+bool Trajectory::isEmpty() const {
+    return points_.empty();
+}
+
+qint64 Trajectory::duration() const {
+    return points_.empty() ? 0 : points_.back().time_ms;
+}
+
+DebugSetpoint Trajectory::at(qint64 time_ms) const {
+    if (points_.empty()) {
+        return DebugSetpoint();
+    }
+
+    // 第一个时刻大于 time_ms 的关键点
+    const auto next = std::upper_bound(points_.begin(), points_.end(), time_ms,
+                                       [](qint64 t, const TrajectoryPoint& p) { return t < p.time_ms; });
+    if (next == points_.begin()) {
+        return points_.front().setpoint;
+    }
+
+    const auto& prev = *(next - 1);
+    if (next == points_.end() || !next->ramp) {
+        return prev.setpoint;
+    }
+
+    DebugSetpoint setpoint = prev.setpoint;
+    const auto span = next->time_ms - prev.time_ms;
+    if (span > 0) {
+        const auto delta = static_cast<qint64>(next->setpoint.vsp) - prev.setpoint.vsp;
+        setpoint.vsp = static_cast<quint8>(prev.setpoint.vsp + delta * (time_ms - prev.time_ms) / span);
+    }
+    return setpoint;
+}
+
+std::vector<qint64> Trajectory::schedule(qint64 interval_ms) const {
+    std::vector<qint64> times;
+    if (points_.empty() || interval_ms <= 0) {
+        return times;
+    }
+
+    for (qint64 t = points_.front().time_ms; t <= duration(); t += interval_ms) {
+        times.push_back(t);
+    }
+    for (const auto& p: points_) {
+        times.push_back(p.time_ms);
+    }
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+    return times;
+}
+
+void SendTimingStats::add(double late_ms) {
+    if (count == 0) {
+        min_ms = late_ms;
+        max_ms = late_ms;
+    } else {
+        min_ms = std::min(min_ms, late_ms);
+        max_ms = std::max(max_ms, late_ms);
+    }
+    count++;
+    mean_ms += (late_ms - mean_ms) / count;
+}
+
+void SendTimingStats::clear() {
+    *this = SendTimingStats();
+}
+
+QString SendTimingStats::toString() const {
+    return QString("count=%1, mean=%2 ms, min=%3 ms, max=%4 ms")
+            .arg(count)
+            .arg(mean_ms, 0, 'f', 2)
+            .arg(min_ms, 0, 'f', 2)
+            .arg(max_ms, 0, 'f', 2);
+}
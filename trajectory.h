@@ -0,0 +1,48 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <vector>
+#include <QString>
+
+struct DebugSetpoint {
+    quint8 vsp = 0;
+    bool fr = false;
+    bool bk = false;
+};
+
+// 轨迹文件每行一个关键点：时间(ms)  VSP  FR  BK  [ramp]
+// 带 ramp 的关键点，VSP 从上一个关键点线性过渡；否则在该时刻阶跃。'#' 开头为注释
+struct TrajectoryPoint {
+    qint64 time_ms = 0;
+    DebugSetpoint setpoint;
+    bool ramp = false;
+};
+
+class Trajectory {
+public:
+    bool load(const QString& path);
+    void clear();
+    bool isEmpty() const;
+    qint64 duration() const;
+
+    DebugSetpoint at(qint64 time_ms) const;
+    // 计划发送时刻：按 interval_ms 等间隔，并包含每个关键点时刻
+    std::vector<qint64> schedule(qint64 interval_ms) const;
+
+private:
+    std::vector<TrajectoryPoint> points_;
+};
+
+// 实际发送时刻相对计划时刻的偏差统计
+struct SendTimingStats {
+    quint32 count = 0;
+    double mean_ms = 0.0;
+    double min_ms = 0.0;
+    double max_ms = 0.0;
+
+    void add(double late_ms);
+    void clear();
+    QString toString() const;
+};
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,29 @@
+#include "transaction.h"
+#include <algorithm>
+
+qint64 RetryPolicy::BackoffMs(int retry) const {
+    if (retry <= 0) {
+        return 0;
+    }
+
+    qint64 backoff = backoff_ms;
+    for (int i = 1; i < retry && backoff < max_backoff_ms; i++) {
+        backoff *= 2;
+    }
+    return std::min(backoff, max_backoff_ms);
+}
+
+bool TransactionResult::isOk() const {
+    return (status == OK);
+}
+
+QString TransactionResult::toString() const {
+    static const wchar_t* KIND_NAMES[] = {L"读取", L"写入", L"调试"};
+    static const wchar_t* STATUS_NAMES[] = {L"成功", L"超时", L"发送失败", L"端口已关闭"};
+
+    return QString::fromWCharArray(L"%1%2, 尝试 %3 次, 用时 %4 ms")
+            .arg(QString::fromWCharArray(KIND_NAMES[kind]))
+            .arg(QString::fromWCharArray(STATUS_NAMES[status]))
+            .arg(attempts)
+            .arg(elapsed_ms);
+}
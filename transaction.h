@@ -0,0 +1,41 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <QString>
+
+// 设备连续无应答时上报的错误码
+constexpr int ERR_NO_RESPONSE = -3;
+
+// 超时后原样重发同一帧，参数帧和读取命令都是幂等的
+// 第 n 次重发前等待 min(backoff_ms * 2^(n-1), max_backoff_ms)
+struct RetryPolicy {
+    int max_retries = 2;
+    qint64 backoff_ms = 20;
+    qint64 max_backoff_ms = 200;
+
+    qint64 BackoffMs(int retry) const;
+};
+
+struct TransactionResult {
+    enum Kind {
+        READ = 0,
+        WRITE = 1,
+        DEBUG = 2
+    };
+    enum Status {
+        OK = 0,
+        TIMEOUT = 1,        // 重试次数用完仍无应答
+        SEND_FAILED = 2,    // 端口未打开，或请求帧没能完整写出
+        CLOSED = 3          // 等待应答时端口被关闭
+    };
+
+    Kind kind = READ;
+    Status status = OK;
+    int attempts = 0;
+    qint64 elapsed_ms = 0;
+
+    bool isOk() const;
+    QString toString() const;
+};
+
+#endif // TRANSACTION_H
@@ -0,0 +1,102 @@
+#include "uirefresh.h"
+#include <QDebug>
+
+constexpr double DEFAULT_FRAME_RATE = 60.0;
+constexpr double MIN_FRAME_RATE = 10.0;
+constexpr double MAX_FRAME_RATE = 240.0;
+
+UiRefreshGate::UiRefreshGate(std::function<void()> apply, QObject *parent)
+    : QObject(parent),
+      apply_(std::move(apply)) {
+    timer_.setSingleShot(true);
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, [this]() { Apply(); });
+    clock_.start();
+    SetFrameRate(DEFAULT_FRAME_RATE);
+    last_apply_us_ = -interval_us_;
+}
+
+void UiRefreshGate::SetFrameRate(double hz) {
+    // 部分虚拟显示器返回 0 或异常值
+    if (!(hz >= MIN_FRAME_RATE && hz <= MAX_FRAME_RATE)) {
+        hz = DEFAULT_FRAME_RATE;
+    }
+    interval_us_ = static_cast<qint64>(1000000.0 / hz);
+    qCritical() << "UiRefreshGate::SetFrameRate, hz=" << hz << ", interval=" << interval_us_ << "us";
+}
+
+qint64 UiRefreshGate::GetFrameIntervalUs() const {
+    return interval_us_;
+}
+
+void UiRefreshGate::Request() {
+    requests_++;
+    const auto now = clock_.nsecsElapsed() / 1000;
+    if (first_request_us_ >= 0) {
+        return;     // 已经排队，到时刷新最新数据即可
+    }
+
+    first_request_us_ = now;
+    // 距上次刷新已超过一帧就在本轮事件循环末尾刷新，否则等到下一帧
+    const auto wait_us = last_apply_us_ + interval_us_ - now;
+    timer_.start(wait_us > 0 ? static_cast<int>((wait_us + 999) / 1000) : 0);
+}
+
+void UiRefreshGate::Flush() {
+    if (IsPending()) {
+        timer_.stop();
+        Apply();
+    }
+}
+
+bool UiRefreshGate::IsPending() const {
+    return first_request_us_ >= 0;
+}
+
+void UiRefreshGate::Apply() {
+    if (first_request_us_ < 0) {
+        return;
+    }
+
+    const auto start = clock_.nsecsElapsed() / 1000;
+    lag_.add(start - first_request_us_);
+    first_request_us_ = -1;
+    last_apply_us_ = start;
+    applies_++;
+
+    if (apply_) {
+        apply_();
+    }
+    apply_cost_.add(clock_.nsecsElapsed() / 1000 - start);
+}
+
+const LatencyStats &UiRefreshGate::GetLag() const {
+    return lag_;
+}
+
+const LatencyStats &UiRefreshGate::GetApplyCost() const {
+    return apply_cost_;
+}
+
+quint64 UiRefreshGate::GetRequestCount() const {
+    return requests_;
+}
+
+quint64 UiRefreshGate::GetApplyCount() const {
+    return applies_;
+}
+
+void UiRefreshGate::ClearStats() {
+    lag_.clear();
+    apply_cost_.clear();
+    requests_ = 0;
+    applies_ = 0;
+}
+
+QString UiRefreshGate::toString() const {
+    return QString("requests=%1, refreshes=%2, lag: %3, cost: %4")
+            .arg(requests_)
+            .arg(applies_)
+            .arg(lag_.toString())
+            .arg(apply_cost_.toString());
+}
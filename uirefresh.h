@@ -0,0 +1,47 @@
+#ifndef UIREFRESH_H
+#define UIREFRESH_H
+
+#include <functional>
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "realtimeio.h"
+
+// 界面刷新合并：数据到达时只做标记，每个显示帧最多刷新一次
+// 刷新时读取的是最新数据，中间的快照直接跳过
+class UiRefreshGate: public QObject {
+public:
+    explicit UiRefreshGate(std::function<void()> apply, QObject *parent = nullptr);
+
+    void SetFrameRate(double hz);
+    qint64 GetFrameIntervalUs() const;
+
+    void Request();
+    void Flush();                           // 有未完成的刷新时立即执行
+    bool IsPending() const;
+
+    const LatencyStats& GetLag() const;     // 第一次请求到实际刷新的时间
+    const LatencyStats& GetApplyCost() const;
+    quint64 GetRequestCount() const;
+    quint64 GetApplyCount() const;
+    void ClearStats();
+    QString toString() const;
+
+private:
+    void Apply();
+
+private:
+    std::function<void()> apply_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    qint64 interval_us_ = 0;
+    qint64 first_request_us_ = -1;          // -1 表示没有待刷新的数据
+    qint64 last_apply_us_ = 0;
+
+    LatencyStats lag_;
+    LatencyStats apply_cost_;
+    quint64 requests_ = 0;
+    quint64 applies_ = 0;
+};
+
+#endif // UIREFRESH_H
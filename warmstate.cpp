@@ -0,0 +1,28 @@
+#include "warmstate.h"
+#include <QSettings>
+#include "deviceitem.h"
+
+static const char* SETTINGS_FILE = "settings.ini";
+static const char* KEY_PORT = "warm/port";
+static const char* KEY_MODEL = "warm/model";
+static const char* KEY_PROFILE = "warm/profile_loaded";
+
+WarmState WarmState::Load() {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    WarmState state;
+    state.port = settings.value(KEY_PORT).toString();
+    state.model = settings.value(KEY_MODEL, CK3864S).toString();
+    state.profile_loaded = settings.value(KEY_PROFILE, false).toBool();
+    return state;
+}
+
+void WarmState::SavePort(const QString &port) {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    settings.setValue(KEY_PORT, port);
+}
+
+void WarmState::SaveModel(const QString &model, bool profile_loaded) {
+    QSettings settings(SETTINGS_FILE, QSettings::IniFormat);
+    settings.setValue(KEY_MODEL, model);
+    settings.setValue(KEY_PROFILE, profile_loaded);
+}
@@ -0,0 +1,17 @@
+#ifndef WARMSTATE_H
+#define WARMSTATE_H
+
+#include <QString>
+
+// 上次使用的端口、型号和参数来源，保存在 settings.ini，启动时直接恢复
+struct WarmState {
+    QString port;
+    QString model;
+    bool profile_loaded = false;    // 是否从参数文件加载，否则为型号默认值
+
+    static WarmState Load();
+    static void SavePort(const QString& port);
+    static void SaveModel(const QString& model, bool profile_loaded);
+};
+
+#endif // WARMSTATE_H